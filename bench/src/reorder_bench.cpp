@@ -0,0 +1,195 @@
+// MIT License
+//
+// Copyright (c) 2019 Jelle Spijker
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+
+// Effect of System::Reorder on a network whose vertex ids are shuffled, as in imported models: the distance in
+// storage between connected vertices, the median solve time and, when the kernel allows perf events, the cache
+// misses of the solve. The orders are solved in turns, so that a drift of the machine affects all of them. Without
+// perf events only the times are measured, which do not tell whether a difference comes from the cache.
+//   reorder_bench [side] [solves]
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <iostream>
+#include <memory>
+#include <numeric>
+#include <random>
+#include <vector>
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+#include <fluids/Model.h>
+#include <fluids/Pipes.h>
+#include <fluids/System.h>
+
+namespace {
+
+/// Hardware cache miss counter of the calling thread, unavailable without perf events
+class CacheMisses {
+public:
+  CacheMisses() {
+#ifdef __linux__
+    perf_event_attr attr{};
+    attr.type = PERF_TYPE_HARDWARE;
+    attr.size = sizeof(attr);
+    attr.config = PERF_COUNT_HW_CACHE_MISSES;
+    attr.disabled = 1;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    m_fd = static_cast<int>(syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0));
+#endif
+  }
+  ~CacheMisses() {
+#ifdef __linux__
+    if (m_fd >= 0)
+      close(m_fd);
+#endif
+  }
+
+  bool Is_Available() const {
+    return m_fd >= 0;
+  }
+
+  void Start() {
+#ifdef __linux__
+    if (m_fd >= 0) {
+      ioctl(m_fd, PERF_EVENT_IOC_RESET, 0);
+      ioctl(m_fd, PERF_EVENT_IOC_ENABLE, 0);
+    }
+#endif
+  }
+
+  uint64_t Stop() {
+    uint64_t count = 0;
+#ifdef __linux__
+    if (m_fd >= 0) {
+      ioctl(m_fd, PERF_EVENT_IOC_DISABLE, 0);
+      if (read(m_fd, &count, sizeof(count)) != sizeof(count))
+        count = 0;
+    }
+#endif
+    return count;
+  }
+
+private:
+  int m_fd{-1};
+};
+
+/// Chain of pipes through side x side points laid out as a serpentine, the id of the k-th point is ids[k]
+std::shared_ptr<Fluids::System> Make_serpentine(size_t side, const std::vector<size_t> &ids) {
+  auto sys = std::make_shared<Fluids::System>(Fluids::Liquid(), ids.size());
+  for (size_t k = 0; k + 1 < ids.size(); ++k) {
+    auto diameter = (0.15 + 0.05 * static_cast<double>(k % 3)) * si::meter;
+    sys->add_FluidComponent(std::make_shared<Fluids::Pipes>(diameter, 10. * si::meter, 4.6e-5 * si::meters),
+                            ids[k], ids[k + 1]);
+  }
+  sys->Initialize();
+  sys->Set_Known_Static_Pressure(ids.front(), static_cast<quantity<si::pressure>>(1.5 * si::bar));
+  sys->Set_Known_Static_Pressure(ids.back(), static_cast<quantity<si::pressure>>(1. * si::bar));
+  return sys;
+}
+
+/// Storage order of a system with its solve state and measurements
+struct Case {
+  const char *name;
+  std::shared_ptr<const Fluids::Model> model;
+  std::unique_ptr<Fluids::SolveState> state;
+  std::vector<double> times; //! Milliseconds of every solve
+  uint64_t misses{0};
+
+  Case(const char *name, const std::shared_ptr<Fluids::System> &sys)
+      : name(name), model(std::make_shared<const Fluids::Model>(sys)),
+        state(std::make_unique<Fluids::SolveState>(model)) {
+    state->Solve(); // Warm up
+  }
+
+  void Solve(CacheMisses &counter) {
+    state->Set_Unknown_vector(model->Get_Initial_vector());
+    counter.Start();
+    const auto start = std::chrono::steady_clock::now();
+    state->Solve();
+    const auto stop = std::chrono::steady_clock::now();
+    misses += counter.Stop();
+    times.push_back(std::chrono::duration<double, std::milli>(stop - start).count());
+  }
+
+  void Report(bool with_misses) {
+    size_t bandwidth = 0;
+    double span = 0.;
+    for (auto &&edge : model->Get_Description().edges) {
+      const auto distance = static_cast<size_t>(std::abs(edge.u - edge.v));
+      bandwidth = std::max(bandwidth, distance);
+      span += static_cast<double>(distance);
+    }
+    span /= static_cast<double>(model->Get_Description().edges.size());
+    std::nth_element(times.begin(), times.begin() + times.size() / 2, times.end());
+    std::cout << name << ": bandwidth " << bandwidth << ", mean edge span " << span << ", median "
+              << times[times.size() / 2] << " ms per solve";
+    if (with_misses)
+      std::cout << ", " << misses / times.size() << " cache misses per solve";
+    std::cout << std::endl;
+  }
+};
+
+}
+
+int main(int argc, char *argv[]) {
+  const size_t side = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 60;
+  const size_t solves = std::max<size_t>(argc > 2 ? std::strtoul(argv[2], nullptr, 10) : 5, 1);
+  std::vector<size_t> ids(side * side);
+  std::iota(ids.begin(), ids.end(), 0);
+  std::shuffle(ids.begin(), ids.end(), std::mt19937(42));
+
+  std::vector<Case> cases;
+  cases.emplace_back("insertion order", Make_serpentine(side, ids));
+  auto sys = Make_serpentine(side, ids);
+  sys->Reorder();
+  cases.emplace_back("reverse Cuthill-McKee", sys);
+  Eigen::MatrixX2d coordinates(side * side, 2);
+  for (size_t k = 0; k < side * side; ++k) {
+    const size_t row = k / side;
+    const size_t column = row % 2 == 0 ? k % side : side - 1 - k % side;
+    coordinates.row(static_cast<Eigen::Index>(ids[k])) << static_cast<double>(column), static_cast<double>(row);
+  }
+  sys = Make_serpentine(side, ids);
+  sys->Reorder(coordinates);
+  cases.emplace_back("Hilbert curve", sys);
+
+  CacheMisses counter;
+  for (size_t k = 0; k < solves; ++k)
+    for (auto &&c : cases)
+      c.Solve(counter);
+  std::cout << side * side << " vertices with shuffled ids";
+  if (!counter.Is_Available())
+    std::cout << ", perf events are not available: cache misses are not measured";
+  std::cout << std::endl;
+  for (auto &&c : cases)
+    c.Report(counter.Is_Available());
+  return 0;
+}
@@ -0,0 +1,240 @@
+// MIT License
+//
+// Copyright (c) 2019 Jelle Spijker
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+
+// Solver daemon: keeps the models of checkpointed networks warm in a Service and answers the messages of its
+// protocol over a Unix domain socket. Every message, in both directions, is preceded by its size as a 32 bit
+// unsigned integer. A connection sends any number of requests and receives the responses in the same order, the
+// connections are served concurrently and share the models and the thread pool. The socket is only accessible to
+// the user of the daemon, a message larger than the maximum closes its connection, connections beyond the maximum
+// are closed when accepted and Load messages only read checkpoints in the checkpoint directory.
+//   fluidsd <socket> [--threads n] [--tolerance t] [--max-message bytes] [--max-connections n]
+//           [--max-scenarios n] [--checkpoints directory] [name=checkpoint ...]
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <csignal>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include <fluids/Service.h>
+#include <fluids/ThreadPool.h>
+
+namespace {
+
+std::atomic<bool> g_stop{false};
+
+void Stop(int) {
+  g_stop = true;
+}
+
+bool Read_all(int fd, char *data, size_t size) {
+  while (size > 0) {
+    const ssize_t n = ::recv(fd, data, size, 0);
+    if (n < 0 && errno == EINTR)
+      continue;
+    if (n <= 0)
+      return false;
+    data += n;
+    size -= static_cast<size_t>(n);
+  }
+  return true;
+}
+
+bool Write_all(int fd, const char *data, size_t size) {
+  while (size > 0) {
+    const ssize_t n = ::send(fd, data, size, MSG_NOSIGNAL);
+    if (n < 0 && errno == EINTR)
+      continue;
+    if (n <= 0)
+      return false;
+    data += n;
+    size -= static_cast<size_t>(n);
+  }
+  return true;
+}
+
+/// Answer the requests of a connection until the client closes it
+void Serve(int fd, Fluids::Service &service, uint32_t max_message) {
+  std::string message;
+  while (true) {
+    uint32_t size;
+    if (!Read_all(fd, reinterpret_cast<char *>(&size), sizeof(size)) || size > max_message)
+      break;
+    message.resize(size);
+    if (!Read_all(fd, &message[0], size))
+      break;
+    const std::string response = service.Handle(message);
+    // The service bounds its responses, a larger one would lose the frames of the stream
+    if (response.size() > Fluids::Service::Max_response)
+      break;
+    const auto response_size = static_cast<uint32_t>(response.size());
+    if (!Write_all(fd, reinterpret_cast<const char *>(&response_size), sizeof(response_size))
+        || !Write_all(fd, response.data(), response.size()))
+      break;
+  }
+}
+
+struct Connection {
+  int fd;
+  std::thread thread;
+  std::atomic<bool> done{false};
+};
+
+int Usage() {
+  std::cerr << "usage: fluidsd <socket> [--threads n] [--tolerance t] [--max-message bytes] [--max-connections n]"
+               " [--max-scenarios n] [--checkpoints directory] [name=checkpoint ...]" << std::endl;
+  return 2;
+}
+
+}
+
+int main(int argc, char *argv[]) {
+  if (argc < 2)
+    return Usage();
+  const std::string path = argv[1];
+  size_t threads = std::thread::hardware_concurrency();
+  double tolerance = 1.e-6;
+  uint32_t max_message = 1u << 24;
+  size_t max_connections = 64;
+  size_t max_scenarios = 1u << 16;
+  std::string checkpoint_directory;
+  std::list<std::pair<std::string, std::string>> checkpoints;
+  for (int i = 2; i < argc; ++i) {
+    const std::string argument = argv[i];
+    if (argument == "--threads" && i + 1 < argc) {
+      threads = std::strtoul(argv[++i], nullptr, 10);
+    } else if (argument == "--tolerance" && i + 1 < argc) {
+      tolerance = std::strtod(argv[++i], nullptr);
+    } else if (argument == "--max-message" && i + 1 < argc) {
+      max_message = static_cast<uint32_t>(std::min<unsigned long>(std::strtoul(argv[++i], nullptr, 10), UINT32_MAX));
+    } else if (argument == "--max-connections" && i + 1 < argc) {
+      max_connections = std::strtoul(argv[++i], nullptr, 10);
+    } else if (argument == "--max-scenarios" && i + 1 < argc) {
+      max_scenarios = std::strtoul(argv[++i], nullptr, 10);
+    } else if (argument == "--checkpoints" && i + 1 < argc) {
+      checkpoint_directory = argv[++i];
+    } else if (argument.find('=') != std::string::npos) {
+      checkpoints.emplace_back(argument.substr(0, argument.find('=')), argument.substr(argument.find('=') + 1));
+    } else {
+      return Usage();
+    }
+  }
+
+  Fluids::Service service(std::make_shared<Fluids::ThreadPool>(threads));
+  service.Set_Tolerance(tolerance);
+  service.Set_Max_scenarios(max_scenarios);
+  service.Set_Checkpoint_directory(checkpoint_directory);
+  for (auto &&checkpoint : checkpoints) {
+    try {
+      const size_t n = service.Load(checkpoint.first, checkpoint.second);
+      std::cerr << "fluidsd: loaded " << checkpoint.first << " (" << n << " vertices)" << std::endl;
+    } catch (const std::exception &e) {
+      std::cerr << "fluidsd: " << checkpoint.first << ": " << e.what() << std::endl;
+      return 1;
+    }
+  }
+
+  sockaddr_un address{};
+  address.sun_family = AF_UNIX;
+  if (path.size() >= sizeof(address.sun_path)) {
+    std::cerr << "fluidsd: socket path is too long" << std::endl;
+    return 1;
+  }
+  std::strncpy(address.sun_path, path.c_str(), sizeof(address.sun_path) - 1);
+  // A socket left behind by a previous run is replaced, any other file is not
+  struct stat status{};
+  if (::stat(path.c_str(), &status) == 0 && S_ISSOCK(status.st_mode))
+    ::unlink(path.c_str());
+  // Only the user of the daemon may connect, the socket is created without other permissions and set explicitly
+  const int listener = ::socket(AF_UNIX, SOCK_STREAM, 0);
+  const mode_t mask = ::umask(0177);
+  const bool bound = listener >= 0 && ::bind(listener, reinterpret_cast<sockaddr *>(&address), sizeof(address)) == 0;
+  ::umask(mask);
+  if (!bound || ::chmod(path.c_str(), S_IRUSR | S_IWUSR) != 0 || ::listen(listener, 64) != 0) {
+    std::cerr << "fluidsd: " << path << ": " << std::strerror(errno) << std::endl;
+    return 1;
+  }
+  std::signal(SIGINT, Stop);
+  std::signal(SIGTERM, Stop);
+  std::signal(SIGPIPE, SIG_IGN);
+  std::cerr << "fluidsd: listening on " << path << " with " << threads << " threads, at most " << max_connections
+            << " connections" << std::endl;
+
+  std::list<Connection> connections;
+  while (!g_stop) {
+    pollfd poll_listener{listener, POLLIN, 0};
+    const int ready = ::poll(&poll_listener, 1, 250);
+    // Join the connections that were closed by their clients
+    connections.remove_if([](Connection &connection) {
+      if (!connection.done)
+        return false;
+      connection.thread.join();
+      ::close(connection.fd);
+      return true;
+    });
+    if (ready <= 0)
+      continue;
+    const int fd = ::accept(listener, nullptr, nullptr);
+    if (fd < 0)
+      continue;
+    if (connections.size() >= max_connections) {
+      ::close(fd);
+      continue;
+    }
+    connections.emplace_back();
+    Connection &connection = connections.back();
+    connection.fd = fd;
+    connection.thread = std::thread([&connection, &service, max_message]() {
+      Serve(connection.fd, service, max_message);
+      connection.done = true;
+    });
+  }
+
+  ::close(listener);
+  ::unlink(path.c_str());
+  for (auto &&connection : connections) {
+    ::shutdown(connection.fd, SHUT_RDWR);
+    connection.thread.join();
+    ::close(connection.fd);
+  }
+  const Fluids::ServiceStatistics statistics = service.Get_Statistics();
+  std::cerr << "fluidsd: " << statistics.requests << " requests (" << statistics.failures << " failed), "
+            << statistics.scenarios << " scenarios, " << statistics.Throughput() << " scenarios/s, mean latency "
+            << statistics.Mean_latency() * 1e3 << " ms, max latency " << statistics.max_latency * 1e3 << " ms"
+            << std::endl;
+  return 0;
+}
@@ -0,0 +1,88 @@
+// MIT License
+//
+// Copyright (c) 2019 Jelle Spijker
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+
+#ifndef LIBFLUIDS_ARENA_H
+#define LIBFLUIDS_ARENA_H
+
+#include <cstddef>
+#include <memory>
+#include <memory_resource>
+#include <utility>
+
+namespace Fluids {
+
+/// Memory resource of the objects and quantities a System creates, shared by the system and its objects
+typedef std::shared_ptr<std::pmr::memory_resource> Arena;
+
+/// Monotonic arena on top of an upstream resource: an allocation is a pointer bump in a few large buffers, a
+/// deallocation does nothing and the buffers are released at once when the arena is destroyed
+/// \param upstream resource of the buffers, it must outlive the arena
+/// \param initial_size bytes of the first buffer, chosen by the resource when zero
+Arena Make_arena(std::pmr::memory_resource *upstream = std::pmr::get_default_resource(), size_t initial_size = 0);
+
+/// Allocator of the objects of an arena. The allocator holds the arena, so that the arena lives as long as any
+/// object allocated in it, e.g. a liquid of a system that outlives the system.
+template<typename T>
+class ArenaAllocator {
+public:
+  typedef T value_type;
+
+  explicit ArenaAllocator(const Arena &arena) : m_arena(arena) {}
+  template<typename U>
+  ArenaAllocator(const ArenaAllocator<U> &other) : m_arena(other.Get_Arena()) {}
+
+  T *allocate(size_t n) {
+    return static_cast<T *>(m_arena->allocate(n * sizeof(T), alignof(T)));
+  }
+  void deallocate(T *p, size_t n) {
+    m_arena->deallocate(p, n * sizeof(T), alignof(T));
+  }
+
+  const Arena &Get_Arena() const {
+    return m_arena;
+  }
+
+  template<typename U>
+  bool operator==(const ArenaAllocator<U> &other) const {
+    return m_arena == other.Get_Arena();
+  }
+  template<typename U>
+  bool operator!=(const ArenaAllocator<U> &other) const {
+    return m_arena != other.Get_Arena();
+  }
+
+private:
+  Arena m_arena;
+};
+
+/// Shared object in an arena, with one allocation for the object and its control block, on the heap without arena
+template<typename T, typename... Args>
+std::shared_ptr<T> Make_shared(const Arena &arena, Args &&... args) {
+  if (!arena)
+    return std::make_shared<T>(std::forward<Args>(args)...);
+  return std::allocate_shared<T>(ArenaAllocator<T>(arena), std::forward<Args>(args)...);
+}
+
+}
+
+#endif //LIBFLUIDS_ARENA_H
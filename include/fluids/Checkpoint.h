@@ -0,0 +1,64 @@
+// MIT License
+//
+// Copyright (c) 2019 Jelle Spijker
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+
+#ifndef LIBFLUIDS_CHECKPOINT_H
+#define LIBFLUIDS_CHECKPOINT_H
+
+#include <cstdint>
+#include <istream>
+#include <memory>
+#include <ostream>
+
+#include "System.h"
+#include "SolutionCache.h"
+
+namespace Fluids {
+
+/// Binary checkpoint of a system: its topology, the parameters of its components, the values of its quantities
+/// (i.e. the converged state), its known/unknown partition, its storage order (see System::Reorder) and optionally
+/// the entries of a solution cache. A restored system has the same vertex ids, unknown vector and topology version
+/// as the saved one, so a solver with the restored cache returns the saved solutions without iterating. The
+/// symbolic analysis of the Jacobian is not saved, it is redone by the first solve.
+///
+/// The checkpoint starts with a magic number, a format version and an endianness marker, followed by the size of
+/// the payload and the payload, and ends with a checksum of the payload. Only pipes and plain components can be
+/// saved.
+class Checkpoint {
+public:
+  /// Format version written by Save, Restore reads only this version
+  static const uint32_t Version;
+
+  /// Write a checkpoint of the system
+  /// \param cache entries of the cache written along with the system, none when null
+  static void Save(std::ostream &stream, const System &system, const SolutionCache *cache = nullptr);
+
+  /// Read a checkpoint, std::runtime_error when it is truncated, corrupt, of another format version or written on a
+  /// machine of other endianness
+  /// \param cache when not null, the entries of the cache are replaced by the saved ones (with their resolution)
+  /// \return system in its own arena
+  static std::shared_ptr<System> Restore(std::istream &stream, SolutionCache *cache = nullptr);
+};
+
+}
+
+#endif //LIBFLUIDS_CHECKPOINT_H
@@ -0,0 +1,91 @@
+// MIT License
+//
+// Copyright (c) 2019 Jelle Spijker
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+
+#ifndef LIBFLUIDS_CONTINUATION_H
+#define LIBFLUIDS_CONTINUATION_H
+
+#include <functional>
+#include <memory>
+#include <vector>
+
+#include <Eigen/Core>
+
+#include "System.h"
+#include "SolverStrategy.h"
+
+namespace Fluids {
+
+/// Solution of the system at a value of the continuation parameter
+struct ContinuationPoint {
+  double parameter{0.};
+  Eigen::VectorXd state; //! Unknown vector, ordered as System::Get_Initial_vector()
+  size_t iterations{0};  //! Corrector iterations
+  bool requested{false}; //! Point of the requested path, otherwise an intermediate step
+};
+
+/// Natural parameter continuation with a predictor-corrector scheme. A parameter (supply pressure, demand, valve
+/// setting...) is applied to the system by a setter and advanced along a path. Each step predicts the solution with
+/// the tangent of the curve (the secant of the last two accepted points after the first step), corrects it with
+/// chord-Newton iterations on a sparse Jacobian whose symbolic analysis is shared by all steps and adapts the step
+/// size to the number of corrector iterations.
+class Continuation {
+public:
+  typedef std::function<void(System &, double)> Parameter_setter;
+
+  Continuation(const std::shared_ptr<System> &system, const Parameter_setter &setter);
+
+  /// Trace the solution curve along the path, the system is left at the last point
+  /// \param path parameter values that must be on the curve
+  /// \return accepted points, including the intermediate steps
+  std::vector<ContinuationPoint> Trace(const std::vector<double> &path);
+
+  /// Counters over the whole trace
+  const SolverStatistics &Get_Statistics() const;
+
+  double Get_Tolerance() const;
+  void Set_Tolerance(double tolerance);
+
+  size_t Get_Max_corrector_iterations() const;
+  void Set_Max_corrector_iterations(size_t max_corrector_iterations);
+
+  /// Smallest step, relative to the segment of the path, before the trace is given up
+  double Get_Min_step() const;
+  void Set_Min_step(double min_step);
+
+private:
+  struct Session;
+  std::shared_ptr<System> m_system;
+  Parameter_setter m_setter;
+  double m_tolerance{1.e-6};
+  size_t m_max_corrector_iterations{8};
+  double m_min_step{1.e-6};
+  SolverStatistics m_statistics;
+  std::shared_ptr<Session> m_session;
+
+  bool Correct(double parameter, Eigen::VectorXd &x, size_t max_iterations, size_t &iterations);
+  Eigen::VectorXd Tangent(double parameter, const Eigen::VectorXd &x);
+};
+
+}
+
+#endif //LIBFLUIDS_CONTINUATION_H
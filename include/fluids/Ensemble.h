@@ -0,0 +1,94 @@
+// MIT License
+//
+// Copyright (c) 2019 Jelle Spijker
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+
+#ifndef LIBFLUIDS_ENSEMBLE_H
+#define LIBFLUIDS_ENSEMBLE_H
+
+#include <memory>
+#include <vector>
+
+#include <Eigen/Core>
+
+#include "Model.h"
+#include "System.h"
+#include "SolverStrategy.h"
+#include "ThreadPool.h"
+
+namespace Fluids {
+
+/// Lockstep solution of many scenarios (lanes) of one system that only differ in their known speeds and static
+/// pressures, e.g. the samples of a Monte Carlo demand study. The system is flattened once and every residual
+/// evaluation computes all lanes with packed arithmetic, the coloured finite difference Jacobian is shared by the
+/// lanes as well. Each lane is factored and line searched on its own and is masked out as soon as it converges, so
+/// the ensemble iterates until the slowest lane has converged. The ensemble works on a Model, the system itself is
+/// not modified besides being initialized. Requires as many residuals as unknowns.
+class Ensemble {
+public:
+  Ensemble(const std::shared_ptr<System> &system, size_t lanes);
+  Ensemble(const std::shared_ptr<const Model> &model, size_t lanes);
+
+  size_t Get_Lanes() const;
+
+  /// Known speed of a vertex in every lane, the vertex must have a known speed in the system
+  void Set_Known_Speed(const size_t &vertex, const Eigen::ArrayXd &speed);
+  /// Known static pressure of a vertex in every lane, the vertex must have a known static pressure in the system
+  void Set_Known_Static_Pressure(const size_t &vertex, const Eigen::ArrayXd &pressure);
+  /// Open (1) or closed (0) component between two vertices in every lane, e.g. the valve positions of a scenario. A
+  /// component whose first vertex branches can not be closed, see System::Set_Active.
+  void Set_Active(const size_t &vertex_u, const size_t &vertex_v, const Eigen::ArrayXd &open);
+
+  /// Solve all lanes, starting from the initial vector of the model
+  /// \return number of converged lanes
+  size_t Solve();
+
+  /// Unknown vector of a lane, ordered as System::Get_Unknown_vector()
+  Eigen::VectorXd Get_State(size_t lane) const;
+  Eigen::ArrayXd Get_Speed(const size_t &vertex) const;
+  Eigen::ArrayXd Get_Static_pressure(const size_t &vertex) const;
+
+  /// Counters of every lane of the last solve
+  const std::vector<SolverStatistics> &Get_Statistics() const;
+
+  double Get_Tolerance() const;
+  void Set_Tolerance(double tolerance);
+
+  size_t Get_Max_iterations() const;
+  void Set_Max_iterations(size_t max_iterations);
+
+  /// Threads of the residual and Jacobian evaluations, the results do not depend on the number of threads
+  const std::shared_ptr<ThreadPool> &Get_Thread_pool() const;
+  void Set_Thread_pool(const std::shared_ptr<ThreadPool> &pool);
+
+private:
+  struct Session;
+  size_t m_lanes;
+  double m_tolerance{1.e-6}; //! Norm of the residual vector of a lane at convergence
+  size_t m_max_iterations{100};
+  std::shared_ptr<ThreadPool> m_pool; //! Serial when null
+  std::vector<SolverStatistics> m_statistics;
+  std::shared_ptr<Session> m_session;
+};
+
+}
+
+#endif //LIBFLUIDS_ENSEMBLE_H
@@ -0,0 +1,106 @@
+// MIT License
+//
+// Copyright (c) 2019 Jelle Spijker
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+
+#ifndef LIBFLUIDS_EXTENDEDPERIOD_H
+#define LIBFLUIDS_EXTENDEDPERIOD_H
+
+#include <functional>
+#include <memory>
+#include <vector>
+
+#include <Eigen/Core>
+
+#include "Model.h"
+#include "SolverStrategy.h"
+#include "ThreadPool.h"
+
+namespace Fluids {
+
+/// Multipliers of a base value, each held for one interval, repeated after the last one
+struct Pattern {
+  quantity<si::time> interval{3600. * si::seconds};
+  std::vector<double> multipliers;
+
+  /// Multiplier at a time since the start of the simulation
+  double At(const quantity<si::time> &time) const;
+};
+
+/// Result of a time step, only valid during the step callback
+struct PeriodStep {
+  size_t index{0};
+  quantity<si::time> time{0. * si::seconds};
+  const SolveState *state{nullptr}; //! Solution of the step
+  SolverStatistics statistics;
+};
+
+/// Extended-period simulation of a model whose known speeds (demands) and static pressures (supplies) follow time
+/// patterns. Every step is a steady state solve warm-started from the previous step with a single solve state, so the
+/// symbolic analysis of the Jacobian is done once for the whole simulation. A step that fails from the warm start is
+/// retried from the initial vector of the model. The steps are handed to a callback as they are solved and nothing
+/// is kept, the memory does not grow with the duration.
+class ExtendedPeriod {
+public:
+  typedef std::function<void(const PeriodStep &)> Step_callback;
+
+  explicit ExtendedPeriod(const std::shared_ptr<const Model> &model);
+
+  /// Known speed of a vertex is base * pattern(t), the vertex must have a known speed in the model
+  void Add_Speed_pattern(const size_t &vertex, const quantity<si::velocity> &base, const Pattern &pattern);
+  /// Known static pressure of a vertex is base * pattern(t), the vertex must have a known static pressure
+  void Add_Static_pressure_pattern(const size_t &vertex, const quantity<si::pressure> &base, const Pattern &pattern);
+
+  /// Simulate the steps t = 0, step, 2 step... up to and including the duration
+  /// \param duration length of the simulation
+  /// \param step time step
+  /// \param callback called after every step
+  /// \return counters summed over all steps, converged when every step converged
+  SolverStatistics Run(const quantity<si::time> &duration, const quantity<si::time> &step,
+                       const Step_callback &callback);
+
+  double Get_Tolerance() const;
+  void Set_Tolerance(double tolerance);
+
+  size_t Get_Max_iterations() const;
+  void Set_Max_iterations(size_t max_iterations);
+
+  const std::shared_ptr<ThreadPool> &Get_Thread_pool() const;
+  void Set_Thread_pool(const std::shared_ptr<ThreadPool> &pool);
+
+private:
+  struct Driver {
+    size_t vertex;
+    bool pressure; //! Static pressure, otherwise speed
+    double base;
+    Pattern pattern;
+  };
+
+  std::shared_ptr<const Model> m_model;
+  std::vector<Driver> m_drivers;
+  double m_tolerance{1.e-6}; //! Norm of the residual vector at convergence
+  size_t m_max_iterations{100};
+  std::shared_ptr<ThreadPool> m_pool;
+};
+
+}
+
+#endif //LIBFLUIDS_EXTENDEDPERIOD_H
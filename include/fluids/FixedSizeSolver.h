@@ -0,0 +1,278 @@
+// MIT License
+//
+// Copyright (c) 2019 Jelle Spijker
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+
+#ifndef LIBFLUIDS_FIXEDSIZESOLVER_H
+#define LIBFLUIDS_FIXEDSIZESOLVER_H
+
+#include <array>
+#include <cmath>
+#include <limits>
+#include <stdexcept>
+
+#include <Eigen/Core>
+#include <Eigen/LU>
+
+#include "Liquid.h"
+#include "Model.h"
+#include "Pipes.h"
+#include "SolverStrategy.h"
+
+namespace Fluids {
+
+/// Newton solve of a small model with N unknowns in fixed-size storage. The description of the model is copied into
+/// arrays of compile time capacity on construction, after which the residual, the dense finite difference Jacobian
+/// and its factorization live on the stack: setting the known values and solving never allocate, for repeated
+/// solves of a fixed topology at a high rate. The capacities bound the number of vertices, edges and mass balance
+/// terms of the model, a model exceeding them or with another number of unknowns is rejected.
+template<int N, int MaxVertices = 2 * N + 2, int MaxEdges = 2 * N + 2, int MaxTerms = 4 * N + 4>
+class FixedSizeSolver {
+public:
+  typedef Eigen::Matrix<double, N, 1> Vector;
+  typedef Eigen::Matrix<double, N, N> Matrix;
+
+  explicit FixedSizeSolver(const Model &model) {
+    const ModelDescription &description = model.Get_Description();
+    if (description.n_unknowns != N
+        || description.bernoulli_rows.size() + description.mass_rows.size() != static_cast<size_t>(N))
+      throw std::logic_error("The model does not have as many unknowns and residuals as the fixed size.");
+    if (description.vertices.size() > static_cast<size_t>(MaxVertices)
+        || description.edges.size() > static_cast<size_t>(MaxEdges))
+      throw std::logic_error("The model exceeds the vertex or edge capacity of the fixed size solver.");
+    m_n_vertices = static_cast<int>(description.vertices.size());
+    m_n_edges = static_cast<int>(description.edges.size());
+    m_n_bernoulli = static_cast<int>(description.bernoulli_rows.size());
+    // The vertices are stored by vertex id, a reordered model is copied back into the order of the ids
+    std::array<Eigen::Index, MaxVertices> id;
+    for (int v = 0; v < m_n_vertices; ++v) {
+      const auto i = static_cast<Eigen::Index>(description.Index(static_cast<size_t>(v)));
+      id[i] = v;
+      m_vertices[v] = description.vertices[i];
+      m_speeds[v] = description.speeds(i);
+      m_static_pressures[v] = description.static_pressures(i);
+    }
+    for (int k = 0; k < m_n_edges; ++k) {
+      m_edges[k] = description.edges[k];
+      m_edges[k].u = id[m_edges[k].u];
+      m_edges[k].v = id[m_edges[k].v];
+    }
+    for (int row = 0; row < m_n_bernoulli; ++row)
+      m_bernoulli_rows[row] = description.bernoulli_rows[row];
+    int n_terms = 0;
+    for (size_t k = 0; k < description.mass_rows.size(); ++k) {
+      const ModelDescription::MassRow &mass = description.mass_rows[k];
+      if (n_terms + mass.edges.size() > static_cast<size_t>(MaxTerms))
+        throw std::logic_error("The model exceeds the mass balance capacity of the fixed size solver.");
+      MassRow &row = m_mass_rows[k];
+      row.outlet = mass.outlet < 0 ? mass.outlet : id[mass.outlet];
+      row.area = mass.area;
+      row.begin = n_terms;
+      for (auto &&term : mass.edges)
+        m_terms[n_terms++] = term;
+      row.end = n_terms;
+    }
+    m_x = model.Get_Initial_vector();
+  }
+
+  /// Known speed of a vertex, the vertex must have a known speed in the model
+  void Set_Known_Speed(const size_t &vertex, const quantity<si::velocity> &speed) {
+    if (vertex >= static_cast<size_t>(m_n_vertices) || m_vertices[vertex].speed >= 0)
+      throw std::logic_error("The speed of the vertex is not a known value of the model.");
+    m_speeds[vertex] = speed.value();
+  }
+
+  /// Known static pressure of a vertex, the vertex must have a known static pressure in the model
+  void Set_Known_Static_Pressure(const size_t &vertex, const quantity<si::pressure> &pressure) {
+    if (vertex >= static_cast<size_t>(m_n_vertices) || m_vertices[vertex].pressure >= 0)
+      throw std::logic_error("The static pressure of the vertex is not a known value of the model.");
+    m_static_pressures[vertex] = pressure.value();
+  }
+
+  /// Residual at x with the current known values, ordered as System::Get_Return_vec()
+  void Residual(const Vector &x, Vector &residual) const {
+    std::array<double, MaxVertices> speed;
+    std::array<double, MaxVertices> bernoulli;
+    std::array<double, MaxEdges> massflow;
+    for (int i = 0; i < m_n_vertices; ++i) {
+      const ModelDescription::Vertex &vertex = m_vertices[i];
+      speed[i] = vertex.speed >= 0 ? x(vertex.speed) : m_speeds[i];
+      const double pressure = vertex.pressure >= 0 ? x(vertex.pressure) : m_static_pressures[i];
+      bernoulli[i] = Liquid::Bernoulli(Scalar(pressure), Scalar(speed[i]), vertex.density,
+                                       vertex.potential_pressure)(0);
+    }
+    for (int k = 0; k < m_n_edges; ++k) {
+      const ModelDescription::Edge &edge = m_edges[k];
+      const double density = m_vertices[edge.u].density;
+      if (edge.kind != ModelDescription::Kind::Transport)
+        massflow[k] = edge.area * density * speed[edge.u];
+      else
+        massflow[k] = density * (edge.flow >= 0 ? x(edge.flow) : edge.known_flow);
+    }
+    for (int row = 0; row < m_n_bernoulli; ++row) {
+      const ModelDescription::Edge &edge = m_edges[m_bernoulli_rows[row]];
+      if (!edge.active) {
+        residual(row) = massflow[m_bernoulli_rows[row]];
+        continue;
+      }
+      residual(row) = bernoulli[edge.u] - bernoulli[edge.v];
+      if (edge.kind == ModelDescription::Kind::Pipe) {
+        const ModelDescription::Vertex &vertex = m_vertices[edge.u];
+        // c f Q^2, with Q = A v
+        const double scale = Pipes::Loss_coefficient(edge.length, edge.diameter, vertex.density) * edge.area
+            * edge.area;
+        const double friction = Pipes::Haaland(Pipes::Reynolds(Scalar(speed[edge.u]), edge.diameter, vertex.density,
+                                                               vertex.dynamic_viscosity),
+                                               edge.relative_roughness)(0);
+        residual(row) -= scale * friction * speed[edge.u] * speed[edge.u];
+      } else {
+        residual(row) -= edge.delta_pressure;
+      }
+    }
+    for (int k = 0; k < N - m_n_bernoulli; ++k) {
+      const MassRow &mass = m_mass_rows[k];
+      double sum = 0.;
+      for (int t = mass.begin; t < mass.end; ++t)
+        sum += m_terms[t].second * massflow[m_terms[t].first];
+      if (mass.outlet >= 0)
+        sum -= mass.area * m_vertices[mass.outlet].density * speed[mass.outlet];
+      residual(m_n_bernoulli + k) = sum;
+    }
+  }
+
+  /// Damped Newton iteration from the current iterate (the initial vector of the model at first)
+  /// \return counters of this solve
+  SolverStatistics Solve() {
+    const double epsilon = std::sqrt(std::numeric_limits<double>::epsilon());
+    SolverStatistics statistics;
+    Vector residual, trial_residual, x_perturbed, step;
+    Matrix jacobian;
+    Residual(m_x, residual);
+    ++statistics.residual_evaluations;
+    double norm = residual.norm();
+    while (norm > m_tolerance && statistics.iterations < m_max_iterations) {
+      ++statistics.iterations;
+      for (int j = 0; j < N; ++j) {
+        x_perturbed = m_x;
+        x_perturbed(j) += epsilon * std::max(std::abs(m_x(j)), 1.);
+        Residual(x_perturbed, trial_residual);
+        jacobian.col(j) = (trial_residual - residual) / (x_perturbed(j) - m_x(j));
+      }
+      statistics.residual_evaluations += N;
+      ++statistics.jacobian_evaluations;
+      Eigen::PartialPivLU<Matrix> lu(jacobian);
+      ++statistics.factorizations;
+      if (lu.matrixLU().diagonal().cwiseAbs().minCoeff() == 0.)
+        break;
+      step = -lu.solve(residual);
+
+      // Backtracking until the residual decreases
+      double lambda = 1.;
+      bool decreased = false;
+      for (size_t k = 0; k < 30 && !decreased; ++k, lambda *= 0.5) {
+        x_perturbed = m_x + lambda * step;
+        Residual(x_perturbed, trial_residual);
+        ++statistics.residual_evaluations;
+        const double trial_norm = trial_residual.norm();
+        if (trial_norm < norm) {
+          m_x = x_perturbed;
+          residual = trial_residual;
+          norm = trial_norm;
+          decreased = true;
+        }
+      }
+      if (!decreased)
+        break;
+    }
+    statistics.residual_norm = norm;
+    statistics.converged = norm <= m_tolerance;
+    return statistics;
+  }
+
+  /// Current iterate, ordered as System::Get_Unknown_vector()
+  const Vector &Get_Unknown_vector() const {
+    return m_x;
+  }
+  void Set_Unknown_vector(const Vector &x) {
+    m_x = x;
+  }
+
+  quantity<si::velocity> Get_Speed(const size_t &vertex) const {
+    if (vertex >= static_cast<size_t>(m_n_vertices))
+      throw std::out_of_range("Vertex index out of range.");
+    const Eigen::Index column = m_vertices[vertex].speed;
+    return (column >= 0 ? m_x(column) : m_speeds[vertex]) * si::meters_per_second;
+  }
+
+  quantity<si::pressure> Get_Static_pressure(const size_t &vertex) const {
+    if (vertex >= static_cast<size_t>(m_n_vertices))
+      throw std::out_of_range("Vertex index out of range.");
+    const Eigen::Index column = m_vertices[vertex].pressure;
+    return (column >= 0 ? m_x(column) : m_static_pressures[vertex]) * si::pascals;
+  }
+
+  double Get_Tolerance() const {
+    return m_tolerance;
+  }
+  void Set_Tolerance(double tolerance) {
+    m_tolerance = tolerance;
+  }
+
+  size_t Get_Max_iterations() const {
+    return m_max_iterations;
+  }
+  void Set_Max_iterations(size_t max_iterations) {
+    m_max_iterations = max_iterations;
+  }
+
+private:
+  typedef Eigen::Array<double, 1, 1> Single;
+
+  /// Mass balance row, its terms are m_terms[begin, end)
+  struct MassRow {
+    Eigen::Index outlet{-1};
+    double area{0.};
+    int begin{0};
+    int end{0};
+  };
+
+  static Single Scalar(double value) {
+    return Single::Constant(value);
+  }
+
+  std::array<ModelDescription::Vertex, MaxVertices> m_vertices;
+  std::array<ModelDescription::Edge, MaxEdges> m_edges;
+  std::array<Eigen::Index, N> m_bernoulli_rows;
+  std::array<MassRow, N> m_mass_rows;
+  std::array<std::pair<Eigen::Index, double>, MaxTerms> m_terms;
+  std::array<double, MaxVertices> m_speeds;           //! Known speeds, unknown entries are ignored
+  std::array<double, MaxVertices> m_static_pressures; //! Known static pressures, unknown entries are ignored
+  int m_n_vertices{0};
+  int m_n_edges{0};
+  int m_n_bernoulli{0};
+  Vector m_x;
+  double m_tolerance{1.e-6}; //! Norm of the residual vector at convergence
+  size_t m_max_iterations{100};
+};
+
+}
+
+#endif //LIBFLUIDS_FIXEDSIZESOLVER_H
@@ -39,6 +39,9 @@ class FluidComponents {
 public:
   FluidComponents();
   FluidComponents(const std::shared_ptr<Liquid> &liquid_u, const std::shared_ptr<Liquid> &liquid_v);
+  /// Component with its quantities in an arena, on the heap without arena
+  FluidComponents(const std::shared_ptr<Liquid> &liquid_u, const std::shared_ptr<Liquid> &liquid_v,
+                  const Arena &arena);
   FluidComponents(const FluidComponents &other);
 
   virtual ~FluidComponents() = default;
@@ -58,6 +61,15 @@ public:
 
   virtual bool isTransportEdge() const;
 
+  /// Estimated heap bytes of the component and of the quantities it owns, not of its liquids, for MemoryReport. The
+  /// estimate assumes the component was created by std::make_shared and its quantities by new; a derived component
+  /// overrides it with its own size and storage.
+  virtual size_t Get_Heap_bytes() const;
+
+  /// A closed (inactive) component carries no flow, its Bernoulli balance is replaced by its mass flow
+  bool Is_Active() const;
+  void Set_Active(bool active);
+
 protected:
   std::shared_ptr<quantity<si::area>> m_crosssection;
   std::shared_ptr<quantity<si::mass_flow>> m_massflow;
@@ -66,6 +78,10 @@ protected:
   std::shared_ptr<quantity<si::pressure>> m_bernoulli_balance;
   std::shared_ptr<Liquid> m_liquid_u;
   std::shared_ptr<Liquid> m_liquid_v;
+  bool m_active{true};
+
+  /// Estimated heap bytes of the quantities of the base component
+  size_t Quantity_bytes() const;
 };
 }
 
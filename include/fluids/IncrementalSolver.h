@@ -0,0 +1,73 @@
+// MIT License
+//
+// Copyright (c) 2019 Jelle Spijker
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+
+#ifndef LIBFLUIDS_INCREMENTALSOLVER_H
+#define LIBFLUIDS_INCREMENTALSOLVER_H
+
+#include <memory>
+
+#include "System.h"
+#include "SolverStrategy.h"
+
+namespace Fluids {
+
+/// Repeated solves of a system that is edited between the solves (known values, component or liquid parameters,
+/// opening or closing a component with System::Set_Active, which keeps the pattern and the blocks).
+/// The residual is evaluated at the previous solution with the current values of the system, the rows whose value
+/// changed are the edit. The unknowns are divided in the independent blocks of the Jacobian pattern (e.g. the parts
+/// of a network on either side of a vertex with a known speed and static pressure), only the blocks with a changed
+/// row are solved again, by Newton iterations that evaluate the rows of those blocks only, and the other unknowns
+/// are kept. When every block is affected this is a global solve warm-started from the previous solution. A change
+/// of the topology version rebuilds the pattern and solves from the initial vector of the system. The symbolic
+/// analysis of the region's Jacobian is kept while the region is the same, each iteration only factorizes.
+class IncrementalSolver {
+public:
+  explicit IncrementalSolver(const std::shared_ptr<System> &system);
+
+  /// Solve the blocks affected since the previous solve and store their unknowns in the system
+  /// \return counters of this solve, the residual norm is the one of the whole system
+  SolverStatistics Solve();
+
+  /// Unknowns solved by the last solve
+  size_t Get_Region_size() const;
+
+  /// Independent blocks of the unknowns of the current topology
+  size_t n_blocks() const;
+
+  double Get_Tolerance() const;
+  void Set_Tolerance(double tolerance);
+
+  size_t Get_Max_iterations() const;
+  void Set_Max_iterations(size_t max_iterations);
+
+private:
+  struct Data;
+  std::shared_ptr<System> m_system;
+  std::shared_ptr<Data> m_data;
+  double m_tolerance{1.e-6}; //! Norm of the residual vector of the solved blocks at convergence
+  size_t m_max_iterations{100};
+};
+
+}
+
+#endif //LIBFLUIDS_INCREMENTALSOLVER_H
@@ -26,6 +26,9 @@
 
 #include <memory>
 
+#include <Eigen/Core>
+
+#include "Arena.h"
 #include "Units.h"
 
 namespace Fluids {
@@ -33,6 +36,8 @@ class Liquid {
  public:
   Liquid();
   Liquid(const Liquid &other);
+  /// Copy with its quantities in an arena, on the heap without arena
+  Liquid(const Liquid &other, const Arena &arena);
 
   Liquid &operator=(const Liquid &other);
 
@@ -57,6 +62,13 @@ class Liquid {
   const std::shared_ptr<quantity<si::pressure>> &Get_Potential_pressure() const;
   const std::shared_ptr<quantity<si::pressure>> &Get_Bernoulli() const;
 
+  /// Bernoulli pressure of a set of scenarios, one static pressure and speed per lane [SI units]
+  template<typename Pressure, typename Speed>
+  static auto Bernoulli(const Eigen::ArrayBase<Pressure> &static_pressure, const Eigen::ArrayBase<Speed> &speed,
+                        double density, double potential_pressure) {
+    return static_pressure + (0.5 * density) * speed.abs() * speed + potential_pressure;
+  }
+
  private:
   std::shared_ptr<quantity<si::pressure>> m_static_pressure;
   std::shared_ptr<quantity<si::velocity>> m_speed;
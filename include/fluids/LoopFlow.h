@@ -0,0 +1,139 @@
+// MIT License
+//
+// Copyright (c) 2019 Jelle Spijker
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+
+#ifndef LIBFLUIDS_LOOPFLOW_H
+#define LIBFLUIDS_LOOPFLOW_H
+
+#include <memory>
+#include <vector>
+
+#include <Eigen/Core>
+#include <Eigen/SparseCore>
+
+#include "System.h"
+#include "SolverStrategy.h"
+
+namespace Fluids {
+
+/// Steady state solve in loop flows. Every pipe or component carries its own volumetric flow, the flows of a
+/// spanning forest (rooted at the vertices with a known static pressure) follow from the flows of the remaining
+/// edges, the chords, by mass balance. Each chord closes one loop of the fundamental cycle basis, or a path between
+/// two known pressures, so the Newton iteration only has one unknown and one head loss equation per chord. The
+/// Bernoulli pressures are then recovered by a sweep of the forest. Edges with a constant pressure difference are
+/// put in the forest first, so that every chord has a flow dependent loss. Closed components (System::Set_Active)
+/// are left out of the loops.
+///
+/// Known static pressures and known speeds or transported flows are only supported at leaf vertices, every leaf
+/// without a known static pressure needs a known speed or flow. Contrary to the vertex speeds of System, a vertex
+/// may have several outgoing edges with different flows; its speed is the mean speed of the outgoing edges (of the
+/// incoming edges at an outlet), so that on a tree the solution is the one of the system.
+class LoopFlow {
+public:
+  explicit LoopFlow(const std::shared_ptr<System> &system);
+
+  /// Independent loops and paths between known pressures, the number of unknowns
+  size_t n_loops() const;
+
+  /// Newton iteration on the loop equations from the flows of the system, the solution is stored in the system
+  /// \return counters of this solve
+  SolverStatistics Solve();
+
+  /// Flow of a pipe or component, positive from vertex u to vertex v
+  quantity<si::volumetric_flow> Get_Volumetricflow(const size_t &vertex_u, const size_t &vertex_v) const;
+
+  double Get_Tolerance() const;
+  void Set_Tolerance(double tolerance);
+
+  size_t Get_Max_iterations() const;
+  void Set_Max_iterations(size_t max_iterations);
+
+private:
+  struct Edge {
+    size_t u{0};
+    size_t v{0};
+    bool pipe{false};
+    double area{0.};
+    double diameter{0.};
+    double length{0.};
+    double relative_roughness{0.};
+    double delta_pressure{0.};
+    double density{0.};
+    double dynamic_viscosity{0.};
+  };
+
+  struct Node {
+    std::shared_ptr<Liquid> liquid;
+    bool active{false};       //! Connected to a pipe or component
+    bool root{false};         //! Known static pressure
+    bool known_speed{false};
+    double density{0.};
+    double potential{0.};
+    double pressure{0.};      //! Known static pressure of a root
+    double supply{0.};        //! Known external flow entering the vertex
+    double out_area{0.};
+    double in_area{0.};
+    std::vector<size_t> out;
+    std::vector<size_t> in;
+    size_t parent_edge{0};    //! Forest edge towards the root
+    size_t parent{0};
+    size_t depth{0};          //! 1 for a root
+    size_t root_index{0};     //! Root of the tree of the vertex, index in m_roots
+  };
+
+  /// Transport edge of a leaf vertex
+  struct Boundary {
+    size_t vertex{0};
+    bool inlet{false};
+    std::shared_ptr<quantity<si::volumetric_flow>> flow;
+    bool known{false};
+  };
+
+  /// Head loss of an edge at a flow
+  double Loss(const Edge &edge, double flow) const;
+  /// Derivative of the head loss of an edge to its flow, including the change of the Haaland friction factor
+  double Loss_slope(const Edge &edge, double flow) const;
+  /// Speed of a vertex from the edge flows
+  double Speed(const Node &node, const Eigen::VectorXd &flow) const;
+  /// Edge flows, vertex Bernoulli pressures and loop residuals of the chord flows
+  void Evaluate(const Eigen::VectorXd &q, Eigen::VectorXd &flow, Eigen::VectorXd &bernoulli,
+                Eigen::VectorXd &residual) const;
+  void Store(const Eigen::VectorXd &flow, const Eigen::VectorXd &bernoulli) const;
+
+  std::shared_ptr<System> m_system;
+  std::vector<Edge> m_edges;
+  std::vector<Node> m_nodes;
+  std::vector<size_t> m_order;        //! Vertices of the forest, parents before children
+  std::vector<size_t> m_chords;
+  std::vector<size_t> m_roots;
+  std::vector<Boundary> m_boundaries;
+  Eigen::SparseMatrix<double> m_loops; //! Signed edges (rows) of the loop of every chord (columns)
+  Eigen::SparseMatrix<double> m_ends;  //! Roots at the start (+1) and end (-1) of the path of every chord (rows)
+  Eigen::VectorXd m_base_flow;         //! Edge flows with zero chord flows
+  Eigen::VectorXd m_flow;              //! Edge flows of the last solve
+  double m_tolerance{1.e-6};           //! Norm of the loop residuals at convergence [Pa]
+  size_t m_max_iterations{100};
+};
+
+}
+
+#endif //LIBFLUIDS_LOOPFLOW_H
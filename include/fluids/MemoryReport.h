@@ -0,0 +1,89 @@
+// MIT License
+//
+// Copyright (c) 2019 Jelle Spijker
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+
+#ifndef LIBFLUIDS_MEMORYREPORT_H
+#define LIBFLUIDS_MEMORYREPORT_H
+
+#include <atomic>
+#include <cstddef>
+#include <memory_resource>
+
+namespace Fluids {
+class System;
+class Model;
+class SolutionCache;
+
+/// Heap bytes of a system and of the structures derived from it, by category, for capacity planning. The liquids
+/// and transport edges a system creates are counted by a CountingResource when they are allocated (the requested
+/// bytes, in the arena of the system or on the heap). The other sizes are computed from the objects and containers
+/// (allocation sizes rounded up to 16 bytes, without the headers of the allocator), so reports of different systems
+/// are comparable and reproducible. The components that the caller created are not seen when they are allocated,
+/// their bytes are estimated by FluidComponents::Get_Heap_bytes and kept apart. Reports of several objects are added
+/// with +=.
+struct MemoryReport {
+  size_t topology{0};         //! Graph storage and the known/unknown partition
+  size_t vertex_state{0};     //! Liquids of the vertices and their quantities
+  size_t edge_parameters{0};  //! Components of the edges created by the system (transport edges)
+  size_t edge_estimate{0};    //! Components of the edges created by the caller, estimated by the components
+  size_t solver_workspace{0}; //! Flat description, Jacobian pattern, colouring and initial vector of models
+  size_t caches{0};           //! Cached solutions
+
+  size_t Total() const;
+  MemoryReport &operator+=(const MemoryReport &other);
+
+  static MemoryReport Of(const System &system);
+  static MemoryReport Of(const Model &model);
+  static MemoryReport Of(const SolutionCache &cache);
+};
+
+/// Memory resource that counts the bytes allocated through it and forwards to an upstream resource. Containers
+/// with a polymorphic allocator (e.g. std::pmr::vector) or std::allocate_shared use it to measure their actual
+/// allocations, e.g. to regression test the memory per 1000 pipes.
+class CountingResource : public std::pmr::memory_resource {
+public:
+  explicit CountingResource(std::pmr::memory_resource *upstream = std::pmr::new_delete_resource());
+
+  /// Bytes currently allocated
+  size_t Get_Bytes() const;
+  /// Largest number of bytes allocated at once since the construction or the last reset
+  size_t Get_Peak() const;
+  /// Number of allocations since the construction
+  size_t Get_Allocations() const;
+  void Reset_peak();
+
+  std::pmr::memory_resource *Get_Upstream() const;
+
+private:
+  std::pmr::memory_resource *m_upstream;
+  std::atomic<size_t> m_bytes{0};
+  std::atomic<size_t> m_peak{0};
+  std::atomic<size_t> m_allocations{0};
+
+  void *do_allocate(size_t bytes, size_t alignment) override;
+  void do_deallocate(void *p, size_t bytes, size_t alignment) override;
+  bool do_is_equal(const std::pmr::memory_resource &other) const noexcept override;
+};
+
+}
+
+#endif //LIBFLUIDS_MEMORYREPORT_H
@@ -0,0 +1,127 @@
+// MIT License
+//
+// Copyright (c) 2019 Jelle Spijker
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+
+#ifndef LIBFLUIDS_MODEL_H
+#define LIBFLUIDS_MODEL_H
+
+#include <memory>
+
+#include <Eigen/Core>
+
+#include "ModelDescription.h"
+#include "System.h"
+#include "SolverStrategy.h"
+#include "ThreadPool.h"
+
+namespace Fluids {
+struct MemoryReport;
+
+/// Immutable snapshot of an initialized system: the topology, the parameters of the components and liquids, the
+/// known values, the sparsity pattern and colouring of the Jacobian and the initial vector. A model holds no
+/// solver state, it can be shared by any number of concurrent solves without copying or locking. Later changes of
+/// the system do not affect the model.
+class Model {
+public:
+  /// Snapshot of the system, which is initialized first
+  explicit Model(const std::shared_ptr<System> &system);
+
+  size_t n_vertices() const;
+  size_t n_unknowns() const;
+  size_t n_residuals() const;
+
+  bool Is_Known_speed(const size_t &vertex) const;
+  bool Is_Known_static_pressure(const size_t &vertex) const;
+
+  /// Topology version of the system when the snapshot was taken
+  size_t Get_Topology_version() const;
+
+  /// Initial vector of the system when the snapshot was taken, ordered as System::Get_Unknown_vector()
+  const Eigen::VectorXd &Get_Initial_vector() const;
+
+  /// Index based description of the equations, e.g. to instantiate a FixedSizeSolver
+  const ModelDescription &Get_Description() const;
+
+private:
+  friend class SolveState;
+  friend class Ensemble;
+  friend struct MemoryReport;
+  struct Data;
+  std::shared_ptr<const Data> m_data;
+};
+
+/// Per-solve state of a shared model: the known values of one scenario, the iterate and the factorization
+/// workspace. A state is cheap to create and is used by one thread at a time, different states of the same model
+/// can be solved concurrently.
+class SolveState {
+public:
+  explicit SolveState(const std::shared_ptr<const Model> &model);
+
+  const std::shared_ptr<const Model> &Get_Model() const;
+
+  /// Known speed of a vertex, the vertex must have a known speed in the model
+  void Set_Known_Speed(const size_t &vertex, const quantity<si::velocity> &speed);
+  /// Known static pressure of a vertex, the vertex must have a known static pressure in the model
+  void Set_Known_Static_Pressure(const size_t &vertex, const quantity<si::pressure> &pressure);
+
+  /// Open or close the component between two vertices of this state, e.g. a valve. The model, its pattern and
+  /// factorization analysis are kept, the row of a closed component becomes its mass flow. Closing a component whose
+  /// first vertex branches throws std::logic_error, see System::Set_Active.
+  void Set_Active(const size_t &vertex_u, const size_t &vertex_v, bool active);
+  bool Is_Active(const size_t &vertex_u, const size_t &vertex_v) const;
+
+  /// Damped sparse Newton iteration from the current iterate (the initial vector of the model at first)
+  /// \return counters of this solve, the symbolic analysis of the state is counted by its first solve
+  SolverStatistics Solve();
+
+  /// Current iterate, ordered as System::Get_Unknown_vector()
+  Eigen::VectorXd Get_Unknown_vector() const;
+  void Set_Unknown_vector(const Eigen::VectorXd &x);
+
+  quantity<si::velocity> Get_Speed(const size_t &vertex) const;
+  quantity<si::pressure> Get_Static_pressure(const size_t &vertex) const;
+
+  /// Write the iterate and the open components into a system with the topology version of the model
+  void Store(System &system) const;
+
+  double Get_Tolerance() const;
+  void Set_Tolerance(double tolerance);
+
+  size_t Get_Max_iterations() const;
+  void Set_Max_iterations(size_t max_iterations);
+
+  /// Threads of the residual and Jacobian evaluations, the results do not depend on the number of threads
+  const std::shared_ptr<ThreadPool> &Get_Thread_pool() const;
+  void Set_Thread_pool(const std::shared_ptr<ThreadPool> &pool);
+
+private:
+  struct Workspace;
+  std::shared_ptr<const Model> m_model;
+  double m_tolerance{1.e-6}; //! Norm of the residual vector at convergence
+  size_t m_max_iterations{100};
+  std::shared_ptr<ThreadPool> m_pool; //! Serial when null
+  std::shared_ptr<Workspace> m_workspace;
+};
+
+}
+
+#endif //LIBFLUIDS_MODEL_H
@@ -0,0 +1,92 @@
+// MIT License
+//
+// Copyright (c) 2019 Jelle Spijker
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+
+#ifndef LIBFLUIDS_MODELDESCRIPTION_H
+#define LIBFLUIDS_MODELDESCRIPTION_H
+
+#include <utility>
+#include <vector>
+
+#include <Eigen/Core>
+
+namespace Fluids {
+
+/// Index based description of the equations of an initialized system: the numerical parameters of the vertices
+/// and edges and the composition of the residual rows. The rows are ordered as System::Get_Return_vec, first one
+/// Bernoulli row per non transport edge and then the mass rows, and the unknowns as System::Get_Unknown_vector.
+/// The description holds plain values only, it can be copied into other storage, e.g. by FixedSizeSolver.
+struct ModelDescription {
+  enum class Kind {
+    Pipe,
+    Component, //! Constant pressure difference
+    Transport
+  };
+
+  struct Edge {
+    Eigen::Index u{0};
+    Eigen::Index v{0};
+    Kind kind{Kind::Component};
+    double area{0.};
+    double diameter{0.};
+    double length{0.};
+    double relative_roughness{0.};
+    double delta_pressure{0.};
+    Eigen::Index flow{-1}; //! Column of the transported flow, -1 when known
+    double known_flow{0.};
+    bool active{true};     //! A closed edge has the row area * density * speed(u) instead of its Bernoulli row
+  };
+
+  struct Vertex {
+    double density{0.};
+    double dynamic_viscosity{0.};
+    double potential_pressure{0.};
+    Eigen::Index speed{-1};    //! Column of the speed, -1 when known
+    Eigen::Index pressure{-1}; //! Column of the static pressure, -1 when known
+  };
+
+  /// Mass balance row, the sum of the signed mass flows of the edges. An outlet continuity row also subtracts the
+  /// mass flow through the outlet vertex.
+  struct MassRow {
+    std::vector<std::pair<Eigen::Index, double>> edges;
+    Eigen::Index outlet{-1}; //! Outlet vertex of a continuity row, -1 for a balance
+    double area{0.};         //! Sum of the cross sections entering the outlet vertex
+  };
+
+  std::vector<Vertex> vertices;            //! In the storage order of the system, see System::Reorder
+  std::vector<size_t> vertex_index;        //! Index in vertices of every vertex id, empty when they are the same
+  std::vector<Edge> edges;
+  std::vector<Eigen::Index> bernoulli_rows; //! Non transport edges
+  std::vector<MassRow> mass_rows;
+  Eigen::RowVectorXd speeds;                //! Speeds of the vertices when the description was taken
+  Eigen::RowVectorXd static_pressures;      //! Static pressures of the vertices when the description was taken
+  Eigen::Index n_unknowns{0};
+
+  /// Index in vertices of a vertex id of the system, an id out of range is returned as is
+  size_t Index(size_t vertex) const {
+    return vertex < vertex_index.size() ? vertex_index[vertex] : vertex;
+  }
+};
+
+}
+
+#endif //LIBFLUIDS_MODELDESCRIPTION_H
@@ -24,6 +24,10 @@
 #ifndef FLUIDS_PIPES_H
 #define FLUIDS_PIPES_H
 
+#include <cmath>
+
+#include <Eigen/Core>
+
 #include "FluidComponents.h"
 
 namespace Fluids {
@@ -54,6 +58,8 @@ class Pipes : public FluidComponents {
 
   const std::shared_ptr<quantity<si::dimensionless>> &Get_Relative_roughness() const;
 
+  size_t Get_Heap_bytes() const override;
+
   static quantity<si::dimensionless> Reynolds(const quantity<si::velocity> &speed,
                                               const quantity<si::length> &diameter,
                                               const quantity<si::mass_density> &density,
@@ -62,6 +68,27 @@ class Pipes : public FluidComponents {
   static quantity<si::dimensionless> Haaland(const quantity<si::dimensionless> &reynolds,
                                              const quantity<si::dimensionless> &relative_roughness);
 
+  /// Factor 8 / pi^2 of the Darcy-Weisbach loss of a pipe in terms of its flow and diameter
+  static constexpr double Loss_factor = 0.81056946914;
+
+  /// Coefficient c of the Darcy-Weisbach loss dp = c f Q^2 of a pipe, c = 8 / pi^2 L rho / D^5 [SI units]
+  static double Loss_coefficient(double length, double diameter, double density) {
+    return Loss_factor * length * density / std::pow(diameter, 5);
+  }
+
+  /// Reynolds number of a set of scenarios, one speed per lane [SI units]
+  template<typename Derived>
+  static auto Reynolds(const Eigen::ArrayBase<Derived> &speed, double diameter, double density,
+                       double dynamic_viscosity) {
+    return speed * (diameter * density / dynamic_viscosity);
+  }
+
+  /// Haaland friction factor of a set of scenarios, one Reynolds number per lane
+  template<typename Derived>
+  static auto Haaland(const Eigen::ArrayBase<Derived> &reynolds, double relative_roughness) {
+    return (-1.8 * (std::pow(relative_roughness / 3.7, 1.11) + 6.9 * reynolds.inverse()).log10()).inverse().square();
+  }
+
  private:
   std::shared_ptr<quantity<si::length>> m_diameter;
   std::shared_ptr<quantity<si::length>> m_length;
@@ -0,0 +1,69 @@
+// MIT License
+//
+// Copyright (c) 2019 Jelle Spijker
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+
+#ifndef LIBFLUIDS_SENSITIVITY_H
+#define LIBFLUIDS_SENSITIVITY_H
+
+#include <memory>
+#include <utility>
+#include <vector>
+
+#include <Eigen/Core>
+
+#include "System.h"
+#include "SolverStrategy.h"
+
+namespace Fluids {
+
+/// Derivatives of the static pressure at the sensor vertices with respect to the parameters of every pipe
+struct PipeSensitivities {
+  std::vector<size_t> sensors;                    //! Sensor vertices, the rows of the matrices
+  std::vector<std::pair<size_t, size_t>> pipes;   //! Vertices (u, v) of each pipe, the columns of the matrices
+  Eigen::MatrixXd diameter;                       //! dp/dD [Pa/m]
+  Eigen::MatrixXd length;                         //! dp/dL [Pa/m]
+  Eigen::MatrixXd roughness;                      //! dp/dk [Pa/m]
+};
+
+/// Adjoint sensitivity analysis of a converged system. The Jacobian of the solution is factored once, every sensor
+/// costs one transposed solve and the parameter derivatives of the residual are coloured finite differences, so all
+/// pipes are covered in a handful of linear solves instead of one non-linear solve per pipe.
+class Sensitivity {
+public:
+  explicit Sensitivity(const std::shared_ptr<System> &system);
+
+  /// Sensitivities at the current state of the system, which should be a solution
+  /// \param sensors vertices at which the static pressure is observed
+  /// \return derivatives with respect to the diameter, length and roughness of every pipe
+  PipeSensitivities Compute(const std::vector<size_t> &sensors);
+
+  /// Counters of the last computation
+  const SolverStatistics &Get_Statistics() const;
+
+private:
+  std::shared_ptr<System> m_system;
+  SolverStatistics m_statistics;
+};
+
+}
+
+#endif //LIBFLUIDS_SENSITIVITY_H
@@ -0,0 +1,178 @@
+// MIT License
+//
+// Copyright (c) 2019 Jelle Spijker
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+
+#ifndef LIBFLUIDS_SERVICE_H
+#define LIBFLUIDS_SERVICE_H
+
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include <Eigen/Core>
+
+#include "Model.h"
+#include "System.h"
+#include "ThreadPool.h"
+
+namespace Fluids {
+
+/// Batch of scenarios of a loaded model that only differ in their known values
+struct SolveRequest {
+  enum class Kind : uint8_t {
+    Speed = 0,
+    Static_pressure = 1
+  };
+  struct Boundary {
+    Kind kind;
+    size_t vertex;
+  };
+
+  std::string model;
+  std::vector<Boundary> boundaries; //! Known values set by the scenarios, the others keep the values of the model
+  Eigen::MatrixXd values;           //! One row per scenario, one column per boundary [SI units]
+};
+
+/// Solution of every scenario of a solve request
+struct SolveResult {
+  std::vector<uint8_t> converged;
+  std::vector<uint64_t> iterations;
+  Eigen::MatrixXd static_pressures; //! One row per scenario, one column per vertex id [Pa]
+  Eigen::MatrixXd speeds;           //! One row per scenario, one column per vertex id [m/s]
+};
+
+/// Throughput and latency counters of a service
+struct ServiceStatistics {
+  static const size_t Buckets = 24;
+
+  uint64_t requests{0};         //! Handled requests, including the failed ones
+  uint64_t failures{0};         //! Requests answered with an error
+  uint64_t scenarios{0};        //! Solved scenarios
+  uint64_t converged{0};        //! Converged scenarios
+  double busy_seconds{0.};      //! Sum of the handling times of the requests
+  double max_latency{0.};       //! Longest handling time of a request [s]
+  double uptime{0.};            //! Seconds since the service was created
+  std::array<uint64_t, Buckets> latency_histogram{}; //! Bucket k counts the requests handled in [2^k, 2^(k+1)) us
+
+  /// Scenarios per second of uptime
+  double Throughput() const;
+  /// Mean handling time of a request [s]
+  double Mean_latency() const;
+};
+
+/// Solver service that keeps the models of named networks warm (the flat description, the Jacobian pattern and
+/// colouring and the initial vector, see Model) and solves batches of scenarios on them. The scenarios of a request
+/// are cut in chunks that are solved in lockstep as an Ensemble, the chunks run concurrently on the thread pool.
+/// Requests of several callers may be handled concurrently, they share the models and take turns on the pool.
+///
+/// Handle takes and returns the messages of the fluidsd protocol, the Encode and Decode functions build and read
+/// them on the side of a client. A message starts with its type (a byte), integers are 64 bit and values are
+/// doubles in the byte order of the machine, strings and vectors are preceded by their size:
+///   Load:       name, path of a checkpoint (see Checkpoint) in the checkpoint directory -> number of vertices
+///   Unload:     name                                           -> nothing
+///   Solve:      name, boundaries (kind byte and vertex id), number of scenarios, values by scenario
+///               -> number of vertices, number of scenarios, converged byte and iterations per scenario, static
+///                  pressures and speeds by scenario and vertex id
+///   Statistics:                                                -> the counters of ServiceStatistics
+/// A response starts with a status byte, 0 for success, otherwise it holds an error message. A message may ask for at
+/// most Get_Max_scenarios scenarios, and no more than fit in a response of Max_response bytes, and only load
+/// checkpoints inside the checkpoint directory (none without one), since the messages come from other processes.
+class Service {
+public:
+  enum class Request : uint8_t {
+    Load = 1,
+    Unload = 2,
+    Solve = 3,
+    Statistics = 4
+  };
+
+  /// Largest response of Handle, the size of a fluidsd message is a 32 bit unsigned integer
+  static const uint64_t Max_response = UINT32_MAX;
+
+  /// \param pool threads of the scenarios, serial when null
+  explicit Service(const std::shared_ptr<ThreadPool> &pool = nullptr);
+
+  /// Keep the model of an initialized system under a name, replacing the model of that name
+  void Load(const std::string &name, const std::shared_ptr<System> &system);
+  /// Restore a system from a checkpoint file and keep its model, std::runtime_error when the file cannot be read
+  /// \return number of vertices of the model
+  size_t Load(const std::string &name, const std::string &path);
+  /// \return false when no model has the name
+  bool Unload(const std::string &name);
+  std::shared_ptr<const Model> Get_Model(const std::string &name) const;
+
+  /// Solve the scenarios of a request, std::logic_error for an unknown model or boundary, for more scenarios than
+  /// the maximum or for a result that does not fit in a response of Max_response bytes
+  SolveResult Solve(const SolveRequest &request);
+
+  /// Answer a message of the protocol, errors are reported in the response and counted as failures
+  std::string Handle(const std::string &message);
+
+  ServiceStatistics Get_Statistics() const;
+
+  double Get_Tolerance() const;
+  void Set_Tolerance(double tolerance);
+
+  /// Largest number of scenarios of a request, which bounds the memory of its result
+  size_t Get_Max_scenarios() const;
+  void Set_Max_scenarios(size_t max_scenarios);
+
+  /// Directory of the checkpoints that Load messages may read, relative paths are resolved against it and paths
+  /// that lead outside of it are refused. Load messages are refused when it is empty (the default).
+  const std::string &Get_Checkpoint_directory() const;
+  void Set_Checkpoint_directory(const std::string &directory);
+
+  static std::string Encode_load(const std::string &name, const std::string &path);
+  static std::string Encode_unload(const std::string &name);
+  static std::string Encode_solve(const SolveRequest &request);
+  static std::string Encode_statistics();
+  /// Read a response of the protocol, std::runtime_error with the message of an error response
+  /// \return number of vertices of the loaded model
+  static size_t Decode_load(const std::string &response);
+  static void Decode_unload(const std::string &response);
+  static SolveResult Decode_solve(const std::string &response);
+  static ServiceStatistics Decode_statistics(const std::string &response);
+
+private:
+  std::shared_ptr<ThreadPool> m_pool;
+  double m_tolerance{1.e-6};
+  size_t m_max_scenarios{1u << 16};
+  std::string m_checkpoint_directory; //! No Load messages when empty
+  mutable std::mutex m_mutex; //! Guards the models and the counters
+  std::map<std::string, std::shared_ptr<const Model>> m_models;
+  ServiceStatistics m_statistics;
+  std::chrono::steady_clock::time_point m_start;
+
+  void Count(double seconds, bool failed, const SolveResult *result);
+
+  /// Path of a checkpoint of a Load message, std::runtime_error when it is outside of the checkpoint directory
+  std::string Checkpoint_path(const std::string &path) const;
+};
+
+}
+
+#endif //LIBFLUIDS_SERVICE_H
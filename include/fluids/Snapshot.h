@@ -0,0 +1,130 @@
+// MIT License
+//
+// Copyright (c) 2019 Jelle Spijker
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+
+#ifndef LIBFLUIDS_SNAPSHOT_H
+#define LIBFLUIDS_SNAPSHOT_H
+
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include <Eigen/Core>
+
+#include "System.h"
+#include "SolverStrategy.h"
+
+namespace Fluids {
+
+/// Immutable copy of the speeds and static pressures of every vertex and of the unknown vector of a system, taken
+/// after a solve. A snapshot is never modified once published, any number of threads can read it without locking.
+class Snapshot {
+public:
+  /// Copy of the current values of an initialized system
+  /// \param system solved system
+  /// \param statistics counters of the solve that produced the values
+  /// \param version publication number, increasing with every publication of a channel
+  Snapshot(const System &system, const SolverStatistics &statistics, size_t version);
+
+  size_t Get_Version() const;
+  /// Topology version of the system when the snapshot was taken
+  size_t Get_Topology_version() const;
+  const SolverStatistics &Get_Statistics() const;
+
+  size_t n_vertices() const;
+  quantity<si::velocity> Get_Speed(const size_t &vertex) const;
+  quantity<si::pressure> Get_Static_pressure(const size_t &vertex) const;
+
+  /// Unknown vector, ordered as System::Get_Unknown_vector()
+  const Eigen::VectorXd &Get_Unknown_vector() const;
+
+private:
+  size_t m_version;
+  size_t m_topology_version;
+  SolverStatistics m_statistics;
+  Eigen::VectorXd m_speeds;
+  Eigen::VectorXd m_static_pressures;
+  Eigen::VectorXd m_unknowns;
+};
+
+/// Publication of the snapshots of a system that is solved on one thread and read on others, e.g. by an HMI while a
+/// background loop keeps solving. The solver writes into the quantities of the system, so a reader of the system
+/// sees partly updated or finite difference states; a reader of the channel sees the last complete solution. A
+/// publication builds a new snapshot and swaps a raw pointer to its slot atomically (read-copy-update). A reader
+/// announces itself in the reader count of the current epoch and loads the pointer, so reading is wait-free and never
+/// blocked by a solve or a publication. A publisher never waits for the readers either: the replaced slot is retired
+/// and the epoch flips, so that new readers do not hold up the old count. A retired slot is released by a later
+/// publication, or by the destructor, once each reader count has been zero after its retirement; a replaced
+/// snapshot is released by its last holder.
+class SnapshotChannel {
+public:
+  SnapshotChannel() = default;
+  ~SnapshotChannel();
+  SnapshotChannel(const SnapshotChannel &) = delete;
+  SnapshotChannel &operator=(const SnapshotChannel &) = delete;
+
+  /// Copy the system into a new snapshot and make it the current one. Concurrent publishers take turns, the
+  /// snapshot with the highest version is kept.
+  /// \return the published snapshot
+  std::shared_ptr<const Snapshot> Publish(const System &system, const SolverStatistics &statistics);
+
+  /// Current snapshot, null before the first publication. The snapshot stays valid while it is held.
+  std::shared_ptr<const Snapshot> Get() const;
+
+  /// Call a reader with the current snapshot, null before the first publication, without copying its shared
+  /// pointer. The snapshot is only valid during the call; publications do not wait for it.
+  void Read(const std::function<void(const Snapshot *)> &reader) const;
+
+  /// Number of publications
+  size_t Get_Version() const;
+
+  /// Replaced slots that a reader may still use, released by a later publication
+  size_t n_retired() const;
+
+private:
+  struct Slot {
+    std::shared_ptr<const Snapshot> snapshot;
+  };
+  struct Retired {
+    const Slot *slot;
+    bool drained[2]; //! Reader count of the epoch seen at zero since the retirement
+  };
+  struct alignas(64) Readers {
+    std::atomic<size_t> count{0};
+  };
+
+  std::atomic<const Slot *> m_current{nullptr};
+  std::atomic<unsigned> m_epoch{0};
+  mutable Readers m_readers[2]; //! Readers between their announcement and their copy, by epoch
+  mutable std::mutex m_publish; //! Serializes the publishers
+  std::vector<Retired> m_retired;
+  std::atomic<size_t> m_version{0};
+
+  /// Release the retired slots that no reader can still use
+  void Reclaim();
+};
+
+}
+
+#endif //LIBFLUIDS_SNAPSHOT_H
@@ -0,0 +1,93 @@
+// MIT License
+//
+// Copyright (c) 2019 Jelle Spijker
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+
+#ifndef LIBFLUIDS_SOLUTIONCACHE_H
+#define LIBFLUIDS_SOLUTIONCACHE_H
+
+#include <memory>
+#include <mutex>
+
+#include <Eigen/Core>
+
+#include "System.h"
+
+namespace Fluids {
+struct MemoryReport;
+class BinaryWriter;
+class BinaryReader;
+
+/// Least recently used cache of solved unknown vectors, keyed by the topology version of a system, a hash of its
+/// structure (edges and known/unknown partition) and its known speeds, static pressures and volumetric flows rounded
+/// to a resolution. Systems with equal keys share the cached solution, otherwise the cached solution of the same
+/// topology with the nearest known values is a warm start. A match always has the number of unknowns of the system.
+/// The cache is opt-in (see Solver::Set_Cache) and can be shared by several solvers and threads.
+class SolutionCache {
+public:
+  enum class Match {
+    None,    //! No cached solution of the topology
+    Nearest, //! Solution of other known values
+    Exact    //! Solution of the same rounded known values
+  };
+
+  explicit SolutionCache(size_t capacity = 64);
+
+  /// Cached solution of the known values of the system
+  /// \param system initialized system
+  /// \param x on return the unknown vector of the match, unchanged without a match
+  /// \return kind of the match
+  Match Find(const System &system, Eigen::VectorXd &x);
+
+  /// Store the solution of the known values of the system, evicting the least recently used entry when full
+  void Insert(const System &system, const Eigen::VectorXd &x);
+
+  void Clear();
+
+  size_t Size() const;
+
+  size_t Get_Capacity() const;
+  void Set_Capacity(size_t capacity);
+
+  /// Rounding of the known values in the keys
+  void Set_Resolution(const quantity<si::velocity> &speed, const quantity<si::pressure> &pressure,
+                      const quantity<si::volumetric_flow> &flow);
+
+  size_t Get_Hits() const;
+  size_t Get_Nearest() const;
+  size_t Get_Misses() const;
+
+private:
+  friend struct MemoryReport;
+  friend class Checkpoint;
+  struct Data;
+  mutable std::mutex m_mutex;
+  std::shared_ptr<Data> m_data;
+
+  /// Resolution and entries, most recently used first, as saved by a checkpoint
+  void Write(BinaryWriter &writer) const;
+  /// Replace the resolution and the entries by the read ones, the cache is unchanged when the reading fails
+  void Read(BinaryReader &reader);
+};
+
+}
+
+#endif //LIBFLUIDS_SOLUTIONCACHE_H
@@ -24,27 +24,81 @@
 #ifndef LIBFLUIDS_SOLVER_H
 #define LIBFLUIDS_SOLVER_H
 
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <future>
 #include <memory>
 
+#include "Snapshot.h"
+#include "SolutionCache.h"
 #include "System.h"
+#include "SolverStrategy.h"
 
 namespace Fluids {
 
+/// Cooperative cancellation of a solve, shared between the caller and the solving thread
+class CancellationToken {
+public:
+  void Cancel();
+  bool Is_Cancelled() const;
+
+private:
+  std::atomic<bool> m_cancelled{false};
+};
+
+/// Progress reporting and interruption of a solve. The checks are done between the iterations of the strategy, an
+/// interrupted solve leaves the system in the best iterate found so far.
+struct SolveOptions {
+  typedef std::function<void(size_t iteration, double residual_norm)> Progress;
+
+  Progress progress;                                //! Called between iterations and once after the solve
+  std::shared_ptr<CancellationToken> cancellation;  //! Stop when cancelled
+  std::chrono::steady_clock::time_point deadline{std::chrono::steady_clock::time_point::max()}; //! Stop when passed
+};
+
 class Solver {
 public:
   Solver();
   Solver(const std::shared_ptr<System> &system);
+  Solver(const std::shared_ptr<System> &system, const std::shared_ptr<SolverStrategy> &strategy);
 
   virtual ~Solver() = default;
 
   void Solve();
   void Solve(const std::shared_ptr<System> &system);
+  void Solve(const SolveOptions &options);
+
+  /// Solve on another thread. The system and the strategy must not be used by the caller, and the solver must be
+  /// kept alive, until the future is ready.
+  /// \param options progress, cancellation and deadline of the solve
+  /// \return counters of the solve
+  std::future<SolverStatistics> SolveAsync(const SolveOptions &options = SolveOptions());
 
   const std::shared_ptr<System> &Get_System() const;
   void Set_System(const std::shared_ptr<System> &system);
 
+  const std::shared_ptr<SolverStrategy> &Get_Strategy() const;
+  void Set_Strategy(const std::shared_ptr<SolverStrategy> &strategy);
+
+  /// Counters of the last solve
+  const SolverStatistics &Get_Statistics() const;
+
+  /// Cache of the solutions, consulted before and filled after every solve. An exact match whose residual is
+  /// within the tolerance of the strategy is returned without iterating, otherwise the match is the initial vector.
+  const std::shared_ptr<SolutionCache> &Get_Cache() const;
+  void Set_Cache(const std::shared_ptr<SolutionCache> &cache);
+
+  /// Channel to which a snapshot of the system is published after every solve, for readers on other threads
+  const std::shared_ptr<SnapshotChannel> &Get_Channel() const;
+  void Set_Channel(const std::shared_ptr<SnapshotChannel> &channel);
+
 private:
   std::shared_ptr<System> m_system;
+  std::shared_ptr<SolverStrategy> m_strategy;
+  std::shared_ptr<SolutionCache> m_cache; //! No caching when null
+  std::shared_ptr<SnapshotChannel> m_channel; //! No publication when null
+  SolverStatistics m_statistics;
 
 };
 
@@ -0,0 +1,194 @@
+// MIT License
+//
+// Copyright (c) 2019 Jelle Spijker
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+
+#ifndef LIBFLUIDS_SOLVERSTRATEGY_H
+#define LIBFLUIDS_SOLVERSTRATEGY_H
+
+#include <functional>
+#include <memory>
+
+#include <Eigen/Core>
+
+#include "System.h"
+
+namespace Fluids {
+
+/// Counters of a single solve
+struct SolverStatistics {
+  size_t iterations{0};
+  size_t residual_evaluations{0};
+  size_t jacobian_evaluations{0};
+  size_t factorizations{0};
+  /// Factorizations avoided compared to a Newton iteration that refactors every step
+  size_t factorizations_saved{0};
+  /// Fill-reducing orderings and symbolic factorizations computed
+  size_t symbolic_analyses{0};
+  /// Krylov iterations (operator applications) of matrix-free strategies
+  size_t linear_iterations{0};
+  double residual_norm{0.};
+  bool converged{false};
+  /// Stopped by the monitor (cancellation, deadline...) before convergence
+  bool interrupted{false};
+};
+
+/// Non-linear iteration used by the Solver
+class SolverStrategy {
+public:
+  /// Called between iterations with the number of iterations done, the current iterate and its residual norm. The
+  /// strategies only accept steps that decrease the residual norm, so the current iterate is the best so far.
+  /// \return false to stop, the strategy then returns the current iterate
+  typedef std::function<bool(size_t iteration, const Eigen::VectorXd &x, double residual_norm)> Monitor;
+
+  virtual ~SolverStrategy() = default;
+
+  /// Solve the system
+  /// \param system initialized system
+  /// \param x initial vector, on return the last iterate
+  /// \return counters of this solve
+  virtual SolverStatistics Solve(const std::shared_ptr<System> &system, Eigen::VectorXd &x) = 0;
+
+  double Get_Tolerance() const;
+  void Set_Tolerance(double tolerance);
+
+  size_t Get_Max_iterations() const;
+  void Set_Max_iterations(size_t max_iterations);
+
+  const Monitor &Get_Monitor() const;
+  void Set_Monitor(const Monitor &monitor);
+
+protected:
+  double m_tolerance{1.e-6}; //! Norm of the residual vector at convergence
+  size_t m_max_iterations{100};
+  Monitor m_monitor;
+
+  /// Report the current iterate to the monitor
+  /// \return true when the iteration may continue
+  bool Report(SolverStatistics &statistics, const Eigen::VectorXd &x, double residual_norm) const;
+};
+
+/// Powell's hybrid method as implemented by Eigen, the default strategy
+class HybridStrategy : public SolverStrategy {
+public:
+  SolverStatistics Solve(const std::shared_ptr<System> &system, Eigen::VectorXd &x) override;
+};
+
+/// Newton iteration with a finite difference Jacobian which is refactored every iteration
+class NewtonStrategy : public SolverStrategy {
+public:
+  SolverStatistics Solve(const std::shared_ptr<System> &system, Eigen::VectorXd &x) override;
+};
+
+/// Newton iteration with a coloured finite difference Jacobian and a sparse LU factorization (COLAMD ordering). The
+/// strategy acts as a solver session: the sparsity pattern, the column colouring, the fill-reducing ordering and the
+/// symbolic factorization are computed once and reused by every following solve, each iteration only refactors
+/// numerically. The analysis is redone automatically when the topology version of the system changes. Requires as
+/// many residuals as unknowns.
+class SparseNewtonStrategy : public SolverStrategy {
+public:
+  SparseNewtonStrategy();
+
+  SolverStatistics Solve(const std::shared_ptr<System> &system, Eigen::VectorXd &x) override;
+
+  /// Number of symbolic analyses over all solves of this session
+  size_t Get_Symbolic_analyses() const;
+
+private:
+  struct Session;
+  std::shared_ptr<Session> m_session;
+};
+
+/// Jacobian-free Newton-Krylov iteration for very large networks. Jacobian-vector products are finite differences of
+/// the residual along the Krylov direction and the linear systems are solved inexactly by restarted GMRES. The only
+/// matrix kept is the preconditioner, an incomplete LU or block-Jacobi preconditioner built from the coloured sparse
+/// Jacobian (the linearized pipe resistances), so memory stays linear in the size of the network. When the
+/// factorization of the preconditioner fails GMRES runs unpreconditioned until the next update. Requires as many
+/// residuals as unknowns.
+class NewtonKrylovStrategy : public SolverStrategy {
+public:
+  enum class Preconditioner {
+    None,
+    BlockJacobi, //! Dense blocks of rows that share unknowns, each row matched to its strongest unknown
+    IncompleteLU
+  };
+
+  NewtonKrylovStrategy();
+  explicit NewtonKrylovStrategy(Preconditioner preconditioner);
+
+  SolverStatistics Solve(const std::shared_ptr<System> &system, Eigen::VectorXd &x) override;
+
+  Preconditioner Get_Preconditioner() const;
+  void Set_Preconditioner(Preconditioner preconditioner);
+
+  /// Relative tolerance of the linear solves
+  double Get_Forcing() const;
+  void Set_Forcing(double forcing);
+
+  size_t Get_Restart() const;
+  void Set_Restart(size_t restart);
+
+  /// Newton iterations between preconditioner updates
+  size_t Get_Preconditioner_lag() const;
+  void Set_Preconditioner_lag(size_t lag);
+
+private:
+  struct Workspace;
+  Preconditioner m_preconditioner{Preconditioner::IncompleteLU};
+  double m_forcing{1.e-6};
+  size_t m_restart{30};
+  size_t m_preconditioner_lag{5};
+  std::shared_ptr<Workspace> m_workspace;
+};
+
+/// Quasi-Newton iteration which keeps a factored Jacobian across iterations. The factorization is only refreshed
+/// when the residual reduction of an iteration becomes worse than the slowdown ratio, when a step is rejected or when
+/// the number of stored updates reaches its maximum.
+class BroydenStrategy : public SolverStrategy {
+public:
+  enum class Update {
+    Broyden, //! Rank-one (good) Broyden updates of the inverse, stored as steps
+    Chord    //! Reuse the factored Jacobian without updates
+  };
+
+  BroydenStrategy();
+  explicit BroydenStrategy(Update update);
+
+  SolverStatistics Solve(const std::shared_ptr<System> &system, Eigen::VectorXd &x) override;
+
+  Update Get_Update() const;
+  void Set_Update(Update update);
+
+  double Get_Slowdown() const;
+  void Set_Slowdown(double slowdown);
+
+  size_t Get_Max_updates() const;
+  void Set_Max_updates(size_t max_updates);
+
+private:
+  Update m_update{Update::Broyden};
+  double m_slowdown{0.5}; //! Refactor when |F(x+s)| > slowdown * |F(x)|
+  size_t m_max_updates{20};
+};
+
+}
+
+#endif //LIBFLUIDS_SOLVERSTRATEGY_H
@@ -0,0 +1,109 @@
+// MIT License
+//
+// Copyright (c) 2019 Jelle Spijker
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+
+#ifndef LIBFLUIDS_SURROGATE_H
+#define LIBFLUIDS_SURROGATE_H
+
+#include <memory>
+#include <vector>
+
+#include <Eigen/Core>
+
+#include "Model.h"
+#include "SolverStrategy.h"
+
+namespace Fluids {
+
+/// Response surface of the unknowns of a model over a box of known speeds and static pressures. The box is sampled
+/// on a sparse grid with steady state solves and the unknown vector is interpolated with the hierarchical piecewise
+/// linear basis (modified at the faces of the box, so the faces need no samples). A query inside the box costs a
+/// fixed number of basis evaluations, independent of the iterations of a solve. A query outside the box, the trusted
+/// region, is solved instead.
+class Surrogate {
+public:
+  explicit Surrogate(const std::shared_ptr<const Model> &model);
+
+  /// Dimension of the box, the known speed of a vertex between two bounds
+  void Add_Speed_dimension(const size_t &vertex, const quantity<si::velocity> &lower,
+                           const quantity<si::velocity> &upper);
+  /// Dimension of the box, the known static pressure of a vertex between two bounds
+  void Add_Static_pressure_dimension(const size_t &vertex, const quantity<si::pressure> &lower,
+                                     const quantity<si::pressure> &upper);
+
+  size_t n_dimensions() const;
+
+  /// Sample the sparse grid of a level and fit the interpolant, then measure the fit error on validation points.
+  /// Throws std::logic_error before any solve for more than 16 dimensions, and std::runtime_error when a sample did
+  /// not converge, keeping the interpolant of the previous build.
+  /// \param level 1 is the centre of the box only, each level about doubles the samples per dimension
+  /// \return counters summed over all solves, converged when every sample converged
+  SolverStatistics Build(size_t level);
+
+  size_t n_samples() const;
+
+  /// Largest absolute error of every unknown at the validation points, ordered as System::Get_Unknown_vector()
+  const Eigen::VectorXd &Get_Fit_error() const;
+
+  /// Quasi-random points of the box where the fit error is measured (default 16)
+  size_t Get_Validation_points() const;
+  void Set_Validation_points(size_t points);
+
+  bool Is_Trusted(const Eigen::VectorXd &point) const;
+
+  /// Unknown vector at a point of the known values, one SI value per dimension in the order they were added
+  /// \param point values of the dimensions
+  /// \param interpolated on return whether the interpolant answered (true) or a solve was needed (false)
+  /// \return unknown vector, ordered as System::Get_Unknown_vector()
+  Eigen::VectorXd Evaluate(const Eigen::VectorXd &point, bool *interpolated = nullptr) const;
+
+  double Get_Tolerance() const;
+  void Set_Tolerance(double tolerance);
+
+  size_t Get_Max_iterations() const;
+  void Set_Max_iterations(size_t max_iterations);
+
+private:
+  struct Dimension {
+    size_t vertex;
+    bool pressure; //! Static pressure, otherwise speed
+    double lower;
+    double upper;
+  };
+
+  void Set_Known(SolveState &state, const Eigen::VectorXd &point) const;
+  Eigen::VectorXd Interpolate(const Eigen::VectorXd &unit) const;
+
+  std::shared_ptr<const Model> m_model;
+  std::vector<Dimension> m_dimensions;
+  std::vector<int> m_levels;   //! Level of every sample and dimension, n_samples x n_dimensions
+  std::vector<int> m_indices;  //! Odd index of every sample and dimension
+  Eigen::MatrixXd m_surpluses; //! Hierarchical surplus of every sample (row) and unknown (column)
+  Eigen::VectorXd m_fit_error;
+  size_t m_validation_points{16};
+  double m_tolerance{1.e-8}; //! Norm of the residual vector at convergence
+  size_t m_max_iterations{100};
+};
+
+}
+
+#endif //LIBFLUIDS_SURROGATE_H
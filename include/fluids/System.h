@@ -30,12 +30,13 @@
 #include <boost/graph/adjacency_list.hpp>
 
 #include <Eigen/Core>
-#include <random>
 
 #include "Liquid.h"
 #include "FluidComponents.h"
 
 namespace Fluids {
+struct MemoryReport;
+class CountingResource;
 
 typedef boost::adjacency_list<boost::listS,
                               boost::listS,
@@ -52,7 +53,12 @@ typedef std::vector<std::shared_ptr<quantity<si::volumetric_flow>>> shared_volum
 class System {
 public:
   System();
+  /// System whose liquids, transport edges and their quantities are allocated in a monotonic arena of its own
   System(Liquid liquid, size_t num_vertices);
+  /// System whose liquids, transport edges and their quantities are allocated in the given arena (e.g. from
+  /// Make_arena on a caller's resource), or on the heap when the arena is null. Their bytes are counted on the way
+  /// to the arena, see MemoryReport.
+  System(Liquid liquid, size_t num_vertices, const Arena &arena);
 
   void add_FluidComponent(const std::shared_ptr<FluidComponents> &component,
                           const size_t &vertex_u,
@@ -61,14 +67,47 @@ public:
   std::shared_ptr<Liquid> &Get_Liquid(const size_t &vertex_u);
   std::shared_ptr<FluidComponents> &Get_Component(const size_t &vertex_u, const size_t &vertex_v);
 
+  /// Connect transport edges to the leaf vertices, this is done only once
   void Initialize();
+  bool Is_Initialized() const;
+
+  /// Store the vertices, the edges and the unknowns of an initialized system in reverse Cuthill-McKee order, so
+  /// that connected vertices are close in memory and in the unknown vector. The vertex ids of the system, of the
+  /// models and of the solvers built from it do not change, only their index in the storage (see
+  /// Get_Vertex_index). The topology version changes. Reordering is opt-in: it narrows the bandwidth of the
+  /// Jacobian, a faster solve is not guaranteed and should be measured (see bench/src/reorder_bench.cpp).
+  void Reorder();
+  /// Store the vertices of an initialized system in the order of their coordinates along a Hilbert curve
+  /// \param coordinates planar coordinates of the vertex ids, one row per vertex. Vertices added by Initialize may
+  /// be omitted, they take the coordinates of the vertex they are connected to.
+  void Reorder(const Eigen::MatrixX2d &coordinates);
+  /// Index of a vertex id in the storage order, i.e. in Get_Graph and in the vertices of a model description; the
+  /// id itself until the system is reordered
+  size_t Get_Vertex_index(const size_t &vertex) const;
+  /// Storage index of every vertex id, empty until the system is reordered
+  const std::vector<size_t> &Get_Vertex_indices() const;
 
   void Set_Known_Speed(const size_t &vertex_u, const quantity<si::velocity> &speed);
   void Set_Known_Static_Pressure(const size_t &vertex_u, const quantity<si::pressure> &pressure);
 
-  size_t n_unknowns();
+  /// Open or close the component between two vertices. A closed component keeps its residual row, which becomes
+  /// its mass flow, so the unknowns, the residual rows and the sparsity of the Jacobian (and the topology version)
+  /// do not change. The mass flow of a component is the speed of its first vertex times its cross section, the same
+  /// speed as every other edge leaving that vertex, so a component whose first vertex branches can not be closed
+  /// (std::logic_error): its siblings would be stopped as well.
+  void Set_Active(const size_t &vertex_u, const size_t &vertex_v, bool active);
+  bool Is_Active(const size_t &vertex_u, const size_t &vertex_v);
+
+  size_t n_unknowns() const;
+  size_t n_residuals() const;
+
+  /// Initial vector obtained from a linearized resistance network, see InitialGuess
+  /// \return deterministic initial vector ordered as the unknowns
   Eigen::VectorXd Get_Initial_vector();
 
+  /// Current values of the unknowns, in the same order as the initial vector
+  Eigen::VectorXd Get_Unknown_vector() const;
+
   const shared_velocity_vector &Get_Known_speeds() const;
   const shared_velocity_vector &Get_Unknown_speeds() const;
   const shared_pressure_vector &Get_Known_static_pressures() const;
@@ -79,8 +118,24 @@ public:
   const Eigen::VectorXd Get_Return_vec() const;
   const Graph &Get_Graph() const;
 
+  /// Counter that changes whenever the graph or the known/unknown partition changes, cached solver structures
+  /// derived from the topology are valid as long as this version is unchanged
+  size_t Get_Topology_version() const;
+
+  /// Arena of the objects created by the system, it lives as long as the system or any of those objects
+  const Arena &Get_Arena() const;
+
 private:
+  friend class Checkpoint;
+  friend struct MemoryReport;
+  Arena m_arena; //! Heap allocation when null
+  std::shared_ptr<CountingResource> m_liquid_bytes; //! Liquids and their quantities, allocated in the arena
+  std::shared_ptr<CountingResource> m_edge_bytes;   //! Transport edges and their quantities, allocated in the arena
   Graph m_graph;
+  std::vector<vertex_t> m_vertices; //! Vertex of every id
+  std::vector<size_t> m_indices;    //! Storage index of every id, empty when the ids are the indices
+  bool m_initialized{false};
+  size_t m_topology_version{0};
   shared_velocity_vector m_known_speeds;
   shared_velocity_vector m_unknown_speeds;
   shared_pressure_vector m_known_static_pressures;
@@ -91,6 +146,10 @@ private:
   const Eigen::VectorXd Get_Bernoulli_vec() const;
   const Eigen::VectorXd Get_massflow_vec() const;
 
+  /// Rebuild the graph with the vertices in the given order and sort the edges and unknowns accordingly
+  /// \param order storage index of the vertex that becomes the k-th
+  void Permute(const std::vector<size_t> &order);
+
   /// Is value present in vector
   /// \tparam T type of values in vector
   /// \param vec vector
@@ -115,39 +174,13 @@ private:
     *p = value;
     if (!in_vector<std::shared_ptr<T>>(known, p)) {
       known.push_back(p);
+      ++m_topology_version;
     }
     if (in_vector<std::shared_ptr<T>>(unknown, p)) {
       unknown.erase(std::remove(unknown.begin(), unknown.end(), p), unknown.end());
+      ++m_topology_version;
     }
   }
-
-  template<typename T>
-  void initial_values(const std::vector<std::shared_ptr<quantity<T>>> &vec,
-                      const T qty,
-                      Eigen::VectorXd &initial_vec,
-                      size_t start,
-                      size_t end,
-                      double low,
-                      double high) const {
-    std::random_device rd;
-    std::mt19937 gen(rd());
-
-    if (!vec.empty()) {
-      quantity<T> avg_known_system_value = 0.0 * qty;
-      for (auto&& value : vec) {
-        avg_known_system_value += *value;
-      }
-      avg_known_system_value /= vec.size();
-      for (size_t k = start; k < end; ++k) {
-        initial_vec(k) = avg_known_system_value.value();
-      }
-    } else {
-      std::uniform_real_distribution<> dis(low, high);
-      for (size_t k = start; k < end; ++k) {
-        initial_vec(k) = dis(gen);
-      }
-    }
-  };
 };
 
 }
@@ -0,0 +1,84 @@
+// MIT License
+//
+// Copyright (c) 2019 Jelle Spijker
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+
+#ifndef LIBFLUIDS_THREADPOOL_H
+#define LIBFLUIDS_THREADPOOL_H
+
+#include <condition_variable>
+#include <cstddef>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace Fluids {
+
+/// Fixed set of worker threads for data parallel loops. A loop is cut in contiguous chunks, the calling thread works
+/// on the chunks as well and returns when all are done. Every index is visited by exactly one chunk, so loops that
+/// write disjoint outputs give the same results for any number of threads.
+class ThreadPool {
+public:
+  typedef std::function<void(size_t begin, size_t end, size_t chunk)> Task;
+
+  /// \param threads threads working on a loop, including the calling thread
+  explicit ThreadPool(size_t threads = std::thread::hardware_concurrency());
+  ~ThreadPool();
+
+  ThreadPool(const ThreadPool &) = delete;
+  ThreadPool &operator=(const ThreadPool &) = delete;
+
+  size_t Get_Threads() const;
+
+  /// Number of chunks a loop is cut in
+  /// \param n number of indices
+  /// \param grain smallest number of indices of a chunk
+  size_t Chunks(size_t n, size_t grain = 1) const;
+
+  /// Run the task on the chunks of [0, n), the first exception of a task is rethrown
+  /// \param n number of indices
+  /// \param task called with the range and the index of a chunk, chunk < Chunks(n, grain)
+  /// \param grain smallest number of indices of a chunk
+  void Parallel_for(size_t n, const Task &task, size_t grain = 1);
+
+private:
+  std::vector<std::thread> m_workers;
+  std::mutex m_mutex;
+  std::condition_variable m_wake;
+  std::condition_variable m_done;
+  const Task *m_task{nullptr};
+  size_t m_n{0};
+  size_t m_chunks{0};
+  size_t m_next{0};    //! Next chunk to run
+  size_t m_running{0}; //! Chunks not finished
+  size_t m_generation{0};
+  bool m_stop{false};
+  std::exception_ptr m_exception;
+
+  void Work();
+  bool Run_chunk(std::unique_lock<std::mutex> &lock);
+};
+
+}
+
+#endif //LIBFLUIDS_THREADPOOL_H
@@ -0,0 +1,100 @@
+// MIT License
+//
+// Copyright (c) 2019 Jelle Spijker
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+
+#ifndef LIBFLUIDS_TRACE_H
+#define LIBFLUIDS_TRACE_H
+
+#include <cstdint>
+#include <ostream>
+#include <vector>
+
+/// Scoped timing of a phase of a solve, recorded in the trace ring buffer when tracing is enabled at run time. The
+/// scopes are only compiled in when the library is configured with LIBFLUIDS_TRACING=ON, otherwise the macro
+/// expands to nothing. The name must be a string literal.
+#ifdef LIBFLUIDS_TRACING
+#define FLUIDS_TRACE_CONCAT_(a, b) a##b
+#define FLUIDS_TRACE_CONCAT(a, b) FLUIDS_TRACE_CONCAT_(a, b)
+#define FLUIDS_TRACE_SCOPE(name) const ::Fluids::TraceScope FLUIDS_TRACE_CONCAT(fluids_trace_scope_, __LINE__)(name)
+#else
+#define FLUIDS_TRACE_SCOPE(name) static_cast<void>(0)
+#endif
+
+namespace Fluids {
+
+/// Process wide ring buffer of timed events, exported in the Chrome trace event format (chrome://tracing or
+/// Perfetto). Recording costs two clock reads and a slot of the buffer, the oldest events are overwritten when the
+/// buffer is full. Recording is thread safe; changing the capacity, clearing and exporting are meant to be done
+/// while no traced code runs.
+class Trace {
+public:
+  struct Event {
+    const char *name;   //! String literal
+    std::int64_t begin; //! Nanoseconds since the first use of the trace
+    std::int64_t duration;
+    std::uint32_t thread;
+  };
+
+  static void Enable(bool enabled);
+  static bool Is_Enabled();
+
+  /// Number of events kept, clears the buffer
+  static void Set_Capacity(size_t capacity);
+  static size_t Get_Capacity();
+
+  static void Clear();
+
+  /// Record a finished event, ignored when tracing is disabled
+  static void Record(const char *name, std::int64_t begin, std::int64_t end);
+
+  /// Events in the buffer, the oldest first
+  static std::vector<Event> Get_Events();
+  /// Events recorded since the last clear, including the overwritten ones
+  static size_t n_recorded();
+
+  /// Complete events ("ph":"X") of the buffer as a Chrome trace event JSON object
+  static void Export_chrome(std::ostream &out);
+
+  /// Nanoseconds since the first use of the trace, on a steady clock
+  static std::int64_t Now();
+};
+
+/// Event covering the lifetime of the scope
+class TraceScope {
+public:
+  explicit TraceScope(const char *name)
+      : m_name(Trace::Is_Enabled() ? name : nullptr), m_begin(m_name ? Trace::Now() : 0) {}
+  ~TraceScope() {
+    if (m_name)
+      Trace::Record(m_name, m_begin, Trace::Now());
+  }
+  TraceScope(const TraceScope &) = delete;
+  TraceScope &operator=(const TraceScope &) = delete;
+
+private:
+  const char *m_name; //! Null when tracing was disabled at the start of the scope
+  std::int64_t m_begin;
+};
+
+}
+
+#endif //LIBFLUIDS_TRACE_H
@@ -0,0 +1,119 @@
+// MIT License
+//
+// Copyright (c) 2019 Jelle Spijker
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+
+#ifndef LIBFLUIDS_TRANSIENT_H
+#define LIBFLUIDS_TRANSIENT_H
+
+#include <functional>
+#include <memory>
+#include <utility>
+#include <vector>
+
+#include <Eigen/Core>
+
+#include "System.h"
+#include "ThreadPool.h"
+
+namespace Fluids {
+
+/// Water hammer in the pipes of a system by the method of characteristics. Every pipe is divided in reaches that a
+/// pressure wave travels in one time step (the wave speed of a pipe is adjusted slightly to fit a whole number of
+/// reaches, by at most Max_speed_adjustment since the surge pressure rho a dV is proportional to it), the grid points
+/// of all pipes are stored contiguously and the interior points are updated with packed arithmetic, pipe by pipe on the
+/// threads of a pool. The unknowns are the piezometric pressure p + rho g z and the volumetric flow. A vertex with a
+/// known static pressure is a reservoir, every other vertex is a junction with a common pressure and an external flow,
+/// which may follow a schedule (valve closure, demand change). The friction of a pipe is calibrated to the pressure
+/// drop of the initial state, which must be a steady state of the system (e.g. after Solver::Solve), so that the steady
+/// state is stationary. Only pipes are supported.
+class Transient {
+public:
+  /// Multiplier of the initial external flow of a vertex at a time
+  typedef std::function<double(const quantity<si::time> &)> Schedule;
+
+  /// Largest relative change of the wave speed of a pipe to fit its reaches
+  static constexpr double Max_speed_adjustment = 0.05;
+
+  /// Throws std::logic_error when the wave speed of a pipe would change by more than Max_speed_adjustment, e.g. for
+  /// a pipe shorter than a few wave speeds times the time step; a smaller time step fits it.
+  Transient(const std::shared_ptr<System> &system, const quantity<si::velocity> &wave_speed,
+            const quantity<si::time> &time_step);
+
+  /// The external flow of the vertex becomes its initial value times the schedule, also for a reservoir
+  void Set_Flow_schedule(const size_t &vertex, const Schedule &schedule);
+
+  /// Advance one time step
+  void Step();
+
+  /// Advance until the time has passed the duration
+  /// \param duration time to simulate from the current time
+  /// \param callback called after every step
+  void Run(const quantity<si::time> &duration, const std::function<void(const Transient &)> &callback = nullptr);
+
+  quantity<si::time> Get_Time() const;
+  quantity<si::time> Get_Time_step() const;
+
+  quantity<si::pressure> Get_Static_pressure(const size_t &vertex) const;
+  /// Flow at the start (vertex u) of a pipe
+  quantity<si::volumetric_flow> Get_Volumetricflow(const size_t &vertex_u, const size_t &vertex_v) const;
+  /// Number of reaches of a pipe
+  size_t Get_Reaches(const size_t &vertex_u, const size_t &vertex_v) const;
+
+  const std::shared_ptr<ThreadPool> &Get_Thread_pool() const;
+  void Set_Thread_pool(const std::shared_ptr<ThreadPool> &pool);
+
+private:
+  struct Pipe {
+    size_t u{0};
+    size_t v{0};
+    Eigen::Index offset{0};  //! First grid point in the buffers
+    Eigen::Index reaches{1};
+    double impedance{0.};    //! rho a / A
+    double resistance{0.};   //! Friction pressure drop of a reach is resistance Q |Q|
+  };
+
+  struct Node {
+    bool reservoir{false};
+    double pressure{0.};        //! Piezometric pressure
+    double potential{0.};       //! rho g z
+    double external_flow{0.};   //! Initial flow leaving the network
+    Schedule schedule;
+    std::vector<size_t> in;     //! Pipes ending at the node
+    std::vector<size_t> out;    //! Pipes starting at the node
+  };
+
+  std::vector<Pipe> m_pipes;
+  std::vector<Node> m_nodes;
+  Eigen::ArrayXd m_pressure;    //! Piezometric pressure of all grid points, pipe after pipe
+  Eigen::ArrayXd m_flow;
+  Eigen::ArrayXd m_pressure_new;
+  Eigen::ArrayXd m_flow_new;
+  double m_time_step;
+  size_t m_steps{0};
+  std::shared_ptr<ThreadPool> m_pool;
+
+  size_t Pipe_index(const size_t &vertex_u, const size_t &vertex_v) const;
+};
+
+}
+
+#endif //LIBFLUIDS_TRANSIENT_H
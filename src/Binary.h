@@ -0,0 +1,130 @@
+// MIT License
+//
+// Copyright (c) 2019 Jelle Spijker
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+
+#ifndef LIBFLUIDS_BINARY_H
+#define LIBFLUIDS_BINARY_H
+
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+#include <Eigen/Core>
+
+namespace Fluids {
+/// Buffer of plain values in the byte order of the machine, as written by Checkpoint and by the messages of Service
+class BinaryWriter {
+public:
+  template<typename T>
+  void Write(const T &value) {
+    static_assert(std::is_trivially_copyable<T>::value, "Only plain values can be written.");
+    m_buffer.append(reinterpret_cast<const char *>(&value), sizeof(T));
+  }
+
+  /// Size followed by the values
+  template<typename T>
+  void Write_vector(const std::vector<T> &values) {
+    Write<uint64_t>(values.size());
+    m_buffer.append(reinterpret_cast<const char *>(values.data()), values.size() * sizeof(T));
+  }
+
+  void Write_vector(const Eigen::VectorXd &values) {
+    Write<uint64_t>(static_cast<uint64_t>(values.size()));
+    m_buffer.append(reinterpret_cast<const char *>(values.data()), static_cast<size_t>(values.size()) * sizeof(double));
+  }
+
+  void Append(const BinaryWriter &other) {
+    m_buffer.append(other.m_buffer);
+  }
+
+  const std::string &Get_Buffer() const {
+    return m_buffer;
+  }
+
+private:
+  std::string m_buffer;
+};
+
+/// Reader of a buffer written by BinaryWriter, std::runtime_error when a value would be read past its end
+class BinaryReader {
+public:
+  BinaryReader(const char *data, size_t size) : m_data(data), m_size(size) {}
+
+  template<typename T>
+  T Read() {
+    static_assert(std::is_trivially_copyable<T>::value, "Only plain values can be read.");
+    T value;
+    std::memcpy(&value, Take(sizeof(T)), sizeof(T));
+    return value;
+  }
+
+  /// Number of elements of a vector, checked against the remaining bytes
+  size_t Read_size(size_t element_size) {
+    const auto n = Read<uint64_t>();
+    if (element_size > 0 && n > (m_size - m_position) / element_size)
+      throw std::runtime_error("Binary data is truncated.");
+    return static_cast<size_t>(n);
+  }
+
+  template<typename T>
+  std::vector<T> Read_vector() {
+    std::vector<T> values(Read_size(sizeof(T)));
+    if (!values.empty())
+      std::memcpy(values.data(), Take(values.size() * sizeof(T)), values.size() * sizeof(T));
+    return values;
+  }
+
+  Eigen::VectorXd Read_Eigen_vector() {
+    Eigen::VectorXd values(static_cast<Eigen::Index>(Read_size(sizeof(double))));
+    if (values.size() > 0)
+      std::memcpy(values.data(), Take(static_cast<size_t>(values.size()) * sizeof(double)),
+                  static_cast<size_t>(values.size()) * sizeof(double));
+    return values;
+  }
+
+  size_t Remaining() const {
+    return m_size - m_position;
+  }
+
+  bool At_end() const {
+    return m_position == m_size;
+  }
+
+private:
+  const char *m_data;
+  size_t m_size;
+  size_t m_position{0};
+
+  const char *Take(size_t bytes) {
+    if (bytes > m_size - m_position)
+      throw std::runtime_error("Binary data is truncated.");
+    const char *p = m_data + m_position;
+    m_position += bytes;
+    return p;
+  }
+};
+}
+
+#endif //LIBFLUIDS_BINARY_H
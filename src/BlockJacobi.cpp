@@ -0,0 +1,163 @@
+// MIT License
+//
+// Copyright (c) 2019 Jelle Spijker
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+
+#include "BlockJacobi.h"
+
+namespace Fluids {
+
+BlockJacobi::BlockJacobi(Eigen::Index block_size) : m_block_size(std::max<Eigen::Index>(block_size, 1)) {
+
+}
+
+void BlockJacobi::Build_blocks(const Eigen::SparseMatrix<double> &matrix) {
+  const Eigen::Index n = matrix.rows();
+  if (matrix.cols() != n)
+    throw std::logic_error("A block-Jacobi preconditioner requires a square matrix.");
+  Eigen::SparseMatrix<double, Eigen::RowMajor> rows = matrix;
+
+  // Greedy matching by decreasing magnitude, then augmenting paths for the rows left over
+  std::vector<Eigen::Index> column_of(n, -1);
+  std::vector<Eigen::Index> row_of(n, -1);
+  for (Eigen::Index r = 0; r < n; ++r) {
+    Eigen::Index best = -1;
+    double magnitude = -1.;
+    for (Eigen::SparseMatrix<double, Eigen::RowMajor>::InnerIterator it(rows, r); it; ++it)
+      if (row_of[it.col()] < 0 && std::abs(it.value()) > magnitude) {
+        best = it.col();
+        magnitude = std::abs(it.value());
+      }
+    if (best >= 0) {
+      column_of[r] = best;
+      row_of[best] = r;
+    }
+  }
+  std::vector<Eigen::Index> visited(n, -1);
+  std::vector<std::pair<Eigen::Index, Eigen::SparseMatrix<double, Eigen::RowMajor>::InnerIterator>> path;
+  std::vector<Eigen::Index> path_columns;
+  for (Eigen::Index root = 0; root < n; ++root) {
+    if (column_of[root] >= 0)
+      continue;
+    // Depth first search over alternating paths, without recursion
+    path.clear();
+    path_columns.clear();
+    path.emplace_back(root, Eigen::SparseMatrix<double, Eigen::RowMajor>::InnerIterator(rows, root));
+    bool augmented = false;
+    while (!path.empty() && !augmented) {
+      auto &it = path.back().second;
+      for (; it; ++it)
+        if (visited[it.col()] != root)
+          break;
+      if (!it) {
+        path.pop_back();
+        if (!path_columns.empty())
+          path_columns.pop_back();
+        continue;
+      }
+      const Eigen::Index c = it.col();
+      visited[c] = root;
+      ++it;
+      path_columns.push_back(c);
+      if (row_of[c] < 0) {
+        for (size_t k = 0; k < path_columns.size(); ++k) {
+          column_of[path[k].first] = path_columns[k];
+          row_of[path_columns[k]] = path[k].first;
+        }
+        augmented = true;
+      } else {
+        path.emplace_back(row_of[c], Eigen::SparseMatrix<double, Eigen::RowMajor>::InnerIterator(rows, row_of[c]));
+      }
+    }
+  }
+  // A structurally singular matrix leaves rows unmatched, they are paired with the free columns
+  Eigen::Index free = 0;
+  for (Eigen::Index r = 0; r < n; ++r) {
+    if (column_of[r] >= 0)
+      continue;
+    while (row_of[free] >= 0)
+      ++free;
+    column_of[r] = free;
+    row_of[free] = r;
+  }
+
+  // Aggregate rows that share columns, breadth first from the first row not in a block
+  m_blocks.clear();
+  std::vector<bool> assigned(n, false);
+  for (Eigen::Index seed = 0; seed < n; ++seed) {
+    if (assigned[seed])
+      continue;
+    Block block;
+    block.rows.push_back(seed);
+    assigned[seed] = true;
+    for (size_t head = 0; head < block.rows.size()
+        && static_cast<Eigen::Index>(block.rows.size()) < m_block_size; ++head) {
+      for (Eigen::SparseMatrix<double, Eigen::RowMajor>::InnerIterator it(rows, block.rows[head]); it; ++it) {
+        for (Eigen::SparseMatrix<double>::InnerIterator jt(matrix, it.col()); jt; ++jt) {
+          if (assigned[jt.row()] || static_cast<Eigen::Index>(block.rows.size()) >= m_block_size)
+            continue;
+          assigned[jt.row()] = true;
+          block.rows.push_back(jt.row());
+        }
+      }
+    }
+    for (auto &&r : block.rows)
+      block.columns.push_back(column_of[r]);
+    m_blocks.push_back(std::move(block));
+  }
+  m_rows = n;
+}
+
+void BlockJacobi::Compute(const Eigen::SparseMatrix<double> &matrix) {
+  if (m_rows != matrix.rows())
+    Build_blocks(matrix);
+  for (auto &&block : m_blocks) {
+    const auto size = static_cast<Eigen::Index>(block.rows.size());
+    Eigen::MatrixXd dense(size, size);
+    for (Eigen::Index i = 0; i < size; ++i)
+      for (Eigen::Index j = 0; j < size; ++j)
+        dense(i, j) = matrix.coeff(block.rows[i], block.columns[j]);
+    block.lu.compute(dense);
+    const Eigen::VectorXd diagonal = block.lu.matrixLU().diagonal().cwiseAbs();
+    block.singular = diagonal.minCoeff() <= 1e-14 * std::max(diagonal.maxCoeff(), 1e-300);
+  }
+}
+
+Eigen::VectorXd BlockJacobi::Solve(const Eigen::VectorXd &v) const {
+  Eigen::VectorXd y(v.size());
+  Eigen::VectorXd b;
+  for (auto &&block : m_blocks) {
+    const auto size = static_cast<Eigen::Index>(block.rows.size());
+    b.resize(size);
+    for (Eigen::Index i = 0; i < size; ++i)
+      b(i) = v(block.rows[i]);
+    if (!block.singular)
+      b = block.lu.solve(b);
+    for (Eigen::Index i = 0; i < size; ++i)
+      y(block.columns[i]) = b(i);
+  }
+  return y;
+}
+}
@@ -0,0 +1,66 @@
+// MIT License
+//
+// Copyright (c) 2019 Jelle Spijker
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+
+#ifndef LIBFLUIDS_BLOCKJACOBI_H
+#define LIBFLUIDS_BLOCKJACOBI_H
+
+#include <vector>
+
+#include <Eigen/Core>
+#include <Eigen/LU>
+#include <Eigen/SparseCore>
+
+namespace Fluids {
+/// Block-Jacobi preconditioner of a square sparse Jacobian whose rows and columns are not paired: a row is a
+/// Bernoulli or mass balance and a column a speed, pressure or flow. Every row is matched once to a column it depends
+/// on, strongest entries (the linearized pipe resistances) first, and the matched pairs are aggregated into small
+/// blocks of rows that share columns. Applying the preconditioner solves the dense block of every aggregate, so it
+/// costs memory linear in the size of the network.
+class BlockJacobi {
+public:
+  /// \param block_size largest number of rows of a block
+  explicit BlockJacobi(Eigen::Index block_size = 4);
+
+  /// Factor the blocks of a matrix, the matching and the blocks are kept as long as the pattern has the same size
+  void Compute(const Eigen::SparseMatrix<double> &matrix);
+
+  /// Apply the inverse of the blocks, from the residual rows to the unknowns
+  Eigen::VectorXd Solve(const Eigen::VectorXd &v) const;
+
+private:
+  struct Block {
+    std::vector<Eigen::Index> rows;
+    std::vector<Eigen::Index> columns; //! Matched column of every row
+    Eigen::PartialPivLU<Eigen::MatrixXd> lu;
+    bool singular{false}; //! Passed through without scaling
+  };
+
+  Eigen::Index m_block_size;
+  Eigen::Index m_rows{-1};
+  std::vector<Block> m_blocks;
+
+  void Build_blocks(const Eigen::SparseMatrix<double> &matrix);
+};
+}
+
+#endif //LIBFLUIDS_BLOCKJACOBI_H
@@ -0,0 +1,364 @@
+// MIT License
+//
+// Copyright (c) 2019 Jelle Spijker
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <typeinfo>
+#include <unordered_map>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
+#include <fluids/Checkpoint.h>
+#include <fluids/Pipes.h>
+#include "Binary.h"
+
+namespace Fluids {
+
+const uint32_t Checkpoint::Version = 2;
+
+namespace {
+const char Magic[8] = {'F', 'L', 'U', 'I', 'D', 'S', 'C', 'P'};
+const uint32_t Endianness = 0x01020304;
+
+enum class ComponentType : uint8_t {
+  Plain = 0,
+  Pipe = 1,
+  Transport = 2
+};
+
+/// 64 bit FNV-1a hash
+uint64_t Checksum(const char *data, size_t size) {
+  uint64_t hash = 14695981039346656037ull;
+  for (size_t i = 0; i < size; ++i) {
+    hash ^= static_cast<unsigned char>(data[i]);
+    hash *= 1099511628211ull;
+  }
+  return hash;
+}
+
+template<typename T>
+T Read_plain(std::istream &stream) {
+  T value;
+  if (!stream.read(reinterpret_cast<char *>(&value), sizeof(T)))
+    throw std::runtime_error("Checkpoint is truncated.");
+  return value;
+}
+
+size_t Read_id(BinaryReader &reader, size_t n) {
+  const auto id = reader.Read<uint64_t>();
+  if (id >= n)
+    throw std::runtime_error("Checkpoint refers to a vertex that does not exist.");
+  return static_cast<size_t>(id);
+}
+
+template<typename T>
+T Quantity(double value) {
+  return T::from_value(value);
+}
+}
+
+void Checkpoint::Save(std::ostream &stream, const System &system, const SolutionCache *cache) {
+  const Graph &graph = system.m_graph;
+  const size_t n = system.m_vertices.size();
+  std::unordered_map<vertex_t, uint64_t> ids;
+  std::unordered_map<const void *, uint64_t> quantity_ids;
+  for (size_t id = 0; id < n; ++id) {
+    const vertex_t u = system.m_vertices[id];
+    ids.emplace(u, id);
+    quantity_ids.emplace(graph[u]->Get_Speed().get(), id);
+    quantity_ids.emplace(graph[u]->Get_Static_pressure().get(), id);
+  }
+
+  BinaryWriter writer;
+  writer.Write<uint64_t>(system.m_topology_version);
+  writer.Write<uint8_t>(system.m_initialized);
+  writer.Write<uint64_t>(n);
+  for (size_t id = 0; id < n; ++id) {
+    const Liquid &liquid = *graph[system.m_vertices[id]];
+    writer.Write(liquid.Get_Density()->value());
+    writer.Write(liquid.Get_Dynamic_viscosity()->value());
+    writer.Write(liquid.Get_Height()->value());
+    writer.Write(liquid.Get_Speed()->value());
+    writer.Write(liquid.Get_Static_pressure()->value());
+  }
+
+  // Edges in their storage order, which is the order of the Bernoulli rows
+  std::unordered_map<const void *, std::pair<uint64_t, uint64_t>> flow_edges;
+  writer.Write<uint64_t>(boost::num_edges(graph));
+  auto es = boost::edges(graph);
+  for (auto eit = es.first; eit != es.second; ++eit) {
+    const std::shared_ptr<FluidComponents> &component = graph[*eit];
+    const uint64_t u = ids.at(boost::source(*eit, graph));
+    const uint64_t v = ids.at(boost::target(*eit, graph));
+    writer.Write(u);
+    writer.Write(v);
+    writer.Write<uint8_t>(component->Is_Active());
+    if (component->isTransportEdge()) {
+      writer.Write(ComponentType::Transport);
+      writer.Write(component->Get_Volumetricflow()->value());
+      flow_edges.emplace(component->Get_Volumetricflow().get(), std::make_pair(u, v));
+    } else if (auto pipe = std::dynamic_pointer_cast<Pipes>(component)) {
+      writer.Write(ComponentType::Pipe);
+      writer.Write(pipe->Get_Diameter()->value());
+      writer.Write(pipe->Get_Length()->value());
+      writer.Write(pipe->Get_Roughness()->value());
+    } else if (typeid(*component) == typeid(FluidComponents)) {
+      writer.Write(ComponentType::Plain);
+      writer.Write(component->Get_CrossSection()->value());
+      writer.Write(component->Get_DeltaPressure()->value());
+    } else {
+      throw std::logic_error("Only pipes and plain components can be saved in a checkpoint.");
+    }
+  }
+
+  // Known/unknown partition in the order of the vectors, which is the order of the unknown vector
+  auto write_ids = [&](const auto &values, const std::unordered_map<const void *, uint64_t> &by_quantity) {
+    writer.Write<uint64_t>(values.size());
+    for (auto &&value : values)
+      writer.Write(by_quantity.at(value.get()));
+  };
+  auto write_edges = [&](const shared_volumetric_flow_vector &flows) {
+    writer.Write<uint64_t>(flows.size());
+    for (auto &&flow : flows) {
+      const auto &edge = flow_edges.at(flow.get());
+      writer.Write(edge.first);
+      writer.Write(edge.second);
+    }
+  };
+  write_ids(system.m_known_speeds, quantity_ids);
+  write_ids(system.m_unknown_speeds, quantity_ids);
+  write_ids(system.m_known_static_pressures, quantity_ids);
+  write_ids(system.m_unknown_static_pressures, quantity_ids);
+  write_edges(system.m_known_volumetric_flows);
+  write_edges(system.m_unknown_volumetric_flows);
+
+  writer.Write_vector(std::vector<uint64_t>(system.m_indices.begin(), system.m_indices.end()));
+
+  writer.Write<uint8_t>(cache != nullptr);
+  if (cache)
+    cache->Write(writer);
+
+  const std::string &payload = writer.Get_Buffer();
+  stream.write(Magic, sizeof(Magic));
+  stream.write(reinterpret_cast<const char *>(&Version), sizeof(Version));
+  stream.write(reinterpret_cast<const char *>(&Endianness), sizeof(Endianness));
+  const uint64_t size = payload.size();
+  stream.write(reinterpret_cast<const char *>(&size), sizeof(size));
+  stream.write(payload.data(), static_cast<std::streamsize>(payload.size()));
+  const uint64_t checksum = Checksum(payload.data(), payload.size());
+  stream.write(reinterpret_cast<const char *>(&checksum), sizeof(checksum));
+  if (!stream)
+    throw std::runtime_error("Checkpoint could not be written.");
+}
+
+std::shared_ptr<System> Checkpoint::Restore(std::istream &stream, SolutionCache *cache) {
+  char magic[sizeof(Magic)];
+  if (!stream.read(magic, sizeof(magic)) || std::memcmp(magic, Magic, sizeof(Magic)) != 0)
+    throw std::runtime_error("Not a checkpoint.");
+  if (Read_plain<uint32_t>(stream) != Version)
+    throw std::runtime_error("Checkpoint of another format version.");
+  if (Read_plain<uint32_t>(stream) != Endianness)
+    throw std::runtime_error("Checkpoint written on a machine of other endianness.");
+  const auto size = Read_plain<uint64_t>(stream);
+  // Read in chunks, a corrupt size must not allocate more than the stream holds
+  std::string payload;
+  const size_t chunk = 1 << 20;
+  while (payload.size() < size) {
+    const size_t offset = payload.size();
+    payload.resize(offset + static_cast<size_t>(std::min<uint64_t>(chunk, size - offset)));
+    if (!stream.read(&payload[offset], static_cast<std::streamsize>(payload.size() - offset)))
+      throw std::runtime_error("Checkpoint is truncated.");
+  }
+  if (Read_plain<uint64_t>(stream) != Checksum(payload.data(), payload.size()))
+    throw std::runtime_error("Checkpoint is corrupt.");
+
+  BinaryReader reader(payload.data(), payload.size());
+  const auto topology_version = static_cast<size_t>(reader.Read<uint64_t>());
+  const bool initialized = reader.Read<uint8_t>() != 0;
+  const size_t n = reader.Read_size(5 * sizeof(double));
+  std::vector<double> liquids(5 * n);
+  for (auto &&value : liquids)
+    value = reader.Read<double>();
+
+  struct Edge {
+    size_t u;
+    size_t v;
+    bool active;
+    ComponentType type;
+    double parameters[3];
+  };
+  std::vector<Edge> edges(reader.Read_size(2 * sizeof(uint64_t) + 2));
+  size_t n_transport = 0;
+  for (auto &&edge : edges) {
+    edge.u = Read_id(reader, n);
+    edge.v = Read_id(reader, n);
+    edge.active = reader.Read<uint8_t>() != 0;
+    edge.type = reader.Read<ComponentType>();
+    const int n_parameters = edge.type == ComponentType::Pipe ? 3 : edge.type == ComponentType::Plain ? 2 : 1;
+    if (edge.type == ComponentType::Transport)
+      ++n_transport;
+    else if (edge.type != ComponentType::Plain && edge.type != ComponentType::Pipe)
+      throw std::runtime_error("Checkpoint holds an unknown type of component.");
+    for (int i = 0; i < n_parameters; ++i)
+      edge.parameters[i] = reader.Read<double>();
+  }
+  if (n_transport > n || (n_transport > 0 && !initialized))
+    throw std::runtime_error("Checkpoint does not match its topology.");
+
+  // The components between the vertices of the user in their saved order, Initialize adds the transport edges and
+  // their vertices with the same ids as before
+  const size_t n_user = n - n_transport;
+  auto system = std::make_shared<System>(Liquid(), n_user);
+  for (auto &&edge : edges) {
+    if (edge.type == ComponentType::Transport)
+      continue;
+    if (edge.u >= n_user || edge.v >= n_user)
+      throw std::runtime_error("Checkpoint does not match its topology.");
+    std::shared_ptr<FluidComponents> component;
+    if (edge.type == ComponentType::Pipe) {
+      component = std::make_shared<Pipes>(edge.parameters[0] * si::meter, edge.parameters[1] * si::meter,
+                                          edge.parameters[2] * si::meter);
+    } else {
+      component = std::make_shared<FluidComponents>();
+      *component->Get_CrossSection() = Quantity<quantity<si::area>>(edge.parameters[0]);
+      *component->Get_DeltaPressure() = Quantity<quantity<si::pressure>>(edge.parameters[1]);
+    }
+    component->Set_Active(edge.active);
+    system->add_FluidComponent(component, edge.u, edge.v);
+  }
+  if (initialized)
+    system->Initialize();
+  if (system->m_vertices.size() != n)
+    throw std::runtime_error("Checkpoint does not match its topology.");
+  for (auto &&edge : edges) {
+    if (edge.type != ComponentType::Transport)
+      continue;
+    edge_t e;
+    bool found;
+    boost::tie(e, found) = boost::edge(system->m_vertices[edge.u], system->m_vertices[edge.v], system->m_graph);
+    if (!found || !system->m_graph[e]->isTransportEdge())
+      throw std::runtime_error("Checkpoint does not match its topology.");
+    system->m_graph[e]->Set_Active(edge.active);
+    *system->m_graph[e]->Get_Volumetricflow() = Quantity<quantity<si::volumetric_flow>>(edge.parameters[0]);
+  }
+  for (size_t id = 0; id < n; ++id) {
+    const Liquid &liquid = *system->Get_Liquid(id);
+    const double *value = &liquids[5 * id];
+    *liquid.Get_Density() = Quantity<quantity<si::mass_density>>(value[0]);
+    *liquid.Get_Dynamic_viscosity() = Quantity<quantity<si::dynamic_viscosity>>(value[1]);
+    *liquid.Get_Height() = Quantity<quantity<si::length>>(value[2]);
+    *liquid.Get_Speed() = Quantity<quantity<si::velocity>>(value[3]);
+    *liquid.Get_Static_pressure() = Quantity<quantity<si::pressure>>(value[4]);
+  }
+
+  // The partition is read before the storage order is applied, which would sort the vectors. A vertex or transport
+  // edge is listed at most once in the known and unknown values of a kind
+  const char *twice = "Checkpoint lists a vertex or edge twice in its known and unknown values.";
+  auto read_id = [&](std::vector<char> &listed) {
+    const size_t id = Read_id(reader, n);
+    if (listed[id])
+      throw std::runtime_error(twice);
+    listed[id] = 1;
+    return id;
+  };
+  auto read_speeds = [&](std::vector<char> &listed) {
+    shared_velocity_vector speeds(reader.Read_size(sizeof(uint64_t)));
+    for (auto &&speed : speeds)
+      speed = system->Get_Liquid(read_id(listed))->Get_Speed();
+    return speeds;
+  };
+  auto read_pressures = [&](std::vector<char> &listed) {
+    shared_pressure_vector pressures(reader.Read_size(sizeof(uint64_t)));
+    for (auto &&pressure : pressures)
+      pressure = system->Get_Liquid(read_id(listed))->Get_Static_pressure();
+    return pressures;
+  };
+  auto read_flows = [&](std::unordered_set<const void *> &listed) {
+    shared_volumetric_flow_vector flows(reader.Read_size(2 * sizeof(uint64_t)));
+    for (auto &&flow : flows) {
+      const size_t u = Read_id(reader, n);
+      const size_t v = Read_id(reader, n);
+      edge_t e;
+      bool found;
+      boost::tie(e, found) = boost::edge(system->m_vertices[u], system->m_vertices[v], system->m_graph);
+      if (!found || !system->m_graph[e]->isTransportEdge())
+        throw std::runtime_error("Checkpoint does not match its topology.");
+      flow = system->m_graph[e]->Get_Volumetricflow();
+      if (!listed.insert(flow.get()).second)
+        throw std::runtime_error(twice);
+    }
+    return flows;
+  };
+  std::vector<char> speeds(n, 0), pressures(n, 0);
+  std::unordered_set<const void *> flows;
+  shared_velocity_vector known_speeds = read_speeds(speeds);
+  shared_velocity_vector unknown_speeds = read_speeds(speeds);
+  shared_pressure_vector known_static_pressures = read_pressures(pressures);
+  shared_pressure_vector unknown_static_pressures = read_pressures(pressures);
+  shared_volumetric_flow_vector known_volumetric_flows = read_flows(flows);
+  shared_volumetric_flow_vector unknown_volumetric_flows = read_flows(flows);
+  // The vertices of the user and the transport edges are always listed, the vertices added by Initialize only once
+  // their value is set as known
+  for (size_t id = 0; id < n_user; ++id)
+    if (!speeds[id] || !pressures[id])
+      throw std::runtime_error("Checkpoint leaves a vertex out of its known and unknown values.");
+  if (flows.size() != n_transport)
+    throw std::runtime_error("Checkpoint leaves an edge out of its known and unknown values.");
+
+  const std::vector<uint64_t> indices = reader.Read_vector<uint64_t>();
+  if (!indices.empty()) {
+    if (indices.size() != n || !initialized)
+      throw std::runtime_error("Checkpoint does not match its topology.");
+    std::vector<size_t> order(n, n);
+    for (size_t id = 0; id < n; ++id) {
+      if (indices[id] >= n || order[indices[id]] != n)
+        throw std::runtime_error("Checkpoint holds an invalid storage order.");
+      order[indices[id]] = id;
+    }
+    system->Permute(order);
+  }
+  system->m_known_speeds = std::move(known_speeds);
+  system->m_unknown_speeds = std::move(unknown_speeds);
+  system->m_known_static_pressures = std::move(known_static_pressures);
+  system->m_unknown_static_pressures = std::move(unknown_static_pressures);
+  system->m_known_volumetric_flows = std::move(known_volumetric_flows);
+  system->m_unknown_volumetric_flows = std::move(unknown_volumetric_flows);
+  // The cached solutions are keyed by the topology version
+  system->m_topology_version = topology_version;
+
+  const bool has_cache = reader.Read<uint8_t>() != 0;
+  if (has_cache) {
+    if (cache)
+      cache->Read(reader);
+    else
+      SolutionCache().Read(reader);
+  }
+  if (!reader.At_end())
+    throw std::runtime_error("Checkpoint is corrupt.");
+  return system;
+}
+
+}
@@ -0,0 +1,212 @@
+// MIT License
+//
+// Copyright (c) 2019 Jelle Spijker
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+
+#include <cmath>
+#include <stdexcept>
+
+#include <Eigen/SparseLU>
+
+#include <fluids/Continuation.h>
+#include "Functor.h"
+#include "SparseJacobian.h"
+
+namespace Fluids {
+
+struct Continuation::Session {
+  std::unique_ptr<SparseJacobian> jacobian;
+  Eigen::SparseLU<Eigen::SparseMatrix<double>, Eigen::COLAMDOrdering<int>> lu;
+};
+
+Continuation::Continuation(const std::shared_ptr<System> &system, const Parameter_setter &setter)
+    : m_system(system), m_setter(setter), m_session(std::make_shared<Session>()) {
+
+}
+
+bool Continuation::Correct(double parameter, Eigen::VectorXd &x, size_t max_iterations, size_t &iterations) {
+  m_setter(*m_system, parameter);
+  System_Functor_Base func(m_system);
+  Eigen::VectorXd residual(func.values());
+  Eigen::VectorXd residual_new(func.values());
+  Eigen::VectorXd x_new(x.size());
+  func(x, residual);
+  ++m_statistics.residual_evaluations;
+  iterations = 0;
+  bool factor = true;
+  while (residual.norm() > m_tolerance) {
+    if (iterations >= max_iterations)
+      return false;
+    ++iterations;
+    ++m_statistics.iterations;
+    bool fresh = factor;
+    if (factor) {
+      m_statistics.residual_evaluations += m_session->jacobian->Evaluate(x, residual);
+      ++m_statistics.jacobian_evaluations;
+      m_session->lu.factorize(m_session->jacobian->Get_Matrix());
+      ++m_statistics.factorizations;
+      if (m_session->lu.info() != Eigen::Success)
+        return false;
+      factor = false;
+    }
+    Eigen::VectorXd step = -m_session->lu.solve(residual);
+    x_new = x + step;
+    func(x_new, residual_new);
+    ++m_statistics.residual_evaluations;
+    // Backtrack along a fresh Newton direction, a stale direction is refactored instead
+    for (size_t k = 0; fresh && k < 10 && !(residual_new.norm() < residual.norm()); ++k) {
+      step *= 0.5;
+      x_new = x + step;
+      func(x_new, residual_new);
+      ++m_statistics.residual_evaluations;
+    }
+    if (!(residual_new.norm() < residual.norm())) {
+      if (fresh)
+        return false;
+      factor = true;
+      continue;
+    }
+    if (residual_new.norm() > 0.5 * residual.norm())
+      factor = true;
+    x.swap(x_new);
+    residual.swap(residual_new);
+  }
+  m_statistics.residual_norm = residual.norm();
+  return true;
+}
+
+Eigen::VectorXd Continuation::Tangent(double parameter, const Eigen::VectorXd &x) {
+  // dx/dp = -J^-1 dF/dp at the converged point
+  System_Functor_Base func(m_system);
+  Eigen::VectorXd residual(func.values());
+  Eigen::VectorXd residual_perturbed(func.values());
+  double delta = 1.e-6 * std::max(std::abs(parameter), 1.);
+  m_setter(*m_system, parameter + delta);
+  func(x, residual_perturbed);
+  m_setter(*m_system, parameter);
+  func(x, residual);
+  m_statistics.residual_evaluations += 2;
+  m_statistics.residual_evaluations += m_session->jacobian->Evaluate(x, residual);
+  ++m_statistics.jacobian_evaluations;
+  m_session->lu.factorize(m_session->jacobian->Get_Matrix());
+  ++m_statistics.factorizations;
+  func(x, residual);
+  ++m_statistics.residual_evaluations;
+  if (m_session->lu.info() != Eigen::Success)
+    return Eigen::VectorXd::Zero(x.size());
+  return -m_session->lu.solve((residual_perturbed - residual) / delta);
+}
+
+std::vector<ContinuationPoint> Continuation::Trace(const std::vector<double> &path) {
+  std::vector<ContinuationPoint> points;
+  m_statistics = SolverStatistics();
+  if (path.empty())
+    return points;
+
+  m_system->Initialize();
+  m_setter(*m_system, path.front());
+  if (m_system->n_unknowns() != m_system->n_residuals())
+    throw std::runtime_error("Continuation requires as many residuals as unknowns.");
+  if (!m_session->jacobian || m_session->jacobian->Get_Topology_version() != m_system->Get_Topology_version()) {
+    m_session->jacobian = std::make_unique<SparseJacobian>(m_system);
+    m_session->lu.analyzePattern(m_session->jacobian->Get_Matrix());
+    ++m_statistics.symbolic_analyses;
+  }
+
+  Eigen::VectorXd x = m_system->Get_Initial_vector();
+  size_t iterations;
+  // The start is a cold solve, allow it more iterations than a corrector step
+  if (!Correct(path.front(), x, 10 * m_max_corrector_iterations, iterations))
+    throw std::runtime_error("Continuation did not converge at the start of the path.");
+  points.push_back({path.front(), x, iterations, true});
+  Eigen::VectorXd tangent = Tangent(path.front(), x);
+
+  double step = 0.;
+  for (size_t s = 1; s < path.size(); ++s) {
+    double parameter = path[s - 1];
+    const double target = path[s];
+    const double length = std::abs(target - parameter);
+    if (length == 0.) {
+      points.push_back({target, x, 0, true});
+      continue;
+    }
+    const double direction = target > parameter ? 1. : -1.;
+    if (step <= 0.)
+      step = length;
+    while (parameter != target) {
+      bool last = step >= std::abs(target - parameter);
+      double next = last ? target : parameter + direction * step;
+      Eigen::VectorXd predicted = x + (next - parameter) * tangent;
+      if (Correct(next, predicted, m_max_corrector_iterations, iterations)) {
+        tangent = (predicted - x) / (next - parameter);
+        x = predicted;
+        parameter = next;
+        points.push_back({parameter, x, iterations, last});
+        if (iterations <= 2)
+          step *= 2.;
+        else if (2 * iterations > m_max_corrector_iterations)
+          step *= 0.5;
+      } else {
+        step *= 0.5;
+        if (step < m_min_step * length) {
+          // Leave the system at the last point on the curve
+          m_setter(*m_system, parameter);
+          System_Functor_Base func(m_system);
+          Eigen::VectorXd residual(func.values());
+          func(x, residual);
+          throw std::runtime_error("Continuation step became too small.");
+        }
+      }
+    }
+  }
+  m_statistics.converged = true;
+  return points;
+}
+
+const SolverStatistics &Continuation::Get_Statistics() const {
+  return m_statistics;
+}
+
+double Continuation::Get_Tolerance() const {
+  return m_tolerance;
+}
+
+void Continuation::Set_Tolerance(double tolerance) {
+  Continuation::m_tolerance = tolerance;
+}
+
+size_t Continuation::Get_Max_corrector_iterations() const {
+  return m_max_corrector_iterations;
+}
+
+void Continuation::Set_Max_corrector_iterations(size_t max_corrector_iterations) {
+  Continuation::m_max_corrector_iterations = max_corrector_iterations;
+}
+
+double Continuation::Get_Min_step() const {
+  return m_min_step;
+}
+
+void Continuation::Set_Min_step(double min_step) {
+  Continuation::m_min_step = min_step;
+}
+
+}
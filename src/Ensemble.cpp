@@ -0,0 +1,153 @@
+// MIT License
+//
+// Copyright (c) 2019 Jelle Spijker
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+
+#include <stdexcept>
+
+#include <fluids/Ensemble.h>
+#include "ModelData.h"
+#include "LaneNewton.h"
+
+namespace Fluids {
+
+struct Ensemble::Session {
+  std::shared_ptr<const Model> model;
+  LaneNewton newton;
+  FlatModel::Lanes speed;    //! Known speeds of every lane
+  FlatModel::Lanes pressure; //! Known static pressures of every lane
+  FlatModel::Lanes open;     //! Open edges of every lane
+  FlatModel::Lanes x;
+
+  Session(const std::shared_ptr<const Model> &shared_model, size_t lanes)
+      : model(shared_model), newton(model->m_data->flat, model->m_data->pattern, model->m_data->colors) {
+    const FlatModel &flat = model->m_data->flat;
+    speed = flat.Get_Speeds().replicate(static_cast<Eigen::Index>(lanes), 1).array();
+    pressure = flat.Get_Static_pressures().replicate(static_cast<Eigen::Index>(lanes), 1).array();
+    open = flat.Get_Open().replicate(static_cast<Eigen::Index>(lanes), 1).array();
+  }
+
+  const FlatModel &Flat() const {
+    return model->m_data->flat;
+  }
+};
+
+Ensemble::Ensemble(const std::shared_ptr<System> &system, size_t lanes)
+    : Ensemble(std::make_shared<const Model>(system), lanes) {
+
+}
+
+Ensemble::Ensemble(const std::shared_ptr<const Model> &model, size_t lanes)
+    : m_lanes(lanes), m_statistics(lanes) {
+  if (lanes == 0)
+    throw std::logic_error("An ensemble requires at least one lane.");
+  m_session = std::make_shared<Session>(model, lanes);
+}
+
+size_t Ensemble::Get_Lanes() const {
+  return m_lanes;
+}
+
+void Ensemble::Set_Known_Speed(const size_t &vertex, const Eigen::ArrayXd &speed) {
+  const size_t i = m_session->Flat().Vertex_index(vertex);
+  if (static_cast<Eigen::Index>(i) >= m_session->Flat().n_vertices() || m_session->Flat().Get_Vertices()[i].speed >= 0)
+    throw std::logic_error("Speed of the vertex is not known in the system.");
+  if (speed.size() != static_cast<Eigen::Index>(m_lanes))
+    throw std::logic_error("Expected one speed per lane.");
+  m_session->speed.col(i) = speed;
+}
+
+void Ensemble::Set_Known_Static_Pressure(const size_t &vertex, const Eigen::ArrayXd &pressure) {
+  const size_t i = m_session->Flat().Vertex_index(vertex);
+  if (static_cast<Eigen::Index>(i) >= m_session->Flat().n_vertices()
+      || m_session->Flat().Get_Vertices()[i].pressure >= 0)
+    throw std::logic_error("Static pressure of the vertex is not known in the system.");
+  if (pressure.size() != static_cast<Eigen::Index>(m_lanes))
+    throw std::logic_error("Expected one static pressure per lane.");
+  m_session->pressure.col(i) = pressure;
+}
+
+void Ensemble::Set_Active(const size_t &vertex_u, const size_t &vertex_v, const Eigen::ArrayXd &open) {
+  const FlatModel &flat = m_session->Flat();
+  const Eigen::Index edge = flat.Edge_index(vertex_u, vertex_v);
+  if ((open < 0.5).any())
+    flat.Check_Closable(edge);
+  if (open.size() != static_cast<Eigen::Index>(m_lanes))
+    throw std::logic_error("Expected one position per lane.");
+  m_session->open.col(edge) = open;
+}
+
+size_t Ensemble::Solve() {
+  Session &s = *m_session;
+  s.x = s.model->Get_Initial_vector().transpose().replicate(static_cast<Eigen::Index>(m_lanes), 1).array();
+  return s.newton.Solve(s.speed, s.pressure, s.open, s.x, m_tolerance, m_max_iterations, m_statistics, m_pool.get());
+}
+
+Eigen::VectorXd Ensemble::Get_State(size_t lane) const {
+  if (lane >= m_lanes || m_session->x.rows() == 0)
+    throw std::logic_error("No state for the lane, solve the ensemble first.");
+  return m_session->x.row(lane).transpose().matrix();
+}
+
+Eigen::ArrayXd Ensemble::Get_Speed(const size_t &vertex) const {
+  const size_t i = m_session->Flat().Vertex_index(vertex);
+  Eigen::Index column = m_session->Flat().Get_Vertices().at(i).speed;
+  if (column >= 0 && m_session->x.rows() > 0)
+    return m_session->x.col(column);
+  return m_session->speed.col(i);
+}
+
+Eigen::ArrayXd Ensemble::Get_Static_pressure(const size_t &vertex) const {
+  const size_t i = m_session->Flat().Vertex_index(vertex);
+  Eigen::Index column = m_session->Flat().Get_Vertices().at(i).pressure;
+  if (column >= 0 && m_session->x.rows() > 0)
+    return m_session->x.col(column);
+  return m_session->pressure.col(i);
+}
+
+const std::vector<SolverStatistics> &Ensemble::Get_Statistics() const {
+  return m_statistics;
+}
+
+double Ensemble::Get_Tolerance() const {
+  return m_tolerance;
+}
+
+void Ensemble::Set_Tolerance(double tolerance) {
+  m_tolerance = tolerance;
+}
+
+size_t Ensemble::Get_Max_iterations() const {
+  return m_max_iterations;
+}
+
+void Ensemble::Set_Max_iterations(size_t max_iterations) {
+  m_max_iterations = max_iterations;
+}
+
+const std::shared_ptr<ThreadPool> &Ensemble::Get_Thread_pool() const {
+  return m_pool;
+}
+
+void Ensemble::Set_Thread_pool(const std::shared_ptr<ThreadPool> &pool) {
+  m_pool = pool;
+}
+}
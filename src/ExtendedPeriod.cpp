@@ -0,0 +1,133 @@
+// MIT License
+//
+// Copyright (c) 2019 Jelle Spijker
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+
+#include <cmath>
+#include <stdexcept>
+
+#include <fluids/ExtendedPeriod.h>
+
+namespace Fluids {
+
+double Pattern::At(const quantity<si::time> &time) const {
+  if (multipliers.empty())
+    return 1.;
+  if (interval.value() <= 0.)
+    throw std::logic_error("Pattern interval should be positive.");
+  // Small tolerance so that a step on an interval boundary uses the new multiplier
+  double period = std::floor(time.value() / interval.value() + 1.e-9);
+  auto n = static_cast<double>(multipliers.size());
+  auto k = static_cast<size_t>(period - n * std::floor(period / n));
+  return multipliers[k];
+}
+
+ExtendedPeriod::ExtendedPeriod(const std::shared_ptr<const Model> &model) : m_model(model) {
+
+}
+
+void ExtendedPeriod::Add_Speed_pattern(const size_t &vertex, const quantity<si::velocity> &base,
+                                       const Pattern &pattern) {
+  if (!m_model->Is_Known_speed(vertex))
+    throw std::logic_error("Speed of the vertex is not known in the model.");
+  m_drivers.push_back({vertex, false, base.value(), pattern});
+}
+
+void ExtendedPeriod::Add_Static_pressure_pattern(const size_t &vertex, const quantity<si::pressure> &base,
+                                                 const Pattern &pattern) {
+  if (!m_model->Is_Known_static_pressure(vertex))
+    throw std::logic_error("Static pressure of the vertex is not known in the model.");
+  m_drivers.push_back({vertex, true, base.value(), pattern});
+}
+
+SolverStatistics ExtendedPeriod::Run(const quantity<si::time> &duration, const quantity<si::time> &step,
+                                     const Step_callback &callback) {
+  if (step.value() <= 0.)
+    throw std::logic_error("Time step should be positive.");
+  SolveState state(m_model);
+  state.Set_Tolerance(m_tolerance);
+  state.Set_Max_iterations(m_max_iterations);
+  state.Set_Thread_pool(m_pool);
+
+  SolverStatistics total;
+  total.converged = true;
+  auto add = [&total](const SolverStatistics &statistics) {
+    total.iterations += statistics.iterations;
+    total.symbolic_analyses += statistics.symbolic_analyses;
+    total.residual_evaluations += statistics.residual_evaluations;
+    total.jacobian_evaluations += statistics.jacobian_evaluations;
+    total.factorizations += statistics.factorizations;
+    total.factorizations_saved += statistics.factorizations_saved;
+    total.linear_iterations += statistics.linear_iterations;
+    total.residual_norm = std::max(total.residual_norm, statistics.residual_norm);
+  };
+
+  const auto n_steps = static_cast<size_t>(std::floor(duration.value() / step.value() + 1.e-9));
+  for (size_t k = 0; k <= n_steps; ++k) {
+    PeriodStep period_step;
+    period_step.index = k;
+    period_step.time = static_cast<double>(k) * step;
+    for (auto &&driver : m_drivers) {
+      double value = driver.base * driver.pattern.At(period_step.time);
+      if (driver.pressure)
+        state.Set_Known_Static_Pressure(driver.vertex, value * si::pascals);
+      else
+        state.Set_Known_Speed(driver.vertex, value * si::meters_per_second);
+    }
+    period_step.statistics = state.Solve();
+    add(period_step.statistics);
+    if (!period_step.statistics.converged) { // Cold start
+      state.Set_Unknown_vector(m_model->Get_Initial_vector());
+      period_step.statistics = state.Solve();
+      add(period_step.statistics);
+    }
+    total.converged = total.converged && period_step.statistics.converged;
+    period_step.state = &state;
+    if (callback)
+      callback(period_step);
+  }
+  return total;
+}
+
+double ExtendedPeriod::Get_Tolerance() const {
+  return m_tolerance;
+}
+
+void ExtendedPeriod::Set_Tolerance(double tolerance) {
+  m_tolerance = tolerance;
+}
+
+size_t ExtendedPeriod::Get_Max_iterations() const {
+  return m_max_iterations;
+}
+
+void ExtendedPeriod::Set_Max_iterations(size_t max_iterations) {
+  m_max_iterations = max_iterations;
+}
+
+const std::shared_ptr<ThreadPool> &ExtendedPeriod::Get_Thread_pool() const {
+  return m_pool;
+}
+
+void ExtendedPeriod::Set_Thread_pool(const std::shared_ptr<ThreadPool> &pool) {
+  m_pool = pool;
+}
+}
@@ -0,0 +1,349 @@
+// MIT License
+//
+// Copyright (c) 2019 Jelle Spijker
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+
+#include <functional>
+#include <stdexcept>
+#include <typeinfo>
+#include <unordered_map>
+
+#include "FlatModel.h"
+#include "../include/fluids/Pipes.h"
+
+namespace Fluids {
+
+FlatModel::FlatModel(const System &system) {
+  const Graph &graph = system.Get_Graph();
+
+  std::unordered_map<const void *, Eigen::Index> column;
+  for (auto &&s : system.Get_Unknown_speeds())
+    column[s.get()] = m_description.n_unknowns++;
+  for (auto &&p : system.Get_Unknown_static_pressures())
+    column[p.get()] = m_description.n_unknowns++;
+  for (auto &&q : system.Get_Unknown_volumetric_flow())
+    column[q.get()] = m_description.n_unknowns++;
+  auto column_of = [&](const void *p) -> Eigen::Index {
+    auto it = column.find(p);
+    return it == column.end() ? -1 : it->second;
+  };
+
+  m_description.vertex_index = system.Get_Vertex_indices();
+  std::unordered_map<vertex_t, Eigen::Index> vertex_id;
+  auto vs = boost::vertices(graph);
+  for (auto vit = vs.first; vit != vs.second; ++vit) {
+    const Liquid &liquid = *graph[*vit];
+    vertex_id[*vit] = static_cast<Eigen::Index>(m_description.vertices.size());
+    Vertex vertex;
+    vertex.density = liquid.Get_Density()->value();
+    vertex.dynamic_viscosity = liquid.Get_Dynamic_viscosity()->value();
+    vertex.potential_pressure = liquid.Get_Potential_pressure()->value();
+    vertex.speed = column_of(liquid.Get_Speed().get());
+    vertex.pressure = column_of(liquid.Get_Static_pressure().get());
+    m_description.vertices.push_back(vertex);
+  }
+  m_description.speeds.resize(m_description.vertices.size());
+  m_description.static_pressures.resize(m_description.vertices.size());
+  for (auto vit = vs.first; vit != vs.second; ++vit) {
+    m_description.speeds(vertex_id[*vit]) = graph[*vit]->Get_Speed()->value();
+    m_description.static_pressures(vertex_id[*vit]) = graph[*vit]->Get_Static_pressure()->value();
+  }
+
+  std::unordered_map<const FluidComponents *, Eigen::Index> edge_id;
+  auto es = boost::edges(graph);
+  for (auto eit = es.first; eit != es.second; ++eit) {
+    const std::shared_ptr<FluidComponents> &component = graph[*eit];
+    edge_id[component.get()] = static_cast<Eigen::Index>(m_description.edges.size());
+    Edge edge;
+    edge.u = vertex_id[boost::source(*eit, graph)];
+    edge.v = vertex_id[boost::target(*eit, graph)];
+    edge.active = component->Is_Active();
+    if (component->isTransportEdge()) {
+      edge.kind = Kind::Transport;
+      edge.flow = column_of(component->Get_Volumetricflow().get());
+      edge.known_flow = component->Get_Volumetricflow()->value();
+    } else if (auto pipe = std::dynamic_pointer_cast<Pipes>(component)) {
+      edge.kind = Kind::Pipe;
+      edge.diameter = pipe->Get_Diameter()->value();
+      edge.length = pipe->Get_Length()->value();
+      edge.relative_roughness = pipe->Get_Relative_roughness()->value();
+      edge.area = pipe->Get_CrossSection()->value();
+    } else if (typeid(*component) == typeid(FluidComponents)) {
+      edge.kind = Kind::Component;
+      edge.area = component->Get_CrossSection()->value();
+      edge.delta_pressure = component->Get_DeltaPressure()->value();
+    } else {
+      throw std::logic_error("Component type is not supported by the flat model.");
+    }
+    if (edge.kind != Kind::Transport)
+      m_description.bernoulli_rows.push_back(edge_id[component.get()]);
+    m_description.edges.push_back(edge);
+  }
+
+  // Mass rows in the order of System::Get_massflow_vec
+  for (auto vit = vs.first; vit != vs.second; ++vit) {
+    if (boost::in_degree(*vit, graph) == 0)
+      continue;
+    typename boost::graph_traits<Graph>::in_edge_iterator ei, ei_end;
+    if (boost::out_degree(*vit, graph) == 0) {
+      for (boost::tie(ei, ei_end) = boost::in_edges(*vit, graph); ei != ei_end; ++ei) {
+        if (!graph[*ei]->isTransportEdge())
+          continue;
+        MassRow row;
+        row.edges.emplace_back(edge_id[graph[*ei].get()], 1.);
+        vertex_t outlet = boost::source(*ei, graph);
+        row.outlet = vertex_id[outlet];
+        typename boost::graph_traits<Graph>::in_edge_iterator oi, oi_end;
+        for (boost::tie(oi, oi_end) = boost::in_edges(outlet, graph); oi != oi_end; ++oi)
+          row.area += graph[*oi]->Get_CrossSection()->value();
+        m_description.mass_rows.push_back(row);
+      }
+      continue;
+    }
+    MassRow row;
+    for (boost::tie(ei, ei_end) = boost::in_edges(*vit, graph); ei != ei_end; ++ei)
+      row.edges.emplace_back(edge_id[graph[*ei].get()], 1.);
+    typename boost::graph_traits<Graph>::out_edge_iterator eo, eo_end;
+    for (boost::tie(eo, eo_end) = boost::out_edges(*vit, graph); eo != eo_end; ++eo)
+      row.edges.emplace_back(edge_id[graph[*eo].get()], -1.);
+    m_description.mass_rows.push_back(row);
+  }
+}
+
+Eigen::Index FlatModel::n_vertices() const {
+  return static_cast<Eigen::Index>(m_description.vertices.size());
+}
+
+Eigen::Index FlatModel::n_unknowns() const {
+  return m_description.n_unknowns;
+}
+
+Eigen::Index FlatModel::n_residuals() const {
+  return static_cast<Eigen::Index>(m_description.bernoulli_rows.size() + m_description.mass_rows.size());
+}
+
+const Eigen::RowVectorXd &FlatModel::Get_Speeds() const {
+  return m_description.speeds;
+}
+
+const Eigen::RowVectorXd &FlatModel::Get_Static_pressures() const {
+  return m_description.static_pressures;
+}
+
+Eigen::RowVectorXd FlatModel::Get_Open() const {
+  Eigen::RowVectorXd open(m_description.edges.size());
+  for (size_t k = 0; k < m_description.edges.size(); ++k)
+    open(k) = m_description.edges[k].active ? 1. : 0.;
+  return open;
+}
+
+Eigen::Index FlatModel::Edge_index(size_t vertex_u, size_t vertex_v) const {
+  const auto u = static_cast<Eigen::Index>(m_description.Index(vertex_u));
+  const auto v = static_cast<Eigen::Index>(m_description.Index(vertex_v));
+  for (size_t k = 0; k < m_description.edges.size(); ++k)
+    if (m_description.edges[k].u == u && m_description.edges[k].v == v)
+      return static_cast<Eigen::Index>(k);
+  throw std::out_of_range("No edge between the vertices.");
+}
+
+void FlatModel::Check_Closable(Eigen::Index edge) const {
+  const Edge &closed = m_description.edges.at(static_cast<size_t>(edge));
+  if (closed.kind == Kind::Transport)
+    throw std::logic_error("A transport edge can not be closed.");
+  for (size_t k = 0; k < m_description.edges.size(); ++k)
+    if (static_cast<Eigen::Index>(k) != edge && m_description.edges[k].u == closed.u)
+      throw std::logic_error("A component whose first vertex branches can not be closed.");
+}
+
+size_t FlatModel::Vertex_index(size_t vertex) const {
+  return m_description.Index(vertex);
+}
+
+const std::vector<FlatModel::Vertex> &FlatModel::Get_Vertices() const {
+  return m_description.vertices;
+}
+
+const std::vector<FlatModel::Edge> &FlatModel::Get_Edges() const {
+  return m_description.edges;
+}
+
+const ModelDescription &FlatModel::Get_Description() const {
+  return m_description;
+}
+
+Eigen::SparseMatrix<double> FlatModel::Get_Pattern() const {
+  std::vector<Eigen::Triplet<double>> triplets;
+  Eigen::Index row = 0;
+  auto add = [&](Eigen::Index column) {
+    if (column >= 0)
+      triplets.emplace_back(row, column, 0.);
+  };
+  for (auto &&e : m_description.bernoulli_rows) {
+    const Edge &edge = m_description.edges[e];
+    for (auto &&i : {edge.u, edge.v}) {
+      add(m_description.vertices[i].speed);
+      add(m_description.vertices[i].pressure);
+    }
+    ++row;
+  }
+  for (auto &&mass : m_description.mass_rows) {
+    for (auto &&term : mass.edges) {
+      const Edge &edge = m_description.edges[term.first];
+      add(edge.kind == Kind::Transport ? edge.flow : m_description.vertices[edge.u].speed);
+    }
+    if (mass.outlet >= 0)
+      add(m_description.vertices[mass.outlet].speed);
+    ++row;
+  }
+  Eigen::SparseMatrix<double> pattern(n_residuals(), n_unknowns());
+  pattern.setFromTriplets(triplets.begin(), triplets.end());
+  return pattern;
+}
+
+void FlatModel::Residual(const Lanes &x, const Lanes &speed, const Lanes &pressure, const Lanes &open,
+                         Lanes &residual, Workspace &workspace, ThreadPool *pool) const {
+  const Eigen::Index lanes = x.rows();
+  workspace.speed = speed;
+  workspace.pressure = pressure;
+  workspace.bernoulli.resize(lanes, n_vertices());
+  workspace.massflow.resize(lanes, static_cast<Eigen::Index>(m_description.edges.size()));
+  residual.resize(lanes, n_residuals());
+  // Every stage writes disjoint columns, the chunking does not change the results
+  auto parallel_for = [pool](size_t n, const std::function<void(size_t, size_t)> &body) {
+    if (pool)
+      pool->Parallel_for(n, [&body](size_t begin, size_t end, size_t) { body(begin, end); }, s_grain);
+    else
+      body(0, n);
+  };
+
+  parallel_for(m_description.vertices.size(), [&](size_t begin, size_t end) {
+    for (size_t i = begin; i < end; ++i) {
+      const Vertex &vertex = m_description.vertices[i];
+      if (vertex.speed >= 0)
+        workspace.speed.col(i) = x.col(vertex.speed);
+      if (vertex.pressure >= 0)
+        workspace.pressure.col(i) = x.col(vertex.pressure);
+      workspace.bernoulli.col(i) = Liquid::Bernoulli(workspace.pressure.col(i), workspace.speed.col(i),
+                                                     vertex.density, vertex.potential_pressure);
+    }
+  });
+  parallel_for(m_description.edges.size(), [&](size_t begin, size_t end) {
+    for (size_t k = begin; k < end; ++k) {
+      const Edge &edge = m_description.edges[k];
+      const double density = m_description.vertices[edge.u].density;
+      if (edge.kind != Kind::Transport)
+        workspace.massflow.col(k) = (edge.area * density) * workspace.speed.col(edge.u);
+      else if (edge.flow >= 0)
+        workspace.massflow.col(k) = density * x.col(edge.flow);
+      else
+        workspace.massflow.col(k).setConstant(density * edge.known_flow);
+    }
+  });
+  parallel_for(m_description.bernoulli_rows.size(), [&](size_t begin, size_t end) {
+    for (size_t row = begin; row < end; ++row) {
+      const Eigen::Index e = m_description.bernoulli_rows[row];
+      const Edge &edge = m_description.edges[e];
+      // A closed edge has zero flow, its row is the mass flow, which reads a subset of the unknowns of this row
+      const bool all_closed = open.cols() == 0 ? !edge.active : (open.col(e) < 0.5).all();
+      const bool any_closed = open.cols() == 0 ? !edge.active : (open.col(e) < 0.5).any();
+      if (all_closed) {
+        residual.col(row) = workspace.massflow.col(e);
+        continue;
+      }
+      residual.col(row) = workspace.bernoulli.col(edge.u) - workspace.bernoulli.col(edge.v);
+      if (edge.kind == Kind::Pipe) {
+        const Vertex &vertex = m_description.vertices[edge.u];
+        // c f Q^2, with Q = A v
+        const double scale = Pipes::Loss_coefficient(edge.length, edge.diameter, vertex.density) * edge.area
+            * edge.area;
+        residual.col(row) -= scale * Pipes::Haaland(Pipes::Reynolds(workspace.speed.col(edge.u), edge.diameter,
+                                                                    vertex.density, vertex.dynamic_viscosity),
+                                                    edge.relative_roughness)
+            * workspace.speed.col(edge.u).square();
+      } else {
+        residual.col(row) -= edge.delta_pressure;
+      }
+      if (any_closed)
+        residual.col(row) = (open.col(e) < 0.5).select(workspace.massflow.col(e), residual.col(row));
+    }
+  });
+  const size_t offset = m_description.bernoulli_rows.size();
+  parallel_for(m_description.mass_rows.size(), [&](size_t begin, size_t end) {
+    for (size_t k = begin; k < end; ++k) {
+      const MassRow &mass = m_description.mass_rows[k];
+      auto row = residual.col(offset + k);
+      row.setZero();
+      for (auto &&term : mass.edges)
+        row += term.second * workspace.massflow.col(term.first);
+      if (mass.outlet >= 0)
+        row -= (mass.area * m_description.vertices[mass.outlet].density) * workspace.speed.col(mass.outlet);
+    }
+  });
+}
+
+double FlatModel::Row(Eigen::Index row, const Eigen::VectorXd &x, const Eigen::RowVectorXd &speed,
+                      const Eigen::RowVectorXd &pressure, const Eigen::RowVectorXd &open) const {
+  typedef Eigen::Array<double, 1, 1> Single;
+  auto speed_of = [&](Eigen::Index i) {
+    const Eigen::Index column = m_description.vertices[i].speed;
+    return column >= 0 ? x(column) : speed(i);
+  };
+  auto bernoulli_of = [&](Eigen::Index i) {
+    const Vertex &vertex = m_description.vertices[i];
+    const double p = vertex.pressure >= 0 ? x(vertex.pressure) : pressure(i);
+    return Liquid::Bernoulli(Single::Constant(p), Single::Constant(speed_of(i)), vertex.density,
+                             vertex.potential_pressure)(0);
+  };
+  const auto n_bernoulli = static_cast<Eigen::Index>(m_description.bernoulli_rows.size());
+  if (row < n_bernoulli) {
+    const Eigen::Index e = m_description.bernoulli_rows[row];
+    const Edge &edge = m_description.edges[e];
+    if (open.size() == 0 ? !edge.active : open(e) < 0.5)
+      return (edge.area * m_description.vertices[edge.u].density) * speed_of(edge.u);
+    double value = bernoulli_of(edge.u) - bernoulli_of(edge.v);
+    if (edge.kind == Kind::Pipe) {
+      const Vertex &vertex = m_description.vertices[edge.u];
+      const double v = speed_of(edge.u);
+      // c f Q^2, with Q = A v
+      const double scale = Pipes::Loss_coefficient(edge.length, edge.diameter, vertex.density) * edge.area * edge.area;
+      value -= scale * Pipes::Haaland(Pipes::Reynolds(Single::Constant(v), edge.diameter, vertex.density,
+                                                      vertex.dynamic_viscosity),
+                                      edge.relative_roughness)(0) * (v * v);
+    } else {
+      value -= edge.delta_pressure;
+    }
+    return value;
+  }
+  const MassRow &mass = m_description.mass_rows.at(static_cast<size_t>(row - n_bernoulli));
+  double value = 0.;
+  for (auto &&term : mass.edges) {
+    const Edge &edge = m_description.edges[term.first];
+    const double density = m_description.vertices[edge.u].density;
+    if (edge.kind != Kind::Transport)
+      value += term.second * ((edge.area * density) * speed_of(edge.u));
+    else
+      value += term.second * (density * (edge.flow >= 0 ? x(edge.flow) : edge.known_flow));
+  }
+  if (mass.outlet >= 0)
+    value -= (mass.area * m_description.vertices[mass.outlet].density) * speed_of(mass.outlet);
+  return value;
+}
+}
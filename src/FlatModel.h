@@ -0,0 +1,116 @@
+// MIT License
+//
+// Copyright (c) 2019 Jelle Spijker
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+
+#ifndef LIBFLUIDS_FLATMODEL_H
+#define LIBFLUIDS_FLATMODEL_H
+
+#include <vector>
+
+#include <Eigen/Core>
+#include <Eigen/SparseCore>
+
+#include "../include/fluids/ModelDescription.h"
+#include "../include/fluids/System.h"
+#include "../include/fluids/ThreadPool.h"
+
+namespace Fluids {
+/// Index based copy of the numerical content of an initialized system. The residual is evaluated on arrays instead
+/// of the shared quantities of the graph, for any number of scenarios at once: every lane array holds one scenario
+/// per row and one quantity per column, so the values of a quantity over all scenarios are contiguous and the pipe
+/// and liquid equations are evaluated with packed arithmetic. The residual rows are ordered as System::Get_Return_vec
+/// and the unknowns as System::Get_Unknown_vector.
+class FlatModel {
+public:
+  typedef Eigen::ArrayXXd Lanes; //! Scenarios x quantities
+
+  typedef ModelDescription::Kind Kind;
+  typedef ModelDescription::Edge Edge;
+  typedef ModelDescription::Vertex Vertex;
+  typedef ModelDescription::MassRow MassRow;
+
+  /// Scratch arrays of an evaluation, one per concurrent evaluation
+  struct Workspace {
+    Lanes speed;
+    Lanes pressure;
+    Lanes bernoulli;
+    Lanes massflow;
+  };
+
+  explicit FlatModel(const System &system);
+
+  Eigen::Index n_vertices() const;
+  Eigen::Index n_unknowns() const;
+  Eigen::Index n_residuals() const;
+
+  /// Speeds of the vertices in the system when the model was built, the known values of every scenario
+  const Eigen::RowVectorXd &Get_Speeds() const;
+  /// Static pressures of the vertices in the system when the model was built
+  const Eigen::RowVectorXd &Get_Static_pressures() const;
+  /// Open edges of the system when the model was built, 1 when open and 0 when closed
+  Eigen::RowVectorXd Get_Open() const;
+  /// Index of the edge from vertex id vertex_u to vertex id vertex_v, std::out_of_range when there is none
+  Eigen::Index Edge_index(size_t vertex_u, size_t vertex_v) const;
+  /// Throws std::logic_error when the edge can not be closed: a transport edge, or a component whose first vertex
+  /// has other outgoing edges. The flow of a component is the speed of its first vertex times its cross section,
+  /// so closing one branch would stop every branch leaving that vertex.
+  void Check_Closable(Eigen::Index edge) const;
+  /// Index in Get_Vertices of a vertex id of the system
+  size_t Vertex_index(size_t vertex) const;
+
+  const std::vector<Vertex> &Get_Vertices() const;
+  const std::vector<Edge> &Get_Edges() const;
+  const ModelDescription &Get_Description() const;
+
+  /// Exact sparsity of the Jacobian: a row depends on the unknowns it reads, see Row. Closing an edge does not
+  /// change it, the row of a closed edge reads a subset of the unknowns of its Bernoulli row.
+  Eigen::SparseMatrix<double> Get_Pattern() const;
+
+  /// Residual of every scenario
+  /// \param x unknowns, one scenario per row
+  /// \param speed known speeds of the vertices, one scenario per row (unknown columns are ignored)
+  /// \param pressure known static pressures of the vertices, one scenario per row (unknown columns are ignored)
+  /// \param open open edges, 1 or 0, one scenario per row. The Bernoulli row of a closed edge is replaced by its
+  /// mass flow. Without columns the edges open in the system are used for every scenario.
+  /// \param residual on return the residuals, one scenario per row
+  /// \param workspace scratch arrays
+  /// \param pool threads over which the vertices, edges and rows are divided, serial when null
+  void Residual(const Lanes &x, const Lanes &speed, const Lanes &pressure, const Lanes &open, Lanes &residual,
+                Workspace &workspace, ThreadPool *pool = nullptr) const;
+
+  /// One residual row of a single scenario, evaluated from the unknowns it depends on only
+  /// \param row residual row
+  /// \param x unknowns
+  /// \param speed known speeds of the vertices (unknown entries are ignored)
+  /// \param pressure known static pressures of the vertices (unknown entries are ignored)
+  /// \param open open edges, 1 or 0, the edges open in the system when empty
+  double Row(Eigen::Index row, const Eigen::VectorXd &x, const Eigen::RowVectorXd &speed,
+             const Eigen::RowVectorXd &pressure, const Eigen::RowVectorXd &open = Eigen::RowVectorXd()) const;
+
+private:
+  static constexpr size_t s_grain = 512; //! Smallest number of vertices, edges or rows of a parallel chunk
+
+  ModelDescription m_description;
+};
+}
+
+#endif //LIBFLUIDS_FLATMODEL_H
@@ -24,6 +24,7 @@
 #include <fluids/FluidComponents.h>
 
 #include "../include/fluids/FluidComponents.h"
+#include "MemorySize.h"
 
 namespace Fluids {
 FluidComponents::FluidComponents() :
@@ -48,6 +49,18 @@ FluidComponents::FluidComponents(const std::shared_ptr<Liquid> &liquid_u, const
 
 }
 
+FluidComponents::FluidComponents(const std::shared_ptr<Liquid> &liquid_u, const std::shared_ptr<Liquid> &liquid_v,
+                                 const Arena &arena) :
+    m_crosssection(Make_shared<quantity<si::area>>(arena, 0. * si::square_meter)),
+    m_massflow(Make_shared<quantity<si::mass_flow>>(arena, 0. * si::kilogram_per_second)),
+    m_volumetricflow(Make_shared<quantity<si::volumetric_flow>>(arena, 0. * si::cubic_meter_per_second)),
+    m_deltapressure(Make_shared<quantity<si::pressure>>(arena, 0. * si::pascals)),
+    m_bernoulli_balance(Make_shared<quantity<si::pressure>>(arena, 0. * si::pascals)),
+    m_liquid_u(liquid_u),
+    m_liquid_v(liquid_v) {
+
+}
+
 FluidComponents::FluidComponents(const FluidComponents &other) :
     m_crosssection(new quantity<si::area>(*other.m_crosssection)),
     m_massflow(new quantity<si::mass_flow>(*other.m_massflow)),
@@ -55,7 +68,8 @@ FluidComponents::FluidComponents(const FluidComponents &other) :
     m_deltapressure(new quantity<si::pressure>(*other.m_deltapressure)),
     m_bernoulli_balance(new quantity<si::pressure>(*other.m_bernoulli_balance)),
     m_liquid_u(new Liquid(*other.m_liquid_u)),
-    m_liquid_v(new Liquid(*other.m_liquid_v)) {
+    m_liquid_v(new Liquid(*other.m_liquid_v)),
+    m_active(other.m_active) {
 
 }
 
@@ -69,6 +83,7 @@ FluidComponents &FluidComponents::operator=(const Fluids::FluidComponents &other
   m_bernoulli_balance = std::make_shared<quantity<si::pressure>>(*other.m_bernoulli_balance);
   m_liquid_u = std::make_shared<Liquid>(*other.m_liquid_u);
   m_liquid_v = std::make_shared<Liquid>(*other.m_liquid_v);
+  m_active = other.m_active;
   return *this;
 }
 
@@ -117,4 +132,22 @@ std::shared_ptr<quantity<si::pressure>> FluidComponents::Get_Bernoulli_balance()
 bool FluidComponents::isTransportEdge() const {
   return false;
 }
+
+size_t FluidComponents::Get_Heap_bytes() const {
+  return MemorySize::Shared_inplace(sizeof(FluidComponents)) + Quantity_bytes();
+}
+
+size_t FluidComponents::Quantity_bytes() const {
+  using MemorySize::Shared_new;
+  return Shared_new(sizeof(*m_crosssection)) + Shared_new(sizeof(*m_massflow)) + Shared_new(sizeof(*m_volumetricflow))
+      + Shared_new(sizeof(*m_deltapressure)) + Shared_new(sizeof(*m_bernoulli_balance));
+}
+
+bool FluidComponents::Is_Active() const {
+  return m_active;
+}
+
+void FluidComponents::Set_Active(bool active) {
+  m_active = active;
+}
 }
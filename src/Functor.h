@@ -30,6 +30,7 @@
 #include <unsupported/Eigen/NumericalDiff>
 
 #include "../include/fluids/System.h"
+#include "../include/fluids/Trace.h"
 
 namespace Fluids {
 /// Functor used in the optimization
@@ -59,7 +60,9 @@ struct Functor {
 struct System_Functor_Base : Functor<double> {
 public:
   System_Functor_Base() : m_system(std::make_shared<System>()) {};
-  explicit System_Functor_Base(const std::shared_ptr<System> &m_system) : m_system(m_system) {}
+  explicit System_Functor_Base(const std::shared_ptr<System> &m_system)
+      : Functor<double>(static_cast<int>(m_system->n_unknowns()), static_cast<int>(m_system->n_residuals())),
+        m_system(m_system) {}
 
   const std::shared_ptr<System> &Get_System() const {
     return m_system;
@@ -69,6 +72,7 @@ public:
   }
 
   int operator()(const Eigen::VectorXd &x, Eigen::VectorXd &dvec) const {
+    FLUIDS_TRACE_SCOPE("Residual");
 
     // Set unknown values from x-vector
     auto speed = m_system->Get_Unknown_speeds();
@@ -0,0 +1,291 @@
+// MIT License
+//
+// Copyright (c) 2019 Jelle Spijker
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+
+#include <cmath>
+#include <limits>
+#include <numeric>
+#include <stdexcept>
+#include <vector>
+
+#include <Eigen/SparseCore>
+#include <Eigen/SparseLU>
+
+#include <fluids/IncrementalSolver.h>
+#include "FlatModel.h"
+#include "SparseJacobian.h"
+
+namespace Fluids {
+
+struct IncrementalSolver::Data {
+  bool built{false};
+  size_t topology_version{0};
+  Eigen::SparseMatrix<double> pattern;
+  std::vector<std::vector<Eigen::Index>> colors;
+  std::vector<size_t> column_block; //! Block of every column
+  std::vector<size_t> row_block;    //! Block of every row
+  size_t n_blocks{0};
+  Eigen::VectorXd x;        //! Solution of the previous solve
+  Eigen::VectorXd residual; //! Residual of the previous solve, all rows
+  size_t region_size{0};
+  Eigen::SparseLU<Eigen::SparseMatrix<double>> lu;
+  std::vector<Eigen::Index> analysed; //! Columns of the region whose pattern the factorization analysed
+  bool has_analysis{false};
+
+  void Build(const std::shared_ptr<System> &system, const FlatModel &flat) {
+    pattern = flat.Get_Pattern();
+    colors = SparseJacobian::Colors(pattern);
+    topology_version = system->Get_Topology_version();
+
+    // Connected components of the bipartite graph of the columns and rows
+    const auto n = static_cast<size_t>(pattern.cols());
+    const auto m = static_cast<size_t>(pattern.rows());
+    std::vector<size_t> set(n + m);
+    std::iota(set.begin(), set.end(), 0);
+    auto find = [&set](size_t i) {
+      while (set[i] != i)
+        i = set[i] = set[set[i]];
+      return i;
+    };
+    for (Eigen::Index j = 0; j < pattern.outerSize(); ++j)
+      for (Eigen::SparseMatrix<double>::InnerIterator it(pattern, j); it; ++it)
+        set[find(static_cast<size_t>(j))] = find(n + static_cast<size_t>(it.row()));
+    std::vector<size_t> block(n + m, n + m);
+    n_blocks = 0;
+    column_block.resize(n);
+    row_block.resize(m);
+    for (size_t i = 0; i < n + m; ++i) {
+      size_t root = find(i);
+      if (block[root] == n + m)
+        block[root] = n_blocks++;
+      (i < n ? column_block[i] : row_block[i - n]) = block[root];
+    }
+    x = system->Get_Initial_vector();
+    residual.resize(0);
+    analysed.clear();
+    has_analysis = false;
+    built = true;
+  }
+};
+
+namespace {
+void Full_residual(const FlatModel &flat, const Eigen::VectorXd &x, Eigen::VectorXd &residual) {
+  FlatModel::Workspace workspace;
+  FlatModel::Lanes lanes;
+  flat.Residual(x.transpose().array(), flat.Get_Speeds().array(), flat.Get_Static_pressures().array(),
+                FlatModel::Lanes(), lanes, workspace);
+  residual = lanes.row(0).transpose().matrix();
+}
+}
+
+IncrementalSolver::IncrementalSolver(const std::shared_ptr<System> &system)
+    : m_system(system), m_data(std::make_shared<Data>()) {
+
+}
+
+SolverStatistics IncrementalSolver::Solve() {
+  m_system->Initialize();
+  if (m_system->n_unknowns() != m_system->n_residuals())
+    throw std::runtime_error("An incremental solve requires as many residuals as unknowns.");
+  Data &data = *m_data;
+  SolverStatistics statistics;
+  const FlatModel flat(*m_system);
+  const bool rebuild = !data.built || data.topology_version != m_system->Get_Topology_version();
+  if (rebuild) {
+    data.Build(m_system, flat);
+    ++statistics.symbolic_analyses;
+  }
+  const Eigen::RowVectorXd &speed = flat.Get_Speeds();
+  const Eigen::RowVectorXd &pressure = flat.Get_Static_pressures();
+
+  // Blocks with a row that changed since the previous solve
+  Eigen::VectorXd residual;
+  Full_residual(flat, data.x, residual);
+  ++statistics.residual_evaluations;
+  std::vector<bool> affected(data.n_blocks, rebuild);
+  for (Eigen::Index i = 0; i < residual.size(); ++i)
+    if (rebuild || residual(i) != data.residual(i) || std::abs(residual(i)) > m_tolerance)
+      affected[data.row_block[i]] = true;
+  std::vector<Eigen::Index> columns, rows;
+  std::vector<Eigen::Index> local(data.row_block.size(), -1); //! Position of a row in the region
+  for (size_t j = 0; j < data.column_block.size(); ++j)
+    if (affected[data.column_block[j]])
+      columns.push_back(static_cast<Eigen::Index>(j));
+  for (size_t i = 0; i < data.row_block.size(); ++i) {
+    if (affected[data.row_block[i]]) {
+      local[i] = static_cast<Eigen::Index>(rows.size());
+      rows.push_back(static_cast<Eigen::Index>(i));
+    }
+  }
+  if (rows.size() != columns.size())
+    throw std::runtime_error("The affected blocks do not have as many residuals as unknowns.");
+  data.region_size = columns.size();
+  std::vector<Eigen::Index> column_local(data.column_block.size(), -1);
+  for (size_t k = 0; k < columns.size(); ++k)
+    column_local[columns[k]] = static_cast<Eigen::Index>(k);
+
+  // Newton iteration on the rows and columns of the region
+  Eigen::VectorXd &x = data.x;
+  const auto n = static_cast<Eigen::Index>(rows.size());
+  Eigen::VectorXd region_residual(n), trial(n);
+  for (Eigen::Index k = 0; k < n; ++k)
+    region_residual(k) = residual(rows[k]);
+  double norm = region_residual.norm();
+  const double epsilon = std::sqrt(std::numeric_limits<double>::epsilon());
+  // The Jacobian of a region always has the pattern of its columns, so the symbolic analysis is kept while the region
+  // is the same, across the iterations and the solves of one topology
+  auto &lu = data.lu;
+  if (!data.has_analysis || data.analysed != columns) {
+    data.has_analysis = false;
+    data.analysed = columns;
+  }
+  std::vector<Eigen::Triplet<double>> triplets;
+  std::vector<bool> evaluated(data.row_block.size(), false);
+  std::vector<double> perturbed(data.row_block.size(), 0.);
+  std::vector<Eigen::Index> touched;
+  Eigen::VectorXd saved(n);
+  // The columns are perturbed and restored in place, so that an iteration costs the size of the region
+  while (norm > m_tolerance && statistics.iterations < m_max_iterations) {
+    ++statistics.iterations;
+    triplets.clear();
+    for (auto &&color : data.colors) {
+      bool any = false;
+      for (auto &&j : color) {
+        if (column_local[j] < 0)
+          continue;
+        saved(column_local[j]) = x(j);
+        x(j) += epsilon * std::max(std::abs(x(j)), 1.);
+        any = true;
+      }
+      if (!any)
+        continue;
+      ++statistics.residual_evaluations;
+      touched.clear();
+      for (auto &&j : color) {
+        if (column_local[j] < 0)
+          continue;
+        for (Eigen::SparseMatrix<double>::InnerIterator it(data.pattern, j); it; ++it) {
+          const auto i = static_cast<size_t>(it.row());
+          if (!evaluated[i]) {
+            perturbed[i] = flat.Row(it.row(), x, speed, pressure);
+            evaluated[i] = true;
+            touched.push_back(it.row());
+          }
+        }
+      }
+      for (auto &&j : color) {
+        if (column_local[j] < 0)
+          continue;
+        const double h = x(j) - saved(column_local[j]);
+        for (Eigen::SparseMatrix<double>::InnerIterator it(data.pattern, j); it; ++it) {
+          const auto i = static_cast<size_t>(it.row());
+          triplets.emplace_back(local[i], column_local[j], (perturbed[i] - region_residual(local[i])) / h);
+        }
+        x(j) = saved(column_local[j]);
+      }
+      for (auto &&i : touched)
+        evaluated[i] = false;
+    }
+    ++statistics.jacobian_evaluations;
+    Eigen::SparseMatrix<double> jacobian(n, n);
+    jacobian.setFromTriplets(triplets.begin(), triplets.end());
+    if (!data.has_analysis) {
+      lu.analyzePattern(jacobian);
+      ++statistics.symbolic_analyses;
+      data.has_analysis = true;
+    }
+    lu.factorize(jacobian);
+    ++statistics.factorizations;
+    if (lu.info() != Eigen::Success)
+      break;
+    Eigen::VectorXd step = -lu.solve(region_residual);
+
+    // Backtracking until the residual of the region decreases
+    for (Eigen::Index c = 0; c < n; ++c)
+      saved(c) = x(columns[c]);
+    double lambda = 1.;
+    bool decreased = false;
+    for (size_t k = 0; k < 30 && !decreased; ++k, lambda *= 0.5) {
+      for (Eigen::Index c = 0; c < n; ++c)
+        x(columns[c]) = saved(c) + lambda * step(c);
+      for (Eigen::Index r = 0; r < n; ++r)
+        trial(r) = flat.Row(rows[r], x, speed, pressure);
+      ++statistics.residual_evaluations;
+      if (trial.norm() < norm) {
+        region_residual.swap(trial);
+        norm = region_residual.norm();
+        decreased = true;
+      }
+    }
+    if (!decreased) {
+      for (Eigen::Index c = 0; c < n; ++c)
+        x(columns[c]) = saved(c);
+      break;
+    }
+  }
+
+  // Store the region, the residual of all rows is kept to detect the next edit
+  const size_t n_speeds = m_system->Get_Unknown_speeds().size();
+  const size_t n_pressures = m_system->Get_Unknown_static_pressures().size();
+  for (auto &&j : columns) {
+    const auto c = static_cast<size_t>(j);
+    if (c < n_speeds)
+      *m_system->Get_Unknown_speeds()[c] = x(j) * si::meters_per_second;
+    else if (c < n_speeds + n_pressures)
+      *m_system->Get_Unknown_static_pressures()[c - n_speeds] = x(j) * si::pascals;
+    else
+      *m_system->Get_Unknown_volumetric_flow()[c - n_speeds - n_pressures] = x(j) * si::cubic_meters_per_second;
+  }
+  if (!columns.empty()) {
+    Full_residual(flat, x, residual);
+    ++statistics.residual_evaluations;
+  }
+  data.residual = residual;
+  statistics.residual_norm = residual.norm();
+  statistics.converged = norm <= m_tolerance;
+  return statistics;
+}
+
+size_t IncrementalSolver::Get_Region_size() const {
+  return m_data->region_size;
+}
+
+size_t IncrementalSolver::n_blocks() const {
+  return m_data->n_blocks;
+}
+
+double IncrementalSolver::Get_Tolerance() const {
+  return m_tolerance;
+}
+
+void IncrementalSolver::Set_Tolerance(double tolerance) {
+  m_tolerance = tolerance;
+}
+
+size_t IncrementalSolver::Get_Max_iterations() const {
+  return m_max_iterations;
+}
+
+void IncrementalSolver::Set_Max_iterations(size_t max_iterations) {
+  m_max_iterations = max_iterations;
+}
+}
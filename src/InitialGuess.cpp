@@ -0,0 +1,336 @@
+// MIT License
+//
+// Copyright (c) 2019 Jelle Spijker
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+
+#include <algorithm>
+#include <cmath>
+#include <functional>
+#include <unordered_map>
+#include <unordered_set>
+
+#include <Eigen/Sparse>
+#include <Eigen/SparseCholesky>
+
+#include <fluids/Pipes.h>
+
+#include "InitialGuess.h"
+
+namespace Fluids {
+
+InitialGuess::InitialGuess(const System &system) : m_system(system) {
+
+}
+
+size_t InitialGuess::Get_Max_iterations() const {
+  return m_max_iterations;
+}
+
+void InitialGuess::Set_Max_iterations(size_t max_iterations) {
+  InitialGuess::m_max_iterations = max_iterations;
+}
+
+void InitialGuess::Build_branches() {
+  const Graph &graph = m_system.Get_Graph();
+  m_vertices.clear();
+  m_branches.clear();
+
+  std::unordered_map<vertex_t, size_t> index;
+  auto vs = boost::vertices(graph);
+  for (auto vit = vs.first; vit != vs.second; ++vit) {
+    index[*vit] = m_vertices.size();
+    m_vertices.push_back(*vit);
+  }
+
+  double min_resistance = 0.;
+  auto es = boost::edges(graph);
+  for (auto eit = es.first; eit != es.second; ++eit) {
+    auto &component = graph[*eit];
+    if (component->isTransportEdge())
+      continue;
+    Branch branch{};
+    branch.u = index[boost::source(*eit, graph)];
+    branch.v = index[boost::target(*eit, graph)];
+    branch.area = component->Get_CrossSection()->value();
+    branch.density = component->Get_Liquid(Vertex::u)->Get_Density()->value();
+    branch.dynamic_viscosity = component->Get_Liquid(Vertex::u)->Get_Dynamic_viscosity()->value();
+    auto pipe = std::dynamic_pointer_cast<Pipes>(component);
+    if (pipe && pipe->Get_Diameter()->value() > 0.) {
+      double diameter = pipe->Get_Diameter()->value();
+      double length = pipe->Get_Length()->value();
+      branch.diameter = diameter;
+      branch.relative_roughness = pipe->Get_Relative_roughness()->value();
+      // Hagen-Poiseuille: dp = 128 mu L Q / (pi D^4)
+      branch.laminar_resistance = 128. * branch.dynamic_viscosity * length / (M_PI * std::pow(diameter, 4));
+      // Same coefficient as Pipes::Get_DeltaPressure: dp = c f Q^2
+      branch.turbulent_coefficient = Pipes::Loss_coefficient(length, diameter, branch.density);
+      if (branch.laminar_resistance > 0. && (min_resistance == 0. || branch.laminar_resistance < min_resistance))
+        min_resistance = branch.laminar_resistance;
+    }
+    m_branches.push_back(branch);
+  }
+
+  // Components without a friction model are treated as short, almost loss free, connections
+  double connector_resistance = min_resistance > 0. ? 1.e-3 * min_resistance : 1.;
+  for (auto &&branch : m_branches) {
+    if (branch.laminar_resistance <= 0.)
+      branch.laminar_resistance = connector_resistance;
+  }
+}
+
+double InitialGuess::Turbulent_resistance(const InitialGuess::Branch &branch, double flow) const {
+  if (branch.turbulent_coefficient <= 0. || branch.area <= 0.)
+    return 0.;
+  double reynolds = std::abs(flow) / branch.area * branch.diameter * branch.density / branch.dynamic_viscosity;
+  if (reynolds < 1.)
+    return 0.;
+  double f = Pipes::Haaland(reynolds, branch.relative_roughness);
+  return branch.turbulent_coefficient * f * std::abs(flow);
+}
+
+Eigen::VectorXd InitialGuess::Compute() {
+  Build_branches();
+  const Graph &graph = m_system.Get_Graph();
+  const size_t n = m_vertices.size();
+  const double g = si::constants::g.value().value();
+
+  std::unordered_set<const void *> known_pressures;
+  for (auto &&p : m_system.Get_Known_static_pressures())
+    known_pressures.insert(p.get());
+  std::unordered_set<const void *> known_speeds;
+  for (auto &&s : m_system.Get_Known_speeds())
+    known_speeds.insert(s.get());
+
+  // Boundary conditions of the linear network, pressures are piezometric (p + rho g z)
+  std::vector<bool> dirichlet(n, false);
+  std::vector<bool> fixed_speed(n, false);
+  Eigen::VectorXd elevation_pressure(n);
+  Eigen::VectorXd piezometric = Eigen::VectorXd::Zero(n);
+  Eigen::VectorXd area_out = Eigen::VectorXd::Zero(n);
+  Eigen::VectorXd area_in = Eigen::VectorXd::Zero(n);
+  for (size_t i = 0; i < n; ++i) {
+    auto &liquid = graph[m_vertices[i]];
+    elevation_pressure(i) = liquid->Get_Density()->value() * g * liquid->Get_Height()->value();
+    dirichlet[i] = known_pressures.count(liquid->Get_Static_pressure().get()) > 0;
+    fixed_speed[i] = known_speeds.count(liquid->Get_Speed().get()) > 0;
+    piezometric(i) = liquid->Get_Static_pressure()->value() + elevation_pressure(i);
+  }
+  for (auto &&branch : m_branches) {
+    area_out(branch.u) += branch.area;
+    area_in(branch.v) += branch.area;
+  }
+
+  // Known speeds at inlets and outlets inject or withdraw a known flow
+  Eigen::VectorXd injection = Eigen::VectorXd::Zero(n);
+  for (size_t i = 0; i < n; ++i) {
+    if (!fixed_speed[i])
+      continue;
+    double speed = graph[m_vertices[i]]->Get_Speed()->value();
+    if (area_in(i) == 0. && area_out(i) > 0.)
+      injection(i) += speed * area_out(i);
+    else if (area_out(i) == 0. && area_in(i) > 0.)
+      injection(i) -= speed * area_in(i);
+  }
+  // The imbalance leaves the network through the free outlets (or enters through the free inlets)
+  double imbalance = injection.sum();
+  if (imbalance != 0.) {
+    std::vector<size_t> outlets, inlets;
+    for (size_t i = 0; i < n; ++i) {
+      if (dirichlet[i] || fixed_speed[i])
+        continue;
+      if (area_out(i) == 0. && area_in(i) > 0.)
+        outlets.push_back(i);
+      else if (area_in(i) == 0. && area_out(i) > 0.)
+        inlets.push_back(i);
+    }
+    auto &free = outlets.empty() ? inlets : outlets;
+    for (auto &&i : free)
+      injection(i) -= imbalance / free.size();
+  }
+
+  double reference = 0.;
+  size_t n_dirichlet = 0;
+  for (size_t i = 0; i < n; ++i) {
+    if (dirichlet[i]) {
+      reference += piezometric(i);
+      ++n_dirichlet;
+    }
+  }
+  reference = n_dirichlet > 0 ? reference / n_dirichlet : piezometric.mean();
+
+  std::vector<long> free_index(n, -1);
+  long n_free = 0;
+  for (size_t i = 0; i < n; ++i) {
+    if (!dirichlet[i])
+      free_index[i] = n_free++;
+  }
+
+  // Sub networks without a known pressure are floating, their level is set by the reference pressure
+  std::vector<size_t> parent(n);
+  for (size_t i = 0; i < n; ++i)
+    parent[i] = i;
+  std::function<size_t(size_t)> root = [&](size_t i) {
+    return parent[i] == i ? i : parent[i] = root(parent[i]);
+  };
+  for (auto &&branch : m_branches)
+    parent[root(branch.u)] = root(branch.v);
+  std::vector<bool> anchored(n, false);
+  for (size_t i = 0; i < n; ++i) {
+    if (dirichlet[i])
+      anchored[root(i)] = true;
+  }
+  std::vector<bool> floating(n_free, false);
+  for (size_t i = 0; i < n; ++i) {
+    if (free_index[i] >= 0)
+      floating[free_index[i]] = !anchored[root(i)];
+  }
+
+  std::vector<double> resistance(m_branches.size());
+  for (size_t k = 0; k < m_branches.size(); ++k)
+    resistance[k] = m_branches[k].laminar_resistance;
+
+  Eigen::VectorXd flow = Eigen::VectorXd::Zero(m_branches.size());
+  const size_t max_iterations = std::max<size_t>(m_max_iterations, 1);
+  for (size_t iteration = 0; iteration < max_iterations && n_free > 0; ++iteration) {
+    // Assemble the reduced conductance matrix of the free vertices
+    std::vector<Eigen::Triplet<double>> triplets;
+    Eigen::VectorXd rhs(n_free);
+    for (size_t i = 0; i < n; ++i) {
+      if (free_index[i] >= 0)
+        rhs(free_index[i]) = injection(i);
+    }
+    Eigen::VectorXd diagonal = Eigen::VectorXd::Zero(n_free);
+    for (size_t k = 0; k < m_branches.size(); ++k) {
+      const auto &branch = m_branches[k];
+      double conductance = 1. / resistance[k];
+      long fu = free_index[branch.u];
+      long fv = free_index[branch.v];
+      if (fu >= 0) {
+        diagonal(fu) += conductance;
+        if (fv >= 0)
+          triplets.emplace_back(fu, fv, -conductance);
+        else
+          rhs(fu) += conductance * piezometric(branch.v);
+      }
+      if (fv >= 0) {
+        diagonal(fv) += conductance;
+        if (fu >= 0)
+          triplets.emplace_back(fv, fu, -conductance);
+        else
+          rhs(fv) += conductance * piezometric(branch.u);
+      }
+    }
+    for (long i = 0; i < n_free; ++i) {
+      if (floating[i]) { // A weak pull towards the reference pressure keeps floating sub networks solvable
+        double regularization = 1.e-10 * std::max(diagonal(i), 1.e-10);
+        diagonal(i) += regularization;
+        rhs(i) += regularization * reference;
+      }
+      triplets.emplace_back(i, i, diagonal(i));
+    }
+    Eigen::SparseMatrix<double> conductance_matrix(n_free, n_free);
+    conductance_matrix.setFromTriplets(triplets.begin(), triplets.end());
+    Eigen::SimplicialLDLT<Eigen::SparseMatrix<double>> ldlt(conductance_matrix);
+    if (ldlt.info() != Eigen::Success)
+      break;
+    Eigen::VectorXd solution = ldlt.solve(rhs);
+
+    double change = 0.;
+    for (size_t i = 0; i < n; ++i) {
+      if (free_index[i] >= 0) {
+        change = std::max(change, std::abs(solution(free_index[i]) - piezometric(i)));
+        piezometric(i) = solution(free_index[i]);
+      }
+    }
+
+    bool converged = iteration > 0 && change <= 1.e-8 * (1. + piezometric.cwiseAbs().maxCoeff());
+    if (converged || iteration + 1 == max_iterations)
+      break;
+    // Damped Picard update of the linearized resistances
+    for (size_t k = 0; k < m_branches.size(); ++k) {
+      const auto &branch = m_branches[k];
+      double current = (piezometric(branch.u) - piezometric(branch.v)) / resistance[k];
+      double linearized = std::max(branch.laminar_resistance, Turbulent_resistance(branch, current));
+      resistance[k] = std::sqrt(resistance[k] * linearized);
+    }
+  }
+  // Flows consistent with the resistances of the last linear solve
+  for (size_t k = 0; k < m_branches.size(); ++k) {
+    const auto &branch = m_branches[k];
+    flow(k) = (piezometric(branch.u) - piezometric(branch.v)) / resistance[k];
+  }
+
+  // Derive the vertex states from the branch flows, the flow of a component is its area times the speed at u
+  Eigen::VectorXd flow_out = Eigen::VectorXd::Zero(n);
+  Eigen::VectorXd flow_in = Eigen::VectorXd::Zero(n);
+  for (size_t k = 0; k < m_branches.size(); ++k) {
+    flow_out(m_branches[k].u) += flow(k);
+    flow_in(m_branches[k].v) += flow(k);
+  }
+  Eigen::VectorXd speed(n);
+  for (size_t i = 0; i < n; ++i) {
+    if (area_out(i) > 0.)
+      speed(i) = flow_out(i) / area_out(i);
+    else if (area_in(i) > 0.)
+      speed(i) = flow_in(i) / area_in(i);
+    else
+      speed(i) = graph[m_vertices[i]]->Get_Speed()->value();
+  }
+
+  std::unordered_map<const void *, double> values;
+  for (size_t i = 0; i < n; ++i) {
+    auto &liquid = graph[m_vertices[i]];
+    values[liquid->Get_Speed().get()] = speed(i);
+    values[liquid->Get_Static_pressure().get()] = piezometric(i) - elevation_pressure(i);
+  }
+  std::unordered_map<vertex_t, size_t> index;
+  for (size_t i = 0; i < n; ++i)
+    index[m_vertices[i]] = i;
+  auto es = boost::edges(graph);
+  for (auto eit = es.first; eit != es.second; ++eit) {
+    auto &component = graph[*eit];
+    if (!component->isTransportEdge())
+      continue;
+    size_t s = index[boost::source(*eit, graph)];
+    size_t t = index[boost::target(*eit, graph)];
+    double transported;
+    if (area_out(t) + area_in(t) > 0.) // Inlet, feeds the components leaving t
+      transported = area_out(t) * speed(t);
+    else // Outlet, drains the components entering s
+      transported = area_in(s) * speed(s);
+    values[component->Get_Volumetricflow().get()] = transported;
+  }
+
+  Eigen::VectorXd initial_vec(m_system.n_unknowns());
+  size_t k = 0;
+  auto assign = [&](const void *p, double current) {
+    auto it = values.find(p);
+    initial_vec(k++) = it != values.end() ? it->second : current;
+  };
+  for (auto &&s : m_system.Get_Unknown_speeds())
+    assign(s.get(), s->value());
+  for (auto &&p : m_system.Get_Unknown_static_pressures())
+    assign(p.get(), p->value());
+  for (auto &&q : m_system.Get_Unknown_volumetric_flow())
+    assign(q.get(), q->value());
+  return initial_vec;
+}
+}
@@ -0,0 +1,74 @@
+// MIT License
+//
+// Copyright (c) 2019 Jelle Spijker
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+
+#ifndef LIBFLUIDS_INITIALGUESS_H
+#define LIBFLUIDS_INITIALGUESS_H
+
+#include <vector>
+
+#include <Eigen/Core>
+
+#include "../include/fluids/System.h"
+
+namespace Fluids {
+/// Physically informed starting point for the non-linear solver. The network is replaced by a linear resistance
+/// network (laminar Hagen-Poiseuille resistances, refined with a few damped Picard sweeps using the Haaland friction
+/// factor) which is solved for the piezometric pressures. Pressures are interpolated between the known vertices and
+/// speeds and transport flows are derived from the resulting pipe flows, so the guess is deterministic and consistent
+/// with the mass balance of the model.
+class InitialGuess {
+public:
+  explicit InitialGuess(const System &system);
+
+  /// Compute the initial vector, ordered as the unknowns of the system
+  /// \return initial vector with size System::n_unknowns()
+  Eigen::VectorXd Compute();
+
+  size_t Get_Max_iterations() const;
+  void Set_Max_iterations(size_t max_iterations);
+
+private:
+  struct Branch {
+    size_t u;
+    size_t v;
+    double area;
+    double laminar_resistance;
+    double turbulent_coefficient;
+    double diameter;
+    double relative_roughness;
+    double density;
+    double dynamic_viscosity;
+  };
+
+  const System &m_system;
+  size_t m_max_iterations{20};
+
+  std::vector<vertex_t> m_vertices;
+  std::vector<Branch> m_branches;
+
+  void Build_branches();
+  double Turbulent_resistance(const Branch &branch, double flow) const;
+};
+}
+
+#endif //LIBFLUIDS_INITIALGUESS_H
@@ -0,0 +1,115 @@
+// MIT License
+//
+// Copyright (c) 2019 Jelle Spijker
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+
+#ifndef LIBFLUIDS_KRYLOV_H
+#define LIBFLUIDS_KRYLOV_H
+
+#include <cmath>
+
+#include <Eigen/Core>
+
+namespace Fluids {
+/// Restarted GMRES with right preconditioning, only needs the action of the operator on a vector
+/// \tparam Operator callable y = A(x)
+/// \tparam Preconditioner callable y = M^-1(x)
+/// \param A operator
+/// \param M preconditioner
+/// \param b right hand side
+/// \param x initial guess, on return the approximate solution
+/// \param tolerance relative tolerance on the residual norm
+/// \param restart dimension of the Krylov subspace before a restart
+/// \param max_iterations maximum number of operator applications
+/// \return number of operator applications
+template<typename Operator, typename Preconditioner>
+size_t Gmres(const Operator &A,
+             const Preconditioner &M,
+             const Eigen::VectorXd &b,
+             Eigen::VectorXd &x,
+             double tolerance,
+             size_t restart,
+             size_t max_iterations) {
+  const Eigen::Index n = b.size();
+  const double b_norm = b.norm();
+  if (b_norm == 0.) {
+    x.setZero(n);
+    return 0;
+  }
+  const Eigen::Index m = static_cast<Eigen::Index>(std::max<size_t>(restart, 1));
+  Eigen::MatrixXd V(n, m + 1);
+  Eigen::MatrixXd H = Eigen::MatrixXd::Zero(m + 1, m);
+  Eigen::VectorXd cs(m), sn(m), g(m + 1);
+  size_t applications = 0;
+  while (applications < max_iterations) {
+    Eigen::VectorXd r = b - A(x);
+    ++applications;
+    double beta = r.norm();
+    if (beta <= tolerance * b_norm)
+      return applications;
+    V.col(0) = r / beta;
+    g.setZero();
+    g(0) = beta;
+    H.setZero();
+    Eigen::Index k = 0;
+    bool converged = false;
+    for (Eigen::Index j = 0; j < m && applications < max_iterations; ++j) {
+      Eigen::VectorXd w = A(M(V.col(j)));
+      ++applications;
+      for (Eigen::Index i = 0; i <= j; ++i) { // Modified Gram-Schmidt
+        H(i, j) = w.dot(V.col(i));
+        w -= H(i, j) * V.col(i);
+      }
+      H(j + 1, j) = w.norm();
+      if (H(j + 1, j) > 0.)
+        V.col(j + 1) = w / H(j + 1, j);
+      for (Eigen::Index i = 0; i < j; ++i) { // Previous Givens rotations
+        double t = cs(i) * H(i, j) + sn(i) * H(i + 1, j);
+        H(i + 1, j) = -sn(i) * H(i, j) + cs(i) * H(i + 1, j);
+        H(i, j) = t;
+      }
+      double d = std::hypot(H(j, j), H(j + 1, j));
+      if (d == 0.) // Singular Hessenberg matrix, keep the subspace built so far
+        break;
+      cs(j) = H(j, j) / d;
+      sn(j) = H(j + 1, j) / d;
+      H(j, j) = d;
+      H(j + 1, j) = 0.;
+      g(j + 1) = -sn(j) * g(j);
+      g(j) = cs(j) * g(j);
+      k = j + 1;
+      if (std::abs(g(j + 1)) <= tolerance * b_norm) {
+        converged = true;
+        break;
+      }
+    }
+    if (k == 0)
+      return applications;
+    Eigen::VectorXd y = H.topLeftCorner(k, k).triangularView<Eigen::Upper>().solve(g.head(k));
+    x += M(V.leftCols(k) * y);
+    if (converged)
+      return applications;
+  }
+  return applications;
+}
+}
+
+#endif //LIBFLUIDS_KRYLOV_H
@@ -0,0 +1,163 @@
+// MIT License
+//
+// Copyright (c) 2019 Jelle Spijker
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+#include "LaneNewton.h"
+
+namespace Fluids {
+
+LaneNewton::LaneNewton(const FlatModel &model, const Eigen::SparseMatrix<double> &pattern,
+                       const std::vector<std::vector<Eigen::Index>> &colors)
+    : m_model(model), m_colors(colors), m_matrix(pattern) {
+  m_lu.analyzePattern(m_matrix);
+}
+
+size_t LaneNewton::Solve(const FlatModel::Lanes &speed, const FlatModel::Lanes &pressure,
+                         const FlatModel::Lanes &open, FlatModel::Lanes &x, double tolerance,
+                         size_t max_iterations, std::vector<SolverStatistics> &statistics,
+                         ThreadPool *pool) {
+  const Eigen::Index lanes = x.rows();
+  const Eigen::Index n = x.cols();
+  const Eigen::Index nnz = m_matrix.nonZeros();
+  statistics.assign(static_cast<size_t>(lanes), SolverStatistics());
+
+  // Jacobian values of every lane, in the storage order of the compressed matrix
+  FlatModel::Lanes values(lanes, nnz);
+  FlatModel::Lanes residual, x_perturbed, step(lanes, n), trial_residual;
+  Eigen::ArrayXd norm(lanes), lambda(lanes);
+  std::vector<bool> active(static_cast<size_t>(lanes), true);
+  std::vector<bool> pending(static_cast<size_t>(lanes));
+
+  m_model.Residual(x, speed, pressure, open, residual, m_workspace, pool);
+  norm = residual.rowwise().norm();
+  size_t n_active = 0;
+  for (Eigen::Index l = 0; l < lanes; ++l) {
+    ++statistics[l].residual_evaluations;
+    active[l] = norm(l) > tolerance && max_iterations > 0;
+    n_active += active[l];
+  }
+
+  while (n_active > 0) {
+    Jacobian(speed, pressure, open, x, residual, values, pool);
+
+    // Factor and solve every active lane, the others keep a zero step
+    step.setZero();
+    lambda.setZero();
+    for (Eigen::Index l = 0; l < lanes; ++l) {
+      if (!active[l])
+        continue;
+      ++statistics[l].iterations;
+      statistics[l].residual_evaluations += m_colors.size();
+      ++statistics[l].jacobian_evaluations;
+      Eigen::Map<Eigen::VectorXd>(m_matrix.valuePtr(), nnz) = values.row(l).transpose();
+      m_lu.factorize(m_matrix);
+      ++statistics[l].factorizations;
+      if (m_lu.info() != Eigen::Success) {
+        active[l] = false;
+        continue;
+      }
+      step.row(l) = -m_lu.solve(residual.row(l).transpose().matrix()).transpose().array();
+      lambda(l) = 1.;
+    }
+
+    // Backtracking of all lanes at once, a lane leaves the search when its residual decreases
+    for (Eigen::Index l = 0; l < lanes; ++l)
+      pending[l] = active[l];
+    for (size_t k = 0; k < 30; ++k) {
+      x_perturbed = x + step.colwise() * lambda;
+      m_model.Residual(x_perturbed, speed, pressure, open, trial_residual, m_workspace, pool);
+      Eigen::ArrayXd trial_norm = trial_residual.rowwise().norm();
+      bool any = false;
+      for (Eigen::Index l = 0; l < lanes; ++l) {
+        if (!pending[l])
+          continue;
+        ++statistics[l].residual_evaluations;
+        if (trial_norm(l) < norm(l)) {
+          x.row(l) = x_perturbed.row(l);
+          residual.row(l) = trial_residual.row(l);
+          norm(l) = trial_norm(l);
+          pending[l] = false;
+          lambda(l) = 0.;
+        } else {
+          lambda(l) *= 0.5;
+          any = true;
+        }
+      }
+      if (!any)
+        break;
+    }
+
+    n_active = 0;
+    for (Eigen::Index l = 0; l < lanes; ++l) {
+      if (pending[l]) // No decrease along the Newton direction
+        active[l] = false;
+      active[l] = active[l] && norm(l) > tolerance && statistics[l].iterations < max_iterations;
+      n_active += active[l];
+    }
+  }
+
+  size_t converged = 0;
+  for (Eigen::Index l = 0; l < lanes; ++l) {
+    statistics[l].residual_norm = norm(l);
+    statistics[l].converged = norm(l) <= tolerance;
+    converged += statistics[l].converged;
+  }
+  return converged;
+}
+
+void LaneNewton::Jacobian(const FlatModel::Lanes &speed, const FlatModel::Lanes &pressure,
+                          const FlatModel::Lanes &open, const FlatModel::Lanes &x, const FlatModel::Lanes &residual,
+                          FlatModel::Lanes &values, ThreadPool *pool) {
+  const double epsilon = std::sqrt(std::numeric_limits<double>::epsilon());
+  // Parallel over the colours when every thread gets one, each colour writes its own columns of the values
+  const bool by_color = pool && m_colors.size() >= pool->Get_Threads();
+  const size_t chunks = by_color ? pool->Chunks(m_colors.size()) : 1;
+  if (m_scratch.size() < chunks)
+    m_scratch.resize(chunks);
+  auto colors = [&](size_t begin, size_t end, size_t chunk) {
+    Scratch &scratch = m_scratch[chunk];
+    for (size_t c = begin; c < end; ++c) {
+      const auto &columns = m_colors[c];
+      scratch.x = x;
+      for (auto &&j : columns)
+        scratch.x.col(j) += epsilon * x.col(j).abs().max(1.);
+      m_model.Residual(scratch.x, speed, pressure, open, scratch.residual, scratch.workspace,
+                       by_color ? nullptr : pool);
+      for (auto &&j : columns) {
+        scratch.h = scratch.x.col(j) - x.col(j);
+        for (Eigen::Index k = m_matrix.outerIndexPtr()[j]; k < m_matrix.outerIndexPtr()[j + 1]; ++k) {
+          Eigen::Index row = m_matrix.innerIndexPtr()[k];
+          values.col(k) = (scratch.residual.col(row) - residual.col(row)) / scratch.h;
+        }
+      }
+    }
+  };
+  if (by_color)
+    pool->Parallel_for(m_colors.size(), colors);
+  else
+    colors(0, m_colors.size(), 0);
+}
+}
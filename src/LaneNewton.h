@@ -0,0 +1,86 @@
+// MIT License
+//
+// Copyright (c) 2019 Jelle Spijker
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+
+#ifndef LIBFLUIDS_LANENEWTON_H
+#define LIBFLUIDS_LANENEWTON_H
+
+#include <vector>
+
+#include <Eigen/Core>
+#include <Eigen/SparseCore>
+#include <Eigen/SparseLU>
+
+#include "../include/fluids/SolverStrategy.h"
+#include "../include/fluids/ThreadPool.h"
+#include "FlatModel.h"
+
+namespace Fluids {
+/// Damped Newton iteration of all lanes of a flat model in lockstep. Every residual evaluation covers all lanes, the
+/// coloured finite difference Jacobian as well. Each active lane is factored on its own, with the symbolic analysis
+/// shared by all lanes and all solves, and a lane is masked out as soon as it converges or stalls. With a thread pool
+/// the colours of the Jacobian are evaluated in parallel when there are enough of them, otherwise every residual
+/// evaluation is divided over the threads.
+class LaneNewton {
+public:
+  LaneNewton(const FlatModel &model, const Eigen::SparseMatrix<double> &pattern,
+             const std::vector<std::vector<Eigen::Index>> &colors);
+
+  /// Solve all lanes
+  /// \param speed known speeds of the vertices, one lane per row
+  /// \param pressure known static pressures of the vertices, one lane per row
+  /// \param open open edges, one lane per row, see FlatModel::Residual
+  /// \param x initial unknowns, one lane per row, on return the last iterates
+  /// \param tolerance norm of the residual of a lane at convergence
+  /// \param max_iterations iterations of a lane
+  /// \param statistics on return the counters of every lane
+  /// \param pool threads of the evaluations, serial when null
+  /// \return number of converged lanes
+  size_t Solve(const FlatModel::Lanes &speed, const FlatModel::Lanes &pressure, const FlatModel::Lanes &open,
+               FlatModel::Lanes &x,
+               double tolerance, size_t max_iterations, std::vector<SolverStatistics> &statistics,
+               ThreadPool *pool = nullptr);
+
+private:
+  /// Scratch of the evaluation of a chunk of colours
+  struct Scratch {
+    FlatModel::Lanes x;
+    FlatModel::Lanes residual;
+    FlatModel::Workspace workspace;
+    Eigen::ArrayXd h;
+  };
+
+  const FlatModel &m_model;
+  const std::vector<std::vector<Eigen::Index>> &m_colors;
+  Eigen::SparseMatrix<double> m_matrix;
+  Eigen::SparseLU<Eigen::SparseMatrix<double>, Eigen::COLAMDOrdering<int>> m_lu;
+  FlatModel::Workspace m_workspace;
+  std::vector<Scratch> m_scratch;
+
+  /// Coloured finite differences of every lane
+  void Jacobian(const FlatModel::Lanes &speed, const FlatModel::Lanes &pressure, const FlatModel::Lanes &open,
+                const FlatModel::Lanes &x, const FlatModel::Lanes &residual, FlatModel::Lanes &values,
+                ThreadPool *pool);
+};
+}
+
+#endif //LIBFLUIDS_LANENEWTON_H
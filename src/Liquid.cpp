@@ -25,6 +25,7 @@
 
 #include <boost/units/cmath.hpp>
 #include <fluids/Liquid.h>
+#include <fluids/Trace.h>
 
 namespace Fluids {
 
@@ -52,6 +53,18 @@ Liquid::Liquid(const Liquid &other) :
 
 }
 
+Liquid::Liquid(const Liquid &other, const Arena &arena) :
+    m_static_pressure(Make_shared<quantity<si::pressure>>(arena, *other.m_static_pressure)),
+    m_speed(Make_shared<quantity<si::velocity>>(arena, *other.m_speed)),
+    m_height(Make_shared<quantity<si::length>>(arena, *other.m_height)),
+    m_density(Make_shared<quantity<si::mass_density>>(arena, *other.m_density)),
+    m_dynamic_viscosity(Make_shared<quantity<si::dynamic_viscosity>>(arena, *other.m_dynamic_viscosity)),
+    m_dynamic_pressure(Make_shared<quantity<si::pressure>>(arena, *other.m_dynamic_pressure)),
+    m_potential_pressure(Make_shared<quantity<si::pressure>>(arena, *other.m_potential_pressure)),
+    m_bernoulli(Make_shared<quantity<si::pressure>>(arena, *other.m_bernoulli)) {
+
+}
+
 Liquid &Liquid::operator=(const Liquid &other) {
   if (this == &other)
     return *this;
@@ -93,6 +106,7 @@ const std::shared_ptr<quantity<si::pressure>> &Liquid::Get_Potential_pressure()
 }
 
 const std::shared_ptr<quantity<si::pressure>> &Liquid::Get_Bernoulli() const {
+  FLUIDS_TRACE_SCOPE("Liquid::Get_Bernoulli");
   *m_bernoulli = *this->Get_Static_pressure() + *this->Get_Dynamic_pressure() + *this->Get_Potential_pressure();
   return m_bernoulli;
 }
@@ -0,0 +1,444 @@
+// MIT License
+//
+// Copyright (c) 2019 Jelle Spijker
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+
+#include <algorithm>
+#include <cmath>
+#include <numeric>
+#include <stdexcept>
+#include <typeinfo>
+#include <unordered_map>
+#include <unordered_set>
+
+#include <Eigen/SparseLU>
+
+#include <fluids/LoopFlow.h>
+#include <fluids/Pipes.h>
+
+namespace Fluids {
+
+LoopFlow::LoopFlow(const std::shared_ptr<System> &system) : m_system(system) {
+  system->Initialize();
+  const Graph &graph = system->Get_Graph();
+  std::unordered_set<const void *> known;
+  for (auto &&s : system->Get_Known_speeds())
+    known.insert(s.get());
+  for (auto &&p : system->Get_Known_static_pressures())
+    known.insert(p.get());
+  for (auto &&q : system->Get_Known_volumetric_flow())
+    known.insert(q.get());
+
+  // Nodes by vertex id, the storage order differs once the system is reordered
+  std::unordered_map<vertex_t, size_t> vertex_id;
+  m_nodes.resize(boost::num_vertices(graph));
+  std::vector<size_t> ids(m_nodes.size());
+  for (size_t id = 0; id < ids.size(); ++id)
+    ids[system->Get_Vertex_index(id)] = id;
+  size_t index = 0;
+  auto vs = boost::vertices(graph);
+  for (auto vit = vs.first; vit != vs.second; ++vit) {
+    vertex_id[*vit] = ids[index++];
+    Node &node = m_nodes[vertex_id[*vit]];
+    node.liquid = graph[*vit];
+    node.density = node.liquid->Get_Density()->value();
+    node.potential = node.liquid->Get_Potential_pressure()->value();
+    node.pressure = node.liquid->Get_Static_pressure()->value();
+    node.root = known.count(node.liquid->Get_Static_pressure().get()) > 0;
+    node.known_speed = known.count(node.liquid->Get_Speed().get()) > 0;
+  }
+
+  auto es = boost::edges(graph);
+  for (auto eit = es.first; eit != es.second; ++eit) {
+    const std::shared_ptr<FluidComponents> &component = graph[*eit];
+    const size_t u = vertex_id[boost::source(*eit, graph)];
+    const size_t v = vertex_id[boost::target(*eit, graph)];
+    if (component->isTransportEdge()) {
+      Boundary boundary;
+      boundary.inlet = boost::in_degree(boost::source(*eit, graph), graph) == 0;
+      boundary.vertex = boundary.inlet ? v : u;
+      boundary.flow = component->Get_Volumetricflow();
+      boundary.known = known.count(boundary.flow.get()) > 0;
+      m_boundaries.push_back(boundary);
+      continue;
+    }
+    if (!component->Is_Active()) // A closed component carries no flow and closes no loop
+      continue;
+    Edge edge;
+    edge.u = u;
+    edge.v = v;
+    edge.density = m_nodes[u].density;
+    edge.dynamic_viscosity = m_nodes[u].liquid->Get_Dynamic_viscosity()->value();
+    if (auto pipe = std::dynamic_pointer_cast<Pipes>(component)) {
+      edge.pipe = true;
+      edge.diameter = pipe->Get_Diameter()->value();
+      edge.length = pipe->Get_Length()->value();
+      edge.relative_roughness = pipe->Get_Relative_roughness()->value();
+      edge.area = pipe->Get_CrossSection()->value();
+    } else if (typeid(*component) == typeid(FluidComponents)) {
+      edge.area = component->Get_CrossSection()->value();
+      edge.delta_pressure = component->Get_DeltaPressure()->value();
+    } else {
+      throw std::logic_error("Component type is not supported by the loop formulation.");
+    }
+    m_nodes[u].out.push_back(m_edges.size());
+    m_nodes[u].out_area += edge.area;
+    m_nodes[v].in.push_back(m_edges.size());
+    m_nodes[v].in_area += edge.area;
+    m_edges.push_back(edge);
+  }
+  for (auto &&node : m_nodes)
+    node.active = !node.in.empty() || !node.out.empty();
+
+  // Boundary conditions, only at the leaves
+  std::vector<bool> leaf(m_nodes.size(), false);
+  std::vector<bool> supplied(m_nodes.size(), false);
+  for (auto &&boundary : m_boundaries) {
+    Node &node = m_nodes[boundary.vertex];
+    leaf[boundary.vertex] = true;
+    if (boundary.known) {
+      node.supply += boundary.inlet ? boundary.flow->value() : -boundary.flow->value();
+      supplied[boundary.vertex] = true;
+    } else if (node.known_speed && !node.root) {
+      const double speed = node.liquid->Get_Speed()->value();
+      node.supply += boundary.inlet ? speed * node.out_area : -speed * node.in_area;
+      supplied[boundary.vertex] = true;
+    }
+  }
+  for (size_t i = 0; i < m_nodes.size(); ++i) {
+    const Node &node = m_nodes[i];
+    if (!node.active)
+      continue;
+    if ((node.root || node.known_speed) && !leaf[i])
+      throw std::logic_error("Known static pressures and speeds are only supported at leaf vertices.");
+    if (node.root && supplied[i])
+      throw std::logic_error("A vertex with a known static pressure and a known flow is not supported.");
+    if (leaf[i] && !node.root && !supplied[i])
+      throw std::logic_error("A leaf vertex needs a known static pressure, speed or flow.");
+  }
+
+  // Spanning forest by union-find over the vertices, the roots being merged into one super vertex
+  const size_t super = m_nodes.size();
+  std::vector<size_t> set(m_nodes.size() + 1);
+  std::iota(set.begin(), set.end(), 0);
+  auto find = [&set](size_t i) {
+    while (set[i] != i)
+      i = set[i] = set[set[i]];
+    return i;
+  };
+  for (size_t i = 0; i < m_nodes.size(); ++i) {
+    if (m_nodes[i].active && m_nodes[i].root) {
+      set[find(i)] = find(super);
+      m_nodes[i].root_index = m_roots.size();
+      m_roots.push_back(i);
+    }
+  }
+  std::vector<size_t> sorted(m_edges.size());
+  std::iota(sorted.begin(), sorted.end(), 0);
+  std::stable_partition(sorted.begin(), sorted.end(), [this](size_t e) { return !m_edges[e].pipe; });
+  std::vector<std::vector<size_t>> tree(m_nodes.size());
+  std::vector<bool> chord(m_edges.size(), true);
+  for (auto &&e : sorted) {
+    size_t a = find(m_edges[e].u), b = find(m_edges[e].v);
+    if (a == b)
+      continue;
+    set[a] = b;
+    chord[e] = false;
+    tree[m_edges[e].u].push_back(e);
+    tree[m_edges[e].v].push_back(e);
+  }
+
+  // Breadth first from the roots, parents before children
+  std::vector<bool> visited(m_nodes.size(), false);
+  for (auto &&r : m_roots) {
+    m_nodes[r].depth = 1;
+    m_nodes[r].parent = super;
+    visited[r] = true;
+    m_order.push_back(r);
+  }
+  for (size_t k = 0; k < m_order.size(); ++k) {
+    const size_t x = m_order[k];
+    for (auto &&e : tree[x]) {
+      const size_t y = m_edges[e].u == x ? m_edges[e].v : m_edges[e].u;
+      if (visited[y])
+        continue;
+      visited[y] = true;
+      m_nodes[y].parent = x;
+      m_nodes[y].parent_edge = e;
+      m_nodes[y].depth = m_nodes[x].depth + 1;
+      m_nodes[y].root_index = m_nodes[x].root_index;
+      m_order.push_back(y);
+    }
+  }
+  for (size_t i = 0; i < m_nodes.size(); ++i) {
+    if (m_nodes[i].active && !visited[i])
+      throw std::logic_error("Every connected part of the system needs a known static pressure.");
+  }
+
+  // Loop of every chord: the chord from u to v and the forest path back from v to u, through the super vertex
+  // when u and v belong to different roots
+  auto depth = [this, super](size_t x) { return x == super ? 0 : m_nodes[x].depth; };
+  std::vector<Eigen::Triplet<double>> loops, ends;
+  for (size_t e = 0; e < m_edges.size(); ++e) {
+    if (!chord[e])
+      continue;
+    const auto j = static_cast<Eigen::Index>(m_chords.size());
+    m_chords.push_back(e);
+    loops.emplace_back(static_cast<Eigen::Index>(e), j, 1.);
+    size_t a = m_edges[e].v, b = m_edges[e].u;
+    const size_t root_a = m_nodes[a].root_index, root_b = m_nodes[b].root_index;
+    if (root_a != root_b) {
+      ends.emplace_back(j, static_cast<Eigen::Index>(root_b), 1.);
+      ends.emplace_back(j, static_cast<Eigen::Index>(root_a), -1.);
+    }
+    while (a != b) {
+      if (depth(a) >= depth(b)) { // Up from v
+        const size_t p = m_nodes[a].parent;
+        if (p != super) {
+          const size_t pe = m_nodes[a].parent_edge;
+          loops.emplace_back(static_cast<Eigen::Index>(pe), j, m_edges[pe].u == a ? 1. : -1.);
+        }
+        a = p;
+      } else { // Down to u
+        const size_t p = m_nodes[b].parent;
+        if (p != super) {
+          const size_t pe = m_nodes[b].parent_edge;
+          loops.emplace_back(static_cast<Eigen::Index>(pe), j, m_edges[pe].u == p ? 1. : -1.);
+        }
+        b = p;
+      }
+    }
+  }
+  m_loops.resize(static_cast<Eigen::Index>(m_edges.size()), static_cast<Eigen::Index>(m_chords.size()));
+  m_loops.setFromTriplets(loops.begin(), loops.end());
+  m_ends.resize(static_cast<Eigen::Index>(m_chords.size()), static_cast<Eigen::Index>(m_roots.size()));
+  m_ends.setFromTriplets(ends.begin(), ends.end());
+
+  // The supplies flow through the forest to the roots
+  m_base_flow.setZero(static_cast<Eigen::Index>(m_edges.size()));
+  std::vector<double> excess(m_nodes.size(), 0.);
+  for (size_t i = 0; i < m_nodes.size(); ++i)
+    excess[i] = m_nodes[i].supply;
+  for (auto it = m_order.rbegin(); it != m_order.rend(); ++it) {
+    const Node &node = m_nodes[*it];
+    if (node.root)
+      continue;
+    m_base_flow(node.parent_edge) = m_edges[node.parent_edge].u == *it ? excess[*it] : -excess[*it];
+    excess[node.parent] += excess[*it];
+  }
+  m_flow = m_base_flow;
+}
+
+size_t LoopFlow::n_loops() const {
+  return m_chords.size();
+}
+
+SolverStatistics LoopFlow::Solve() {
+  const auto k = static_cast<Eigen::Index>(m_chords.size());
+  SolverStatistics statistics;
+  Eigen::VectorXd q(k), flow, bernoulli, residual, trial_flow, trial_bernoulli, trial_residual;
+  // Start from the speeds of the system, or from 1 m/s along the chord
+  for (Eigen::Index j = 0; j < k; ++j) {
+    const Edge &edge = m_edges[m_chords[j]];
+    const double speed = m_nodes[edge.u].liquid->Get_Speed()->value();
+    q(j) = edge.area * (speed != 0. ? speed : 1.);
+  }
+  Evaluate(q, flow, bernoulli, residual);
+  ++statistics.residual_evaluations;
+  double norm = residual.norm();
+
+  Eigen::VectorXd slope(static_cast<Eigen::Index>(m_edges.size()));
+  Eigen::SparseLU<Eigen::SparseMatrix<double>> lu;
+  Eigen::SparseMatrix<double> pattern; //! Structure of the analysed Jacobian
+  // The products keep their structural entries, so the pattern only depends on the loop basis
+  auto same_pattern = [&pattern](const Eigen::SparseMatrix<double> &matrix) {
+    return pattern.nonZeros() == matrix.nonZeros() && pattern.cols() == matrix.cols()
+        && std::equal(matrix.outerIndexPtr(), matrix.outerIndexPtr() + matrix.cols() + 1, pattern.outerIndexPtr())
+        && std::equal(matrix.innerIndexPtr(), matrix.innerIndexPtr() + matrix.nonZeros(), pattern.innerIndexPtr());
+  };
+  while (norm > m_tolerance && statistics.iterations < m_max_iterations) {
+    ++statistics.iterations;
+    // d residual / dq = d (root Bernoulli difference) / dq - L^T diag(d loss / d flow) L
+    for (size_t e = 0; e < m_edges.size(); ++e)
+      slope(e) = Loss_slope(m_edges[e], flow(e));
+    std::vector<Eigen::Triplet<double>> dynamic;
+    for (size_t r = 0; r < m_roots.size(); ++r) {
+      const Node &node = m_nodes[m_roots[r]];
+      const bool out = node.out_area > 0.;
+      const double weight = node.density * std::abs(Speed(node, flow)) / (out ? node.out_area : node.in_area);
+      for (auto &&e : out ? node.out : node.in)
+        dynamic.emplace_back(static_cast<Eigen::Index>(r), static_cast<Eigen::Index>(e), weight);
+    }
+    Eigen::SparseMatrix<double> root_speed(static_cast<Eigen::Index>(m_roots.size()),
+                                           static_cast<Eigen::Index>(m_edges.size()));
+    root_speed.setFromTriplets(dynamic.begin(), dynamic.end());
+    Eigen::SparseMatrix<double> weighted = slope.asDiagonal() * m_loops;
+    Eigen::SparseMatrix<double> jacobian = m_ends * (root_speed * m_loops);
+    jacobian -= Eigen::SparseMatrix<double>(m_loops.transpose() * weighted);
+    jacobian.makeCompressed();
+    ++statistics.jacobian_evaluations;
+    if (!same_pattern(jacobian)) {
+      lu.analyzePattern(jacobian);
+      pattern = jacobian;
+      ++statistics.symbolic_analyses;
+    }
+    lu.factorize(jacobian);
+    ++statistics.factorizations;
+    if (lu.info() != Eigen::Success)
+      break;
+    Eigen::VectorXd step = -lu.solve(residual);
+
+    // Backtracking until the residual decreases
+    double lambda = 1.;
+    bool decreased = false;
+    for (size_t n = 0; n < 30 && !decreased; ++n, lambda *= 0.5) {
+      Evaluate(q + lambda * step, trial_flow, trial_bernoulli, trial_residual);
+      ++statistics.residual_evaluations;
+      if (trial_residual.norm() < norm) {
+        q += lambda * step;
+        flow.swap(trial_flow);
+        bernoulli.swap(trial_bernoulli);
+        residual.swap(trial_residual);
+        norm = residual.norm();
+        decreased = true;
+      }
+    }
+    if (!decreased)
+      break;
+  }
+  statistics.residual_norm = norm;
+  statistics.converged = norm <= m_tolerance;
+  m_flow = flow;
+  Store(flow, bernoulli);
+  return statistics;
+}
+
+quantity<si::volumetric_flow> LoopFlow::Get_Volumetricflow(const size_t &vertex_u, const size_t &vertex_v) const {
+  for (size_t e = 0; e < m_edges.size(); ++e) {
+    if (m_edges[e].u == vertex_u && m_edges[e].v == vertex_v)
+      return m_flow(e) * si::cubic_meters_per_second;
+  }
+  throw std::out_of_range("No component between the vertices.");
+}
+
+double LoopFlow::Get_Tolerance() const {
+  return m_tolerance;
+}
+
+void LoopFlow::Set_Tolerance(double tolerance) {
+  m_tolerance = tolerance;
+}
+
+size_t LoopFlow::Get_Max_iterations() const {
+  return m_max_iterations;
+}
+
+void LoopFlow::Set_Max_iterations(size_t max_iterations) {
+  m_max_iterations = max_iterations;
+}
+
+double LoopFlow::Loss(const Edge &edge, double flow) const {
+  if (!edge.pipe)
+    return edge.delta_pressure;
+  typedef Eigen::Array<double, 1, 1> Single;
+  const double speed = flow / edge.area;
+  // c f Q |Q|, the friction factor of the absolute Reynolds number
+  const double scale = Pipes::Loss_coefficient(edge.length, edge.diameter, edge.density) * edge.area * edge.area;
+  const double friction = Pipes::Haaland(Pipes::Reynolds(Single::Constant(std::abs(speed)), edge.diameter,
+                                                          edge.density, edge.dynamic_viscosity),
+                                         edge.relative_roughness)(0);
+  return scale * friction * speed * std::abs(speed);
+}
+
+double LoopFlow::Loss_slope(const Edge &edge, double flow) const {
+  const double speed = std::abs(flow) / edge.area;
+  if (!edge.pipe || speed == 0.)
+    return 0.;
+  // d/dv f v|v| = |v| (2 f + Re df/dRe), with the Haaland f = (-1.8 log10(s))^-2 and s = (e / 3.7)^1.11 + 6.9 / Re
+  const double reynolds = speed * edge.diameter * edge.density / edge.dynamic_viscosity;
+  const double s = std::pow(edge.relative_roughness / 3.7, 1.11) + 6.9 / reynolds;
+  const double log_s = std::log10(s);
+  const double friction = 1. / (3.24 * log_s * log_s);
+  const double reynolds_slope = friction * 13.8 / (reynolds * s * log_s * std::log(10.));
+  return Pipes::Loss_coefficient(edge.length, edge.diameter, edge.density) * edge.area * speed
+      * (2. * friction + reynolds_slope);
+}
+
+double LoopFlow::Speed(const Node &node, const Eigen::VectorXd &flow) const {
+  double sum = 0.;
+  if (node.out_area > 0.) {
+    for (auto &&e : node.out)
+      sum += flow(e);
+    return sum / node.out_area;
+  }
+  for (auto &&e : node.in)
+    sum += flow(e);
+  return node.in_area > 0. ? sum / node.in_area : 0.;
+}
+
+void LoopFlow::Evaluate(const Eigen::VectorXd &q, Eigen::VectorXd &flow, Eigen::VectorXd &bernoulli,
+                        Eigen::VectorXd &residual) const {
+  flow = m_base_flow + m_loops * q;
+  bernoulli.setZero(static_cast<Eigen::Index>(m_nodes.size()));
+  for (auto &&x : m_order) {
+    const Node &node = m_nodes[x];
+    if (node.root) {
+      const double speed = Speed(node, flow);
+      bernoulli(x) = node.pressure + 0.5 * node.density * std::abs(speed) * speed + node.potential;
+      continue;
+    }
+    const Edge &edge = m_edges[node.parent_edge];
+    const double loss = Loss(edge, flow(node.parent_edge));
+    bernoulli(x) = edge.u == node.parent ? bernoulli(node.parent) - loss : bernoulli(node.parent) + loss;
+  }
+  residual.resize(q.size());
+  for (Eigen::Index j = 0; j < q.size(); ++j) {
+    const Edge &edge = m_edges[m_chords[j]];
+    residual(j) = bernoulli(edge.u) - bernoulli(edge.v) - Loss(edge, flow(m_chords[j]));
+  }
+}
+
+void LoopFlow::Store(const Eigen::VectorXd &flow, const Eigen::VectorXd &bernoulli) const {
+  for (size_t i = 0; i < m_nodes.size(); ++i) {
+    const Node &node = m_nodes[i];
+    if (!node.active)
+      continue;
+    const double speed = Speed(node, flow);
+    if (!node.known_speed)
+      *node.liquid->Get_Speed() = speed * si::meters_per_second;
+    if (!node.root) {
+      const double pressure = bernoulli(i) - 0.5 * node.density * std::abs(speed) * speed - node.potential;
+      *node.liquid->Get_Static_pressure() = pressure * si::pascals;
+    }
+  }
+  for (auto &&boundary : m_boundaries) {
+    if (boundary.known)
+      continue;
+    const Node &node = m_nodes[boundary.vertex];
+    double net = 0.; // Flow leaving the vertex through the network
+    for (auto &&e : node.out)
+      net += flow(e);
+    for (auto &&e : node.in)
+      net -= flow(e);
+    *boundary.flow = (boundary.inlet ? net : -net) * si::cubic_meters_per_second;
+  }
+}
+}
@@ -0,0 +1,118 @@
+// MIT License
+//
+// Copyright (c) 2019 Jelle Spijker
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+
+#include <list>
+
+#include <fluids/MemoryReport.h>
+#include <fluids/FluidComponents.h>
+#include <fluids/System.h>
+#include "MemorySize.h"
+
+namespace Fluids {
+
+size_t MemoryReport::Total() const {
+  return topology + vertex_state + edge_parameters + edge_estimate + solver_workspace + caches;
+}
+
+MemoryReport &MemoryReport::operator+=(const MemoryReport &other) {
+  topology += other.topology;
+  vertex_state += other.vertex_state;
+  edge_parameters += other.edge_parameters;
+  edge_estimate += other.edge_estimate;
+  solver_workspace += other.solver_workspace;
+  caches += other.caches;
+  return *this;
+}
+
+MemoryReport MemoryReport::Of(const System &system) {
+  using namespace MemorySize;
+  MemoryReport report;
+  const Graph &graph = system.Get_Graph();
+  const auto n = static_cast<size_t>(boost::num_vertices(graph));
+  const auto m = static_cast<size_t>(boost::num_edges(graph));
+
+  // Vertex storage with the in and out edge lists, the edge list nodes and the entries of the in and out lists
+  report.topology += Block(n * (2 * sizeof(std::list<void *>) + sizeof(std::shared_ptr<Liquid>)));
+  report.topology += m * (Node(2 * sizeof(size_t) + sizeof(std::shared_ptr<FluidComponents>))
+      + 2 * Node(sizeof(size_t) + sizeof(void *)));
+  report.topology += Vector(system.Get_Known_speeds()) + Vector(system.Get_Unknown_speeds())
+      + Vector(system.Get_Known_static_pressures()) + Vector(system.Get_Unknown_static_pressures())
+      + Vector(system.Get_Known_volumetric_flow()) + Vector(system.Get_Unknown_volumetric_flow());
+
+  // The liquids and transport edges are created by the system, their bytes are counted when they are allocated
+  report.vertex_state += system.m_liquid_bytes->Get_Bytes();
+  report.edge_parameters += system.m_edge_bytes->Get_Bytes();
+
+  // The other components are created by the caller, only they know their storage; their liquids are the ones of
+  // the vertices
+  auto es = boost::edges(graph);
+  for (auto eit = es.first; eit != es.second; ++eit) {
+    const FluidComponents *component = graph[*eit].get();
+    if (component && !component->isTransportEdge())
+      report.edge_estimate += component->Get_Heap_bytes();
+  }
+  return report;
+}
+
+CountingResource::CountingResource(std::pmr::memory_resource *upstream) : m_upstream(upstream) {
+
+}
+
+size_t CountingResource::Get_Bytes() const {
+  return m_bytes;
+}
+
+size_t CountingResource::Get_Peak() const {
+  return m_peak;
+}
+
+size_t CountingResource::Get_Allocations() const {
+  return m_allocations;
+}
+
+void CountingResource::Reset_peak() {
+  m_peak = m_bytes.load();
+}
+
+std::pmr::memory_resource *CountingResource::Get_Upstream() const {
+  return m_upstream;
+}
+
+void *CountingResource::do_allocate(size_t bytes, size_t alignment) {
+  void *p = m_upstream->allocate(bytes, alignment);
+  const size_t current = m_bytes += bytes;
+  ++m_allocations;
+  size_t peak = m_peak.load();
+  while (current > peak && !m_peak.compare_exchange_weak(peak, current)) {}
+  return p;
+}
+
+void CountingResource::do_deallocate(void *p, size_t bytes, size_t alignment) {
+  m_upstream->deallocate(p, bytes, alignment);
+  m_bytes -= bytes;
+}
+
+bool CountingResource::do_is_equal(const std::pmr::memory_resource &other) const noexcept {
+  return this == &other;
+}
+}
@@ -0,0 +1,79 @@
+// MIT License
+//
+// Copyright (c) 2019 Jelle Spijker
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+
+#ifndef LIBFLUIDS_MEMORYSIZE_H
+#define LIBFLUIDS_MEMORYSIZE_H
+
+#include <cstddef>
+#include <memory>
+#include <vector>
+
+#include <Eigen/Core>
+#include <Eigen/SparseCore>
+
+namespace Fluids {
+/// Heap sizes of the objects and containers of the library, as used by MemoryReport
+namespace MemorySize {
+/// Size of an allocation, rounded up to the 16 byte granularity of malloc
+inline size_t Block(size_t bytes) {
+  return bytes == 0 ? 0 : (bytes + 15) / 16 * 16;
+}
+
+/// Control block of a shared pointer: the vtable pointer, the use and weak counts
+constexpr size_t s_control = sizeof(void *) + 2 * sizeof(int);
+
+/// Object owned by a shared pointer constructed from new: the object and a control block holding its pointer
+inline size_t Shared_new(size_t object) {
+  return Block(object) + Block(s_control + sizeof(void *));
+}
+
+/// Object created by std::make_shared: one block with the control block and the object
+inline size_t Shared_inplace(size_t object) {
+  return Block(s_control + object);
+}
+
+/// Node of a std::list or of an unordered container
+inline size_t Node(size_t value) {
+  return Block(2 * sizeof(void *) + value);
+}
+
+template<typename T>
+size_t Vector(const std::vector<T> &vector) {
+  return Block(vector.capacity() * sizeof(T));
+}
+
+template<typename Derived>
+size_t Dense(const Eigen::DenseBase<Derived> &dense) {
+  return Block(static_cast<size_t>(dense.size()) * sizeof(typename Derived::Scalar));
+}
+
+template<typename Scalar>
+size_t Sparse(const Eigen::SparseMatrix<Scalar> &sparse) {
+  const auto nonzeros = static_cast<size_t>(sparse.nonZeros());
+  return Block(nonzeros * sizeof(Scalar)) + Block(nonzeros * sizeof(int))
+      + Block((static_cast<size_t>(sparse.outerSize()) + 1) * sizeof(int));
+}
+}
+}
+
+#endif //LIBFLUIDS_MEMORYSIZE_H
@@ -0,0 +1,238 @@
+// MIT License
+//
+// Copyright (c) 2019 Jelle Spijker
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+
+#include <stdexcept>
+#include <vector>
+
+#include <fluids/MemoryReport.h>
+#include <fluids/Model.h>
+#include "ModelData.h"
+#include "LaneNewton.h"
+#include "Functor.h"
+#include "SparseJacobian.h"
+#include "MemorySize.h"
+
+namespace Fluids {
+
+namespace {
+const std::shared_ptr<System> &Initialized(const std::shared_ptr<System> &system) {
+  system->Initialize();
+  return system;
+}
+}
+
+Model::Data::Data(const std::shared_ptr<System> &system)
+    : flat(*Initialized(system)), topology_version(system->Get_Topology_version()) {
+  if (system->n_unknowns() != system->n_residuals())
+    throw std::runtime_error("A model requires as many residuals as unknowns.");
+  SparseJacobian jacobian(system);
+  pattern = jacobian.Get_Matrix();
+  colors = jacobian.Get_Colors();
+  initial_vector = system->Get_Initial_vector();
+}
+
+Model::Model(const std::shared_ptr<System> &system) : m_data(std::make_shared<const Data>(system)) {
+
+}
+
+size_t Model::n_vertices() const {
+  return static_cast<size_t>(m_data->flat.n_vertices());
+}
+
+size_t Model::n_unknowns() const {
+  return static_cast<size_t>(m_data->flat.n_unknowns());
+}
+
+size_t Model::n_residuals() const {
+  return static_cast<size_t>(m_data->flat.n_residuals());
+}
+
+bool Model::Is_Known_speed(const size_t &vertex) const {
+  return vertex < n_vertices() && m_data->flat.Get_Vertices()[m_data->flat.Vertex_index(vertex)].speed < 0;
+}
+
+bool Model::Is_Known_static_pressure(const size_t &vertex) const {
+  return vertex < n_vertices() && m_data->flat.Get_Vertices()[m_data->flat.Vertex_index(vertex)].pressure < 0;
+}
+
+size_t Model::Get_Topology_version() const {
+  return m_data->topology_version;
+}
+
+const Eigen::VectorXd &Model::Get_Initial_vector() const {
+  return m_data->initial_vector;
+}
+
+const ModelDescription &Model::Get_Description() const {
+  return m_data->flat.Get_Description();
+}
+
+struct SolveState::Workspace {
+  LaneNewton newton;
+  FlatModel::Lanes speed;
+  FlatModel::Lanes pressure;
+  FlatModel::Lanes open;
+  FlatModel::Lanes x;
+  std::vector<SolverStatistics> statistics;
+  bool analysis_reported{false}; //! The symbolic analysis of the constructor was counted by a solve
+
+  explicit Workspace(const Model::Data &data)
+      : newton(data.flat, data.pattern, data.colors),
+        speed(data.flat.Get_Speeds().array()),
+        pressure(data.flat.Get_Static_pressures().array()),
+        open(data.flat.Get_Open().array()),
+        x(data.initial_vector.transpose().array()) {}
+};
+
+SolveState::SolveState(const std::shared_ptr<const Model> &model)
+    : m_model(model), m_workspace(std::make_shared<Workspace>(*model->m_data)) {
+
+}
+
+const std::shared_ptr<const Model> &SolveState::Get_Model() const {
+  return m_model;
+}
+
+void SolveState::Set_Known_Speed(const size_t &vertex, const quantity<si::velocity> &speed) {
+  if (!m_model->Is_Known_speed(vertex))
+    throw std::logic_error("Speed of the vertex is not known in the model.");
+  m_workspace->speed(0, m_model->m_data->flat.Vertex_index(vertex)) = speed.value();
+}
+
+void SolveState::Set_Known_Static_Pressure(const size_t &vertex, const quantity<si::pressure> &pressure) {
+  if (!m_model->Is_Known_static_pressure(vertex))
+    throw std::logic_error("Static pressure of the vertex is not known in the model.");
+  m_workspace->pressure(0, m_model->m_data->flat.Vertex_index(vertex)) = pressure.value();
+}
+
+void SolveState::Set_Active(const size_t &vertex_u, const size_t &vertex_v, bool active) {
+  const FlatModel &flat = m_model->m_data->flat;
+  const Eigen::Index edge = flat.Edge_index(vertex_u, vertex_v);
+  if (!active)
+    flat.Check_Closable(edge);
+  m_workspace->open(0, edge) = active ? 1. : 0.;
+}
+
+bool SolveState::Is_Active(const size_t &vertex_u, const size_t &vertex_v) const {
+  const FlatModel &flat = m_model->m_data->flat;
+  return m_workspace->open(0, flat.Edge_index(vertex_u, vertex_v)) > 0.5;
+}
+
+SolverStatistics SolveState::Solve() {
+  Workspace &w = *m_workspace;
+  w.newton.Solve(w.speed, w.pressure, w.open, w.x, m_tolerance, m_max_iterations, w.statistics, m_pool.get());
+  SolverStatistics statistics = w.statistics.front();
+  // The analysis is done when the state is created, the first solve counts it
+  statistics.symbolic_analyses = w.analysis_reported ? 0 : 1;
+  w.analysis_reported = true;
+  return statistics;
+}
+
+Eigen::VectorXd SolveState::Get_Unknown_vector() const {
+  return m_workspace->x.row(0).transpose().matrix();
+}
+
+void SolveState::Set_Unknown_vector(const Eigen::VectorXd &x) {
+  if (x.size() != m_workspace->x.cols())
+    throw std::logic_error("Size of the unknown vector does not match the model.");
+  m_workspace->x.row(0) = x.transpose().array();
+}
+
+quantity<si::velocity> SolveState::Get_Speed(const size_t &vertex) const {
+  const size_t i = m_model->m_data->flat.Vertex_index(vertex);
+  Eigen::Index column = m_model->m_data->flat.Get_Vertices().at(i).speed;
+  double value = column >= 0 ? m_workspace->x(0, column) : m_workspace->speed(0, i);
+  return value * si::meters_per_second;
+}
+
+quantity<si::pressure> SolveState::Get_Static_pressure(const size_t &vertex) const {
+  const size_t i = m_model->m_data->flat.Vertex_index(vertex);
+  Eigen::Index column = m_model->m_data->flat.Get_Vertices().at(i).pressure;
+  double value = column >= 0 ? m_workspace->x(0, column) : m_workspace->pressure(0, i);
+  return value * si::pascals;
+}
+
+void SolveState::Store(System &system) const {
+  if (system.Get_Topology_version() != m_model->Get_Topology_version())
+    throw std::logic_error("System does not have the topology of the model.");
+  const FlatModel &flat = m_model->m_data->flat;
+  const auto &vertices = flat.Get_Vertices();
+  const auto &edges = flat.Get_Edges();
+  // Known values and open components of this state, then the unknowns through the functor
+  std::vector<size_t> ids(vertices.size());
+  for (size_t id = 0; id < vertices.size(); ++id) {
+    const size_t i = flat.Vertex_index(id);
+    ids[i] = id;
+    if (vertices[i].speed < 0)
+      *system.Get_Liquid(id)->Get_Speed() = m_workspace->speed(0, i) * si::meters_per_second;
+    if (vertices[i].pressure < 0)
+      *system.Get_Liquid(id)->Get_Static_pressure() = m_workspace->pressure(0, i) * si::pascals;
+  }
+  for (size_t k = 0; k < edges.size(); ++k)
+    if (edges[k].kind != FlatModel::Kind::Transport)
+      system.Set_Active(ids[edges[k].u], ids[edges[k].v], m_workspace->open(0, k) > 0.5);
+  System_Functor_Base func(std::shared_ptr<System>(&system, [](System *) {}));
+  Eigen::VectorXd residual(func.values());
+  func(Get_Unknown_vector(), residual);
+}
+
+double SolveState::Get_Tolerance() const {
+  return m_tolerance;
+}
+
+void SolveState::Set_Tolerance(double tolerance) {
+  m_tolerance = tolerance;
+}
+
+size_t SolveState::Get_Max_iterations() const {
+  return m_max_iterations;
+}
+
+void SolveState::Set_Max_iterations(size_t max_iterations) {
+  m_max_iterations = max_iterations;
+}
+
+const std::shared_ptr<ThreadPool> &SolveState::Get_Thread_pool() const {
+  return m_pool;
+}
+
+void SolveState::Set_Thread_pool(const std::shared_ptr<ThreadPool> &pool) {
+  m_pool = pool;
+}
+
+MemoryReport MemoryReport::Of(const Model &model) {
+  using namespace MemorySize;
+  const Model::Data &data = *model.m_data;
+  const ModelDescription &description = data.flat.Get_Description();
+  MemoryReport report;
+  report.solver_workspace = Shared_inplace(sizeof(Model::Data)) + Vector(description.vertices)
+      + Vector(description.edges) + Vector(description.bernoulli_rows) + Vector(description.mass_rows)
+      + Dense(description.speeds) + Dense(description.static_pressures) + Sparse(data.pattern)
+      + Vector(data.colors) + Dense(data.initial_vector);
+  for (auto &&row : description.mass_rows)
+    report.solver_workspace += Vector(row.edges);
+  for (auto &&color : data.colors)
+    report.solver_workspace += Vector(color);
+  return report;
+}
+}
@@ -0,0 +1,48 @@
+// MIT License
+//
+// Copyright (c) 2019 Jelle Spijker
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+
+#ifndef LIBFLUIDS_MODELDATA_H
+#define LIBFLUIDS_MODELDATA_H
+
+#include <vector>
+
+#include <Eigen/Core>
+#include <Eigen/SparseCore>
+
+#include "../include/fluids/Model.h"
+#include "FlatModel.h"
+
+namespace Fluids {
+/// Content of a model, shared read-only by all its solve states
+struct Model::Data {
+  FlatModel flat;
+  Eigen::SparseMatrix<double> pattern;             //! Structure of the Jacobian, the values are not used
+  std::vector<std::vector<Eigen::Index>> colors;   //! Columns perturbed together
+  Eigen::VectorXd initial_vector;
+  size_t topology_version{0};
+
+  explicit Data(const std::shared_ptr<System> &system);
+};
+}
+
+#endif //LIBFLUIDS_MODELDATA_H
@@ -0,0 +1,132 @@
+// MIT License
+//
+// Copyright (c) 2019 Jelle Spijker
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+
+#include <algorithm>
+#include <cstdint>
+#include <numeric>
+
+#include "Ordering.h"
+
+namespace Fluids {
+namespace Ordering {
+
+namespace {
+/// Breadth first search from a root, the neighbours of a vertex by increasing degree
+/// \return the visited vertices in order, the last ones are on the deepest level
+std::vector<size_t> Breadth_first(const std::vector<std::vector<size_t>> &adjacency, size_t root,
+                                  std::vector<bool> &visited) {
+  std::vector<size_t> order{root};
+  visited[root] = true;
+  std::vector<size_t> neighbours;
+  for (size_t head = 0; head < order.size(); ++head) {
+    neighbours.clear();
+    for (size_t w : adjacency[order[head]])
+      if (!visited[w]) {
+        visited[w] = true;
+        neighbours.push_back(w);
+      }
+    std::stable_sort(neighbours.begin(), neighbours.end(), [&adjacency](size_t a, size_t b) {
+      return adjacency[a].size() < adjacency[b].size();
+    });
+    order.insert(order.end(), neighbours.begin(), neighbours.end());
+  }
+  return order;
+}
+}
+
+std::vector<size_t> Reverse_cuthill_mckee(const std::vector<std::vector<size_t>> &adjacency) {
+  const size_t n = adjacency.size();
+  std::vector<size_t> by_degree(n);
+  std::iota(by_degree.begin(), by_degree.end(), 0);
+  std::stable_sort(by_degree.begin(), by_degree.end(), [&adjacency](size_t a, size_t b) {
+    return adjacency[a].size() < adjacency[b].size();
+  });
+
+  std::vector<size_t> order;
+  order.reserve(n);
+  std::vector<bool> visited(n, false);
+  for (size_t start : by_degree) {
+    if (visited[start])
+      continue;
+    // Pseudo-peripheral root: move to a vertex of least degree on the deepest level while the search gets deeper
+    std::vector<bool> probe = visited;
+    std::vector<size_t> level = Breadth_first(adjacency, start, probe);
+    size_t root = start;
+    for (size_t sweep = 0; sweep < 4 && level.size() > 1; ++sweep) {
+      const size_t candidate = *std::min_element(level.end() - std::min<size_t>(level.size() - 1, 8), level.end(),
+                                                 [&adjacency](size_t a, size_t b) {
+                                                   return adjacency[a].size() < adjacency[b].size();
+                                                 });
+      if (candidate == root)
+        break;
+      root = candidate;
+      probe = visited;
+      level = Breadth_first(adjacency, root, probe);
+    }
+    std::vector<size_t> component = Breadth_first(adjacency, root, visited);
+    order.insert(order.end(), component.begin(), component.end());
+  }
+  std::reverse(order.begin(), order.end());
+  return order;
+}
+
+std::vector<size_t> Hilbert(const Eigen::MatrixX2d &coordinates) {
+  const size_t n = static_cast<size_t>(coordinates.rows());
+  if (n == 0)
+    return {};
+  const Eigen::RowVector2d lower = coordinates.colwise().minCoeff();
+  const double extent = std::max((coordinates.colwise().maxCoeff() - lower).maxCoeff(), 1.e-300);
+  const uint32_t side = 1u << 16;
+
+  std::vector<uint64_t> key(n);
+  for (size_t i = 0; i < n; ++i) {
+    auto cell = [&](Eigen::Index c) {
+      const double t = (coordinates(static_cast<Eigen::Index>(i), c) - lower(c)) / extent;
+      return std::min<uint32_t>(static_cast<uint32_t>(t * side), side - 1);
+    };
+    uint32_t x = cell(0);
+    uint32_t y = cell(1);
+    // Distance along the curve, rotating the quadrants as in the classic xy to d conversion
+    uint64_t d = 0;
+    for (uint32_t s = side / 2; s > 0; s /= 2) {
+      const uint32_t rx = (x & s) ? 1 : 0;
+      const uint32_t ry = (y & s) ? 1 : 0;
+      d += static_cast<uint64_t>(s) * s * ((3 * rx) ^ ry);
+      if (ry == 0) {
+        if (rx == 1) {
+          x = side - 1 - x;
+          y = side - 1 - y;
+        }
+        std::swap(x, y);
+      }
+    }
+    key[i] = d;
+  }
+  std::vector<size_t> order(n);
+  std::iota(order.begin(), order.end(), 0);
+  std::stable_sort(order.begin(), order.end(), [&key](size_t a, size_t b) { return key[a] < key[b]; });
+  return order;
+}
+
+}
+}
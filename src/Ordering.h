@@ -0,0 +1,48 @@
+// MIT License
+//
+// Copyright (c) 2019 Jelle Spijker
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+
+#ifndef LIBFLUIDS_ORDERING_H
+#define LIBFLUIDS_ORDERING_H
+
+#include <cstddef>
+#include <vector>
+
+#include <Eigen/Core>
+
+namespace Fluids {
+/// Orderings of the vertices of a network, as used by System::Reorder. An ordering lists the vertices in their new
+/// order, entry k is the current index of the vertex that becomes the k-th.
+namespace Ordering {
+/// Reverse Cuthill-McKee ordering of an undirected graph: a breadth first search from a pseudo-peripheral vertex of
+/// each connected component, visiting the neighbours by increasing degree, reversed. Connected vertices get close
+/// indices, so the bandwidth of the matrices of the network is small.
+/// \param adjacency neighbours of each vertex, both directions of an edge are listed
+std::vector<size_t> Reverse_cuthill_mckee(const std::vector<std::vector<size_t>> &adjacency);
+
+/// Order of the points along a Hilbert curve over their bounding box, points close in the plane get close indices
+/// \param coordinates one row per point
+std::vector<size_t> Hilbert(const Eigen::MatrixX2d &coordinates);
+}
+}
+
+#endif //LIBFLUIDS_ORDERING_H
@@ -27,6 +27,8 @@
 
 #include <boost/units/cmath.hpp>
 #include <fluids/Pipes.h>
+#include <fluids/Trace.h>
+#include "MemorySize.h"
 
 namespace Fluids {
 Pipes::Pipes() :
@@ -77,13 +79,14 @@ Pipes &Pipes::operator=(const Fluids::Pipes &other) {
 }
 
 std::shared_ptr<quantity<si::pressure>> Pipes::Get_DeltaPressure() {
+  FLUIDS_TRACE_SCOPE("Pipes::Get_DeltaPressure");
   quantity<si::dimensionless> re = Pipes::Reynolds(*this->Get_Liquid(Vertex::u)->Get_Speed(),
                                                    *this->Get_Diameter(),
                                                    *this->Get_Liquid(Vertex::u)->Get_Density(),
                                                    *this->Get_Liquid(Vertex::u)->Get_Dynamic_viscosity());
   quantity<si::dimensionless> f = Pipes::Haaland(re, *this->Get_Relative_roughness());
   *Pipes::m_deltapressure =
-      0.81056946914 * f * *this->Get_Length() * pow<2>(*this->Get_Volumetricflow())
+      Loss_factor * f * *this->Get_Length() * pow<2>(*this->Get_Volumetricflow())
           * *this->Get_Liquid(Vertex::u)->Get_Density().get()
           / pow<5>(*this->Get_Diameter());
   return m_deltapressure;
@@ -128,6 +131,12 @@ const std::shared_ptr<quantity<si::dimensionless>> &Pipes::Get_Relative_roughnes
   return m_relative_roughness;
 }
 
+size_t Pipes::Get_Heap_bytes() const {
+  using MemorySize::Shared_new;
+  return MemorySize::Shared_inplace(sizeof(Pipes)) + Quantity_bytes() + Shared_new(sizeof(*m_diameter))
+      + Shared_new(sizeof(*m_length)) + Shared_new(sizeof(*m_roughness)) + Shared_new(sizeof(*m_relative_roughness));
+}
+
 quantity<si::dimensionless> Pipes::Reynolds(const quantity<si::velocity> &speed,
                                             const quantity<si::length> &diameter,
                                             const quantity<si::mass_density> &density,
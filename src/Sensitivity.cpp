@@ -0,0 +1,172 @@
+// MIT License
+//
+// Copyright (c) 2019 Jelle Spijker
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <limits>
+#include <stdexcept>
+#include <unordered_map>
+
+#include <Eigen/SparseLU>
+
+#include <fluids/Pipes.h>
+#include <fluids/Sensitivity.h>
+#include "Functor.h"
+#include "SparseJacobian.h"
+
+namespace Fluids {
+
+Sensitivity::Sensitivity(const std::shared_ptr<System> &system) : m_system(system) {
+
+}
+
+PipeSensitivities Sensitivity::Compute(const std::vector<size_t> &sensors) {
+  m_statistics = SolverStatistics();
+  if (m_system->n_unknowns() != m_system->n_residuals())
+    throw std::runtime_error("Sensitivities require as many residuals as unknowns.");
+  const Graph &graph = m_system->Get_Graph();
+  PipeSensitivities result;
+  result.sensors = sensors;
+
+  std::vector<size_t> ids(boost::num_vertices(graph));
+  for (size_t k = 0; k < ids.size(); ++k)
+    ids[m_system->Get_Vertex_index(k)] = k;
+  std::unordered_map<vertex_t, size_t> id;
+  auto vs = boost::vertices(graph);
+  for (auto vit = vs.first; vit != vs.second; ++vit) {
+    const size_t index = id.size();
+    id[*vit] = ids[index];
+  }
+  std::vector<std::shared_ptr<Pipes>> pipes;
+  auto es = boost::edges(graph);
+  for (auto eit = es.first; eit != es.second; ++eit) {
+    auto pipe = std::dynamic_pointer_cast<Pipes>(graph[*eit]);
+    if (!pipe)
+      continue;
+    pipes.push_back(pipe);
+    result.pipes.emplace_back(id[boost::source(*eit, graph)], id[boost::target(*eit, graph)]);
+  }
+
+  // Factor the Jacobian at the solution
+  System_Functor_Base func(m_system);
+  Eigen::VectorXd x = m_system->Get_Unknown_vector();
+  Eigen::VectorXd residual(func.values());
+  func(x, residual);
+  ++m_statistics.residual_evaluations;
+  SparseJacobian jacobian(m_system);
+  m_statistics.residual_evaluations += jacobian.Evaluate(x, residual);
+  ++m_statistics.jacobian_evaluations;
+  Eigen::SparseLU<Eigen::SparseMatrix<double>, Eigen::COLAMDOrdering<int>> lu;
+  lu.analyzePattern(jacobian.Get_Matrix());
+  ++m_statistics.symbolic_analyses;
+  lu.factorize(jacobian.Get_Matrix());
+  ++m_statistics.factorizations;
+  func(x, residual);
+  ++m_statistics.residual_evaluations;
+  if (lu.info() != Eigen::Success)
+    throw std::runtime_error("Jacobian of the system is singular.");
+  m_statistics.residual_norm = residual.norm();
+
+  // One transposed solve per sensor, J^T lambda = e_c with c the column of the sensor pressure
+  std::unordered_map<const void *, Eigen::Index> pressure_column;
+  Eigen::Index offset = static_cast<Eigen::Index>(m_system->Get_Unknown_speeds().size());
+  for (auto &&p : m_system->Get_Unknown_static_pressures())
+    pressure_column[p.get()] = offset++;
+  Eigen::MatrixXd adjoint = Eigen::MatrixXd::Zero(x.size(), sensors.size());
+  for (size_t k = 0; k < sensors.size(); ++k) {
+    auto it = pressure_column.find(m_system->Get_Liquid(sensors[k])->Get_Static_pressure().get());
+    if (it == pressure_column.end()) // A known pressure does not depend on the pipes
+      continue;
+    Eigen::VectorXd unit = Eigen::VectorXd::Unit(x.size(), it->second);
+    adjoint.col(k) = lu.transpose().solve(unit);
+    ++m_statistics.iterations;
+  }
+
+  // Colour the pipes, pipes without a common residual row are perturbed together
+  std::vector<std::vector<Eigen::Index>> rows(pipes.size());
+  for (size_t p = 0; p < pipes.size(); ++p) {
+    auto it = jacobian.Get_Component_rows().find(pipes[p].get());
+    if (it != jacobian.Get_Component_rows().end())
+      rows[p] = it->second;
+    std::sort(rows[p].begin(), rows[p].end());
+    rows[p].erase(std::unique(rows[p].begin(), rows[p].end()), rows[p].end());
+  }
+  std::vector<std::vector<size_t>> colors;
+  std::vector<std::vector<size_t>> row_colors(residual.size());
+  for (size_t p = 0; p < pipes.size(); ++p) {
+    std::vector<bool> used(colors.size() + 1, false);
+    for (auto &&r : rows[p]) {
+      for (auto &&c : row_colors[r])
+        used[c] = true;
+    }
+    size_t c = 0;
+    while (used[c])
+      ++c;
+    if (c == colors.size())
+      colors.emplace_back();
+    colors[c].push_back(p);
+    for (auto &&r : rows[p])
+      row_colors[r].push_back(c);
+  }
+
+  // dp/dtheta = -lambda^T dF/dtheta
+  typedef const std::shared_ptr<quantity<si::length>> &(Pipes::*Parameter)() const;
+  const std::array<Parameter, 3> parameters{&Pipes::Get_Diameter, &Pipes::Get_Length, &Pipes::Get_Roughness};
+  std::array<Eigen::MatrixXd *, 3> targets{&result.diameter, &result.length, &result.roughness};
+  const double epsilon = std::sqrt(std::numeric_limits<double>::epsilon());
+  Eigen::VectorXd residual_perturbed(residual.size());
+  std::vector<double> original(pipes.size());
+  std::vector<double> step(pipes.size());
+  for (size_t k = 0; k < parameters.size(); ++k) {
+    Eigen::MatrixXd &target = *targets[k];
+    target = Eigen::MatrixXd::Zero(sensors.size(), pipes.size());
+    for (auto &&color : colors) {
+      for (auto &&p : color) {
+        auto &parameter = ((*pipes[p]).*parameters[k])();
+        original[p] = parameter->value();
+        *parameter = (original[p] + epsilon * std::max(std::abs(original[p]), 1.e-6)) * si::meter;
+        step[p] = parameter->value() - original[p];
+      }
+      func(x, residual_perturbed);
+      ++m_statistics.residual_evaluations;
+      for (auto &&p : color) {
+        *((*pipes[p]).*parameters[k])() = original[p] * si::meter;
+        for (auto &&r : rows[p]) {
+          double derivative = (residual_perturbed(r) - residual(r)) / step[p];
+          target.col(p) -= adjoint.row(r).transpose() * derivative;
+        }
+      }
+    }
+  }
+  func(x, residual);
+  ++m_statistics.residual_evaluations;
+  m_statistics.converged = true;
+  return result;
+}
+
+const SolverStatistics &Sensitivity::Get_Statistics() const {
+  return m_statistics;
+}
+
+}
@@ -0,0 +1,384 @@
+// MIT License
+//
+// Copyright (c) 2019 Jelle Spijker
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+
+#include <algorithm>
+#include <cmath>
+#include <filesystem>
+#include <fstream>
+#include <stdexcept>
+
+#include <fluids/Checkpoint.h>
+#include <fluids/Ensemble.h>
+#include <fluids/Service.h>
+#include "Binary.h"
+
+namespace Fluids {
+
+namespace {
+enum class Status : uint8_t {
+  Ok = 0,
+  Error = 1
+};
+
+void Write_string(BinaryWriter &writer, const std::string &value) {
+  writer.Write_vector(std::vector<char>(value.begin(), value.end()));
+}
+
+std::string Read_string(BinaryReader &reader) {
+  const std::vector<char> value = reader.Read_vector<char>();
+  return std::string(value.begin(), value.end());
+}
+
+void Write_matrix(BinaryWriter &writer, const Eigen::MatrixXd &matrix) {
+  // Row major, i.e. by scenario
+  for (Eigen::Index i = 0; i < matrix.rows(); ++i)
+    for (Eigen::Index j = 0; j < matrix.cols(); ++j)
+      writer.Write(matrix(i, j));
+}
+
+Eigen::MatrixXd Read_matrix(BinaryReader &reader, size_t rows, size_t cols) {
+  if (cols > 0 && rows > reader.Remaining() / sizeof(double) / cols)
+    throw std::runtime_error("Message is truncated.");
+  Eigen::MatrixXd matrix(rows, cols);
+  for (Eigen::Index i = 0; i < matrix.rows(); ++i)
+    for (Eigen::Index j = 0; j < matrix.cols(); ++j)
+      matrix(i, j) = reader.Read<double>();
+  return matrix;
+}
+
+/// Reader of a response, positioned after a success status
+BinaryReader Response(const std::string &response) {
+  BinaryReader reader(response.data(), response.size());
+  if (reader.Read<Status>() != Status::Ok)
+    throw std::runtime_error(Read_string(reader));
+  return reader;
+}
+}
+
+double ServiceStatistics::Throughput() const {
+  return uptime > 0. ? static_cast<double>(scenarios) / uptime : 0.;
+}
+
+double ServiceStatistics::Mean_latency() const {
+  return requests > 0 ? busy_seconds / static_cast<double>(requests) : 0.;
+}
+
+Service::Service(const std::shared_ptr<ThreadPool> &pool) : m_pool(pool), m_start(std::chrono::steady_clock::now()) {
+
+}
+
+void Service::Load(const std::string &name, const std::shared_ptr<System> &system) {
+  auto model = std::make_shared<const Model>(system);
+  std::lock_guard<std::mutex> lock(m_mutex);
+  m_models[name] = model;
+}
+
+size_t Service::Load(const std::string &name, const std::string &path) {
+  std::ifstream file(path, std::ios::binary);
+  if (!file)
+    throw std::runtime_error("Checkpoint " + path + " cannot be opened.");
+  auto model = std::make_shared<const Model>(Checkpoint::Restore(file));
+  std::lock_guard<std::mutex> lock(m_mutex);
+  m_models[name] = model;
+  return model->n_vertices();
+}
+
+bool Service::Unload(const std::string &name) {
+  std::lock_guard<std::mutex> lock(m_mutex);
+  return m_models.erase(name) > 0;
+}
+
+std::shared_ptr<const Model> Service::Get_Model(const std::string &name) const {
+  std::lock_guard<std::mutex> lock(m_mutex);
+  auto it = m_models.find(name);
+  return it == m_models.end() ? nullptr : it->second;
+}
+
+SolveResult Service::Solve(const SolveRequest &request) {
+  const std::shared_ptr<const Model> model = Get_Model(request.model);
+  if (!model)
+    throw std::logic_error("No model named " + request.model + ".");
+  if (static_cast<size_t>(request.values.cols()) != request.boundaries.size())
+    throw std::logic_error("Every scenario needs a value of every boundary.");
+  const auto n = static_cast<size_t>(request.values.rows());
+  if (n > m_max_scenarios)
+    throw std::logic_error("The request has more scenarios than the maximum of the service.");
+  const auto n_vertices = static_cast<Eigen::Index>(model->n_vertices());
+  // Status, sizes, converged byte and iterations per scenario, pressures and speeds per scenario and vertex
+  const uint64_t header = 1 + 2 * sizeof(uint64_t);
+  const uint64_t per_scenario = sizeof(uint8_t) + sizeof(uint64_t) + 2 * sizeof(double) * model->n_vertices();
+  if (n > (Max_response - header) / per_scenario)
+    throw std::logic_error("The result of the request does not fit in a response.");
+  for (auto &&boundary : request.boundaries) {
+    const bool known = boundary.kind == SolveRequest::Kind::Speed ? model->Is_Known_speed(boundary.vertex)
+                                                                   : model->Is_Known_static_pressure(boundary.vertex);
+    if (boundary.vertex >= model->n_vertices() || !known)
+      throw std::logic_error("A boundary of the request is not a known value of the model.");
+  }
+
+  SolveResult result;
+  result.converged.resize(n);
+  result.iterations.resize(n);
+  result.static_pressures.resize(static_cast<Eigen::Index>(n), n_vertices);
+  result.speeds.resize(static_cast<Eigen::Index>(n), n_vertices);
+  // Every chunk of scenarios is an ensemble of its own, the chunks write disjoint rows of the result
+  auto solve = [&](size_t begin, size_t end, size_t) {
+    const auto first = static_cast<Eigen::Index>(begin);
+    const auto lanes = static_cast<Eigen::Index>(end - begin);
+    Ensemble ensemble(model, end - begin);
+    ensemble.Set_Tolerance(m_tolerance);
+    for (size_t j = 0; j < request.boundaries.size(); ++j) {
+      const Eigen::ArrayXd values = request.values.col(static_cast<Eigen::Index>(j)).segment(first, lanes).array();
+      if (request.boundaries[j].kind == SolveRequest::Kind::Speed)
+        ensemble.Set_Known_Speed(request.boundaries[j].vertex, values);
+      else
+        ensemble.Set_Known_Static_Pressure(request.boundaries[j].vertex, values);
+    }
+    ensemble.Solve();
+    for (size_t lane = 0; lane < end - begin; ++lane) {
+      result.converged[begin + lane] = ensemble.Get_Statistics()[lane].converged;
+      result.iterations[begin + lane] = ensemble.Get_Statistics()[lane].iterations;
+    }
+    for (Eigen::Index vertex = 0; vertex < n_vertices; ++vertex) {
+      result.static_pressures.col(vertex).segment(first, lanes) =
+          ensemble.Get_Static_pressure(static_cast<size_t>(vertex)).matrix();
+      result.speeds.col(vertex).segment(first, lanes) = ensemble.Get_Speed(static_cast<size_t>(vertex)).matrix();
+    }
+  };
+  if (m_pool)
+    m_pool->Parallel_for(n, solve);
+  else if (n > 0)
+    solve(0, n, 0);
+  return result;
+}
+
+std::string Service::Handle(const std::string &message) {
+  const auto start = std::chrono::steady_clock::now();
+  BinaryWriter response;
+  SolveResult result;
+  bool solved = false;
+  bool failed = false;
+  try {
+    BinaryReader reader(message.data(), message.size());
+    const auto type = reader.Read<Request>();
+    BinaryWriter body;
+    if (type == Request::Load) {
+      const std::string name = Read_string(reader);
+      const std::string path = Read_string(reader);
+      body.Write<uint64_t>(Load(name, Checkpoint_path(path)));
+    } else if (type == Request::Unload) {
+      if (!Unload(Read_string(reader)))
+        throw std::logic_error("No model of that name is loaded.");
+    } else if (type == Request::Solve) {
+      SolveRequest request;
+      request.model = Read_string(reader);
+      request.boundaries.resize(reader.Read_size(sizeof(uint8_t) + sizeof(uint64_t)));
+      for (auto &&boundary : request.boundaries) {
+        boundary.kind = reader.Read<SolveRequest::Kind>();
+        boundary.vertex = static_cast<size_t>(reader.Read<uint64_t>());
+        if (boundary.kind != SolveRequest::Kind::Speed && boundary.kind != SolveRequest::Kind::Static_pressure)
+          throw std::runtime_error("Unknown kind of boundary.");
+      }
+      const auto n = static_cast<size_t>(reader.Read<uint64_t>());
+      // Without boundaries the size of the message does not bound the number of scenarios
+      if (n > m_max_scenarios)
+        throw std::runtime_error("The request has more scenarios than the maximum of the service.");
+      request.values = Read_matrix(reader, n, request.boundaries.size());
+      result = Solve(request);
+      solved = true;
+      body.Write<uint64_t>(static_cast<uint64_t>(result.speeds.cols()));
+      body.Write<uint64_t>(n);
+      for (size_t i = 0; i < n; ++i) {
+        body.Write(result.converged[i]);
+        body.Write(result.iterations[i]);
+      }
+      Write_matrix(body, result.static_pressures);
+      Write_matrix(body, result.speeds);
+    } else if (type == Request::Statistics) {
+      const ServiceStatistics statistics = Get_Statistics();
+      body.Write(statistics.requests);
+      body.Write(statistics.failures);
+      body.Write(statistics.scenarios);
+      body.Write(statistics.converged);
+      body.Write(statistics.busy_seconds);
+      body.Write(statistics.max_latency);
+      body.Write(statistics.uptime);
+      for (auto &&count : statistics.latency_histogram)
+        body.Write(count);
+    } else {
+      throw std::runtime_error("Unknown type of request.");
+    }
+    if (!reader.At_end())
+      throw std::runtime_error("Message is longer than its request.");
+    response.Write(Status::Ok);
+    response.Append(body);
+  } catch (const std::exception &e) {
+    response = BinaryWriter();
+    response.Write(Status::Error);
+    Write_string(response, e.what());
+    failed = true;
+  }
+  Count(std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count(), failed,
+        solved && !failed ? &result : nullptr);
+  return response.Get_Buffer();
+}
+
+void Service::Count(double seconds, bool failed, const SolveResult *result) {
+  std::lock_guard<std::mutex> lock(m_mutex);
+  ++m_statistics.requests;
+  m_statistics.failures += failed;
+  if (result) {
+    m_statistics.scenarios += result->converged.size();
+    m_statistics.converged += static_cast<uint64_t>(std::count(result->converged.begin(), result->converged.end(), 1));
+  }
+  m_statistics.busy_seconds += seconds;
+  m_statistics.max_latency = std::max(m_statistics.max_latency, seconds);
+  const double microseconds = seconds * 1e6;
+  size_t bucket = microseconds < 2. ? 0 : static_cast<size_t>(std::log2(microseconds));
+  m_statistics.latency_histogram[std::min(bucket, ServiceStatistics::Buckets - 1)] += 1;
+}
+
+ServiceStatistics Service::Get_Statistics() const {
+  std::lock_guard<std::mutex> lock(m_mutex);
+  ServiceStatistics statistics = m_statistics;
+  statistics.uptime = std::chrono::duration<double>(std::chrono::steady_clock::now() - m_start).count();
+  return statistics;
+}
+
+double Service::Get_Tolerance() const {
+  return m_tolerance;
+}
+
+void Service::Set_Tolerance(double tolerance) {
+  m_tolerance = tolerance;
+}
+
+size_t Service::Get_Max_scenarios() const {
+  return m_max_scenarios;
+}
+
+void Service::Set_Max_scenarios(size_t max_scenarios) {
+  m_max_scenarios = max_scenarios;
+}
+
+const std::string &Service::Get_Checkpoint_directory() const {
+  return m_checkpoint_directory;
+}
+
+void Service::Set_Checkpoint_directory(const std::string &directory) {
+  m_checkpoint_directory = directory;
+}
+
+std::string Service::Checkpoint_path(const std::string &path) const {
+  namespace fs = std::filesystem;
+  if (m_checkpoint_directory.empty())
+    throw std::runtime_error("The service has no checkpoint directory to load from.");
+  // Symbolic links and .. are resolved before the path is compared with the directory
+  const fs::path directory = fs::weakly_canonical(fs::absolute(m_checkpoint_directory));
+  const fs::path resolved = fs::weakly_canonical(directory / path);
+  auto d = directory.begin();
+  auto r = resolved.begin();
+  for (; d != directory.end() && !d->empty(); ++d, ++r)
+    if (r == resolved.end() || *d != *r)
+      throw std::runtime_error("Checkpoint " + path + " is outside of the checkpoint directory.");
+  return resolved.string();
+}
+
+std::string Service::Encode_load(const std::string &name, const std::string &path) {
+  BinaryWriter writer;
+  writer.Write(Request::Load);
+  Write_string(writer, name);
+  Write_string(writer, path);
+  return writer.Get_Buffer();
+}
+
+std::string Service::Encode_unload(const std::string &name) {
+  BinaryWriter writer;
+  writer.Write(Request::Unload);
+  Write_string(writer, name);
+  return writer.Get_Buffer();
+}
+
+std::string Service::Encode_solve(const SolveRequest &request) {
+  if (static_cast<size_t>(request.values.cols()) != request.boundaries.size())
+    throw std::logic_error("Every scenario needs a value of every boundary.");
+  BinaryWriter writer;
+  writer.Write(Request::Solve);
+  Write_string(writer, request.model);
+  writer.Write<uint64_t>(request.boundaries.size());
+  for (auto &&boundary : request.boundaries) {
+    writer.Write(boundary.kind);
+    writer.Write<uint64_t>(boundary.vertex);
+  }
+  writer.Write<uint64_t>(static_cast<uint64_t>(request.values.rows()));
+  Write_matrix(writer, request.values);
+  return writer.Get_Buffer();
+}
+
+std::string Service::Encode_statistics() {
+  BinaryWriter writer;
+  writer.Write(Request::Statistics);
+  return writer.Get_Buffer();
+}
+
+size_t Service::Decode_load(const std::string &response) {
+  BinaryReader reader = Response(response);
+  return static_cast<size_t>(reader.Read<uint64_t>());
+}
+
+void Service::Decode_unload(const std::string &response) {
+  Response(response);
+}
+
+SolveResult Service::Decode_solve(const std::string &response) {
+  BinaryReader reader = Response(response);
+  const auto n_vertices = static_cast<size_t>(reader.Read<uint64_t>());
+  const size_t n = reader.Read_size(sizeof(uint8_t) + sizeof(uint64_t));
+  SolveResult result;
+  result.converged.resize(n);
+  result.iterations.resize(n);
+  for (size_t i = 0; i < n; ++i) {
+    result.converged[i] = reader.Read<uint8_t>();
+    result.iterations[i] = reader.Read<uint64_t>();
+  }
+  result.static_pressures = Read_matrix(reader, n, n_vertices);
+  result.speeds = Read_matrix(reader, n, n_vertices);
+  return result;
+}
+
+ServiceStatistics Service::Decode_statistics(const std::string &response) {
+  BinaryReader reader = Response(response);
+  ServiceStatistics statistics;
+  statistics.requests = reader.Read<uint64_t>();
+  statistics.failures = reader.Read<uint64_t>();
+  statistics.scenarios = reader.Read<uint64_t>();
+  statistics.converged = reader.Read<uint64_t>();
+  statistics.busy_seconds = reader.Read<double>();
+  statistics.max_latency = reader.Read<double>();
+  statistics.uptime = reader.Read<double>();
+  for (auto &&count : statistics.latency_histogram)
+    count = reader.Read<uint64_t>();
+  return statistics;
+}
+
+}
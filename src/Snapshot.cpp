@@ -0,0 +1,155 @@
+// MIT License
+//
+// Copyright (c) 2019 Jelle Spijker
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+
+#include <algorithm>
+#include <stdexcept>
+#include <vector>
+
+#include <fluids/Snapshot.h>
+
+namespace Fluids {
+
+Snapshot::Snapshot(const System &system, const SolverStatistics &statistics, size_t version)
+    : m_version(version), m_topology_version(system.Get_Topology_version()), m_statistics(statistics),
+      m_unknowns(system.Get_Unknown_vector()) {
+  const Graph &graph = system.Get_Graph();
+  const auto n = static_cast<Eigen::Index>(boost::num_vertices(graph));
+  m_speeds.resize(n);
+  m_static_pressures.resize(n);
+  // Values by vertex id, the storage order differs once the system is reordered
+  std::vector<Eigen::Index> ids(static_cast<size_t>(n));
+  for (size_t id = 0; id < ids.size(); ++id)
+    ids[system.Get_Vertex_index(id)] = static_cast<Eigen::Index>(id);
+  size_t i = 0;
+  auto vs = boost::vertices(graph);
+  for (auto vit = vs.first; vit != vs.second; ++vit, ++i) {
+    m_speeds(ids[i]) = graph[*vit]->Get_Speed()->value();
+    m_static_pressures(ids[i]) = graph[*vit]->Get_Static_pressure()->value();
+  }
+}
+
+size_t Snapshot::Get_Version() const {
+  return m_version;
+}
+
+size_t Snapshot::Get_Topology_version() const {
+  return m_topology_version;
+}
+
+const SolverStatistics &Snapshot::Get_Statistics() const {
+  return m_statistics;
+}
+
+size_t Snapshot::n_vertices() const {
+  return static_cast<size_t>(m_speeds.size());
+}
+
+quantity<si::velocity> Snapshot::Get_Speed(const size_t &vertex) const {
+  if (vertex >= n_vertices())
+    throw std::out_of_range("Vertex is not in the snapshot.");
+  return m_speeds(static_cast<Eigen::Index>(vertex)) * si::meters_per_second;
+}
+
+quantity<si::pressure> Snapshot::Get_Static_pressure(const size_t &vertex) const {
+  if (vertex >= n_vertices())
+    throw std::out_of_range("Vertex is not in the snapshot.");
+  return m_static_pressures(static_cast<Eigen::Index>(vertex)) * si::pascals;
+}
+
+const Eigen::VectorXd &Snapshot::Get_Unknown_vector() const {
+  return m_unknowns;
+}
+
+SnapshotChannel::~SnapshotChannel() {
+  // No reader can be inside the channel while it is destroyed
+  for (auto &&retired : m_retired)
+    delete retired.slot;
+  delete m_current.load();
+}
+
+std::shared_ptr<const Snapshot> SnapshotChannel::Publish(const System &system, const SolverStatistics &statistics) {
+  // The copy is made before the swap, readers only ever see complete snapshots
+  auto snapshot = std::make_shared<const Snapshot>(system, statistics, ++m_version);
+  std::lock_guard<std::mutex> lock(m_publish);
+  const Slot *current = m_current.load();
+  if (current && current->snapshot->Get_Version() > snapshot->Get_Version())
+    return snapshot;
+  m_current.store(new Slot{snapshot});
+  if (current)
+    m_retired.push_back({current, {false, false}});
+  m_epoch.fetch_xor(1u);
+  Reclaim();
+  return snapshot;
+}
+
+void SnapshotChannel::Reclaim() {
+  // A reader that may use a retired slot announced itself before the swap, in either count. A count seen at zero
+  // after the swap means that every such reader of that epoch has left.
+  for (unsigned epoch = 0; epoch < 2; ++epoch) {
+    if (m_readers[epoch].count.load() != 0)
+      continue;
+    for (auto &&retired : m_retired)
+      retired.drained[epoch] = true;
+  }
+  auto released = std::remove_if(m_retired.begin(), m_retired.end(), [](const Retired &retired) {
+    if (!retired.drained[0] || !retired.drained[1])
+      return false;
+    delete retired.slot;
+    return true;
+  });
+  m_retired.erase(released, m_retired.end());
+}
+
+std::shared_ptr<const Snapshot> SnapshotChannel::Get() const {
+  std::shared_ptr<const Snapshot> snapshot;
+  Readers &readers = m_readers[m_epoch.load() & 1u];
+  readers.count.fetch_add(1);
+  const Slot *current = m_current.load();
+  if (current)
+    snapshot = current->snapshot;
+  readers.count.fetch_sub(1);
+  return snapshot;
+}
+
+void SnapshotChannel::Read(const std::function<void(const Snapshot *)> &reader) const {
+  Readers &readers = m_readers[m_epoch.load() & 1u];
+  readers.count.fetch_add(1);
+  const Slot *current = m_current.load();
+  try {
+    reader(current ? current->snapshot.get() : nullptr);
+  } catch (...) {
+    readers.count.fetch_sub(1);
+    throw;
+  }
+  readers.count.fetch_sub(1);
+}
+
+size_t SnapshotChannel::n_retired() const {
+  std::lock_guard<std::mutex> lock(m_publish);
+  return m_retired.size();
+}
+
+size_t SnapshotChannel::Get_Version() const {
+  return m_version;
+}
+}
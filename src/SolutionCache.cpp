@@ -0,0 +1,324 @@
+// MIT License
+//
+// Copyright (c) 2019 Jelle Spijker
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <list>
+#include <stdexcept>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include <boost/functional/hash.hpp>
+
+#include <fluids/MemoryReport.h>
+#include <fluids/Pipes.h>
+#include <fluids/SolutionCache.h>
+#include "Binary.h"
+#include "MemorySize.h"
+
+namespace Fluids {
+
+namespace {
+struct Key {
+  size_t topology_version{0};
+  size_t structure{0};               //! Hash of the graph and the known/unknown partition, see Structure
+  std::vector<std::int64_t> buckets; //! Rounded known values
+
+  bool operator==(const Key &other) const {
+    return topology_version == other.topology_version && structure == other.structure && buckets == other.buckets;
+  }
+
+  bool Same_model(const Key &other) const {
+    return topology_version == other.topology_version && structure == other.structure;
+  }
+};
+
+struct KeyHash {
+  size_t operator()(const Key &key) const {
+    size_t seed = key.topology_version;
+    boost::hash_combine(seed, key.structure);
+    boost::hash_range(seed, key.buckets.begin(), key.buckets.end());
+    return seed;
+  }
+};
+
+/// Hash of the edges of a system (their vertices in storage order and kind of component) and of the quantities that
+/// are known, so that the entries of systems that have the same topology version but not the same layout of the
+/// unknowns are told apart. It only depends on the storage order, a restored checkpoint has the same hash.
+size_t Structure(const System &system) {
+  const Graph &graph = system.Get_Graph();
+  std::unordered_map<vertex_t, size_t> index;
+  std::unordered_set<const void *> known;
+  for (auto &&s : system.Get_Known_speeds())
+    known.insert(s.get());
+  for (auto &&p : system.Get_Known_static_pressures())
+    known.insert(p.get());
+  for (auto &&q : system.Get_Known_volumetric_flow())
+    known.insert(q.get());
+  size_t seed = system.n_unknowns();
+  auto vs = boost::vertices(graph);
+  for (auto vit = vs.first; vit != vs.second; ++vit) {
+    index.emplace(*vit, index.size());
+    boost::hash_combine(seed, known.count(graph[*vit]->Get_Speed().get()));
+    boost::hash_combine(seed, known.count(graph[*vit]->Get_Static_pressure().get()));
+  }
+  auto es = boost::edges(graph);
+  for (auto eit = es.first; eit != es.second; ++eit) {
+    const std::shared_ptr<FluidComponents> &component = graph[*eit];
+    boost::hash_combine(seed, index[boost::source(*eit, graph)]);
+    boost::hash_combine(seed, index[boost::target(*eit, graph)]);
+    boost::hash_combine(seed, component->isTransportEdge() ? 0 : std::dynamic_pointer_cast<Pipes>(component) ? 1 : 2);
+    boost::hash_combine(seed, known.count(component->Get_Volumetricflow().get()));
+  }
+  return seed;
+}
+
+struct Entry {
+  Key key;
+  Eigen::VectorXd scaled; //! Known values in units of the resolution, for the nearest match
+  Eigen::VectorXd x;
+};
+}
+
+struct SolutionCache::Data {
+  size_t capacity;
+  double speed_resolution{1e-6};
+  double pressure_resolution{1e-3};
+  double flow_resolution{1e-9};
+  std::list<Entry> entries; //! Most recently used first
+  std::unordered_map<Key, std::list<Entry>::iterator, KeyHash> index;
+  size_t hits{0};
+  size_t nearest{0};
+  size_t misses{0};
+
+  explicit Data(size_t capacity) : capacity(capacity) {}
+
+  /// Known values of the system in units of the resolution
+  Eigen::VectorXd Scaled(const System &system) const {
+    const auto &speeds = system.Get_Known_speeds();
+    const auto &pressures = system.Get_Known_static_pressures();
+    const auto &flows = system.Get_Known_volumetric_flow();
+    Eigen::VectorXd scaled(speeds.size() + pressures.size() + flows.size());
+    Eigen::Index i = 0;
+    for (auto &&s : speeds)
+      scaled(i++) = s->value() / speed_resolution;
+    for (auto &&p : pressures)
+      scaled(i++) = p->value() / pressure_resolution;
+    for (auto &&q : flows)
+      scaled(i++) = q->value() / flow_resolution;
+    return scaled;
+  }
+
+  static Key Make_key(const System &system, const Eigen::VectorXd &scaled) {
+    Key key;
+    key.topology_version = system.Get_Topology_version();
+    key.structure = Structure(system);
+    key.buckets.reserve(static_cast<size_t>(scaled.size()));
+    for (Eigen::Index i = 0; i < scaled.size(); ++i)
+      key.buckets.push_back(std::llround(scaled(i)));
+    return key;
+  }
+
+  void Evict() {
+    while (entries.size() > capacity) {
+      index.erase(entries.back().key);
+      entries.pop_back();
+    }
+  }
+};
+
+SolutionCache::SolutionCache(size_t capacity) : m_data(std::make_shared<Data>(capacity)) {
+
+}
+
+SolutionCache::Match SolutionCache::Find(const System &system, Eigen::VectorXd &x) {
+  std::lock_guard<std::mutex> lock(m_mutex);
+  Data &data = *m_data;
+  Eigen::VectorXd scaled = data.Scaled(system);
+  Key key = Data::Make_key(system, scaled);
+  // An entry of another model with the same key would not have the unknowns of this one
+  const auto n_unknowns = static_cast<Eigen::Index>(system.n_unknowns());
+  auto it = data.index.find(key);
+  if (it != data.index.end() && it->second->x.size() == n_unknowns) {
+    data.entries.splice(data.entries.begin(), data.entries, it->second);
+    x = it->second->x;
+    ++data.hits;
+    return Match::Exact;
+  }
+  auto nearest = data.entries.end();
+  double distance = std::numeric_limits<double>::infinity();
+  for (auto entry = data.entries.begin(); entry != data.entries.end(); ++entry) {
+    if (!entry->key.Same_model(key) || entry->scaled.size() != scaled.size() || entry->x.size() != n_unknowns)
+      continue;
+    double d = (entry->scaled - scaled).squaredNorm();
+    if (d < distance) {
+      distance = d;
+      nearest = entry;
+    }
+  }
+  if (nearest == data.entries.end()) {
+    ++data.misses;
+    return Match::None;
+  }
+  data.entries.splice(data.entries.begin(), data.entries, nearest);
+  x = nearest->x;
+  ++data.nearest;
+  return Match::Nearest;
+}
+
+void SolutionCache::Insert(const System &system, const Eigen::VectorXd &x) {
+  std::lock_guard<std::mutex> lock(m_mutex);
+  Data &data = *m_data;
+  if (data.capacity == 0)
+    return;
+  Entry entry;
+  entry.scaled = data.Scaled(system);
+  entry.key = Data::Make_key(system, entry.scaled);
+  entry.x = x;
+  auto it = data.index.find(entry.key);
+  if (it != data.index.end()) {
+    data.entries.erase(it->second);
+    data.index.erase(it);
+  }
+  data.entries.push_front(std::move(entry));
+  data.index.emplace(data.entries.front().key, data.entries.begin());
+  data.Evict();
+}
+
+void SolutionCache::Clear() {
+  std::lock_guard<std::mutex> lock(m_mutex);
+  m_data->entries.clear();
+  m_data->index.clear();
+}
+
+size_t SolutionCache::Size() const {
+  std::lock_guard<std::mutex> lock(m_mutex);
+  return m_data->entries.size();
+}
+
+size_t SolutionCache::Get_Capacity() const {
+  std::lock_guard<std::mutex> lock(m_mutex);
+  return m_data->capacity;
+}
+
+void SolutionCache::Set_Capacity(size_t capacity) {
+  std::lock_guard<std::mutex> lock(m_mutex);
+  m_data->capacity = capacity;
+  m_data->Evict();
+}
+
+void SolutionCache::Set_Resolution(const quantity<si::velocity> &speed, const quantity<si::pressure> &pressure,
+                                   const quantity<si::volumetric_flow> &flow) {
+  if (speed.value() <= 0. || pressure.value() <= 0. || flow.value() <= 0.)
+    throw std::logic_error("The resolutions of the solution cache must be positive.");
+  std::lock_guard<std::mutex> lock(m_mutex);
+  m_data->speed_resolution = speed.value();
+  m_data->pressure_resolution = pressure.value();
+  m_data->flow_resolution = flow.value();
+  // The keys of the entries were rounded to the former resolution
+  m_data->entries.clear();
+  m_data->index.clear();
+}
+
+size_t SolutionCache::Get_Hits() const {
+  std::lock_guard<std::mutex> lock(m_mutex);
+  return m_data->hits;
+}
+
+size_t SolutionCache::Get_Nearest() const {
+  std::lock_guard<std::mutex> lock(m_mutex);
+  return m_data->nearest;
+}
+
+size_t SolutionCache::Get_Misses() const {
+  std::lock_guard<std::mutex> lock(m_mutex);
+  return m_data->misses;
+}
+
+void SolutionCache::Write(BinaryWriter &writer) const {
+  std::lock_guard<std::mutex> lock(m_mutex);
+  const Data &data = *m_data;
+  writer.Write(data.speed_resolution);
+  writer.Write(data.pressure_resolution);
+  writer.Write(data.flow_resolution);
+  writer.Write<uint64_t>(data.entries.size());
+  for (auto &&entry : data.entries) {
+    writer.Write<uint64_t>(entry.key.topology_version);
+    writer.Write<uint64_t>(entry.key.structure);
+    writer.Write_vector(entry.key.buckets);
+    writer.Write_vector(entry.scaled);
+    writer.Write_vector(entry.x);
+  }
+}
+
+void SolutionCache::Read(BinaryReader &reader) {
+  const auto speed_resolution = reader.Read<double>();
+  const auto pressure_resolution = reader.Read<double>();
+  const auto flow_resolution = reader.Read<double>();
+  if (!(speed_resolution > 0.) || !(pressure_resolution > 0.) || !(flow_resolution > 0.))
+    throw std::runtime_error("Checkpoint holds an invalid cache resolution.");
+  std::list<Entry> entries;
+  const size_t n = reader.Read_size(5 * sizeof(uint64_t));
+  for (size_t i = 0; i < n; ++i) {
+    Entry entry;
+    entry.key.topology_version = static_cast<size_t>(reader.Read<uint64_t>());
+    entry.key.structure = static_cast<size_t>(reader.Read<uint64_t>());
+    entry.key.buckets = reader.Read_vector<std::int64_t>();
+    entry.scaled = reader.Read_Eigen_vector();
+    entry.x = reader.Read_Eigen_vector();
+    entries.push_back(std::move(entry));
+  }
+
+  std::lock_guard<std::mutex> lock(m_mutex);
+  Data &data = *m_data;
+  data.speed_resolution = speed_resolution;
+  data.pressure_resolution = pressure_resolution;
+  data.flow_resolution = flow_resolution;
+  data.entries = std::move(entries);
+  data.index.clear();
+  for (auto entry = data.entries.begin(); entry != data.entries.end();) {
+    if (data.index.emplace(entry->key, entry).second)
+      ++entry;
+    else
+      entry = data.entries.erase(entry);
+  }
+  data.Evict();
+}
+
+MemoryReport MemoryReport::Of(const SolutionCache &cache) {
+  using namespace MemorySize;
+  std::lock_guard<std::mutex> lock(cache.m_mutex);
+  const SolutionCache::Data &data = *cache.m_data;
+  MemoryReport report;
+  report.caches = Shared_inplace(sizeof(SolutionCache::Data));
+  for (auto &&entry : data.entries)
+    report.caches += Node(sizeof(Entry)) + Vector(entry.key.buckets) + Dense(entry.scaled) + Dense(entry.x);
+  // Bucket array and nodes of the index, each node holds a copy of the key and its hash
+  report.caches += Block(data.index.bucket_count() * sizeof(void *));
+  for (auto &&item : data.index)
+    report.caches += Node(sizeof(item) + sizeof(size_t)) + Vector(item.first.buckets);
+  return report;
+}
+}
@@ -22,37 +22,118 @@
 //
 
 #include <Eigen/Eigen>
-#include <unsupported/Eigen/NonLinearOptimization>
 
 #include <fluids/Solver.h>
+#include <fluids/Trace.h>
 #include "../include/fluids/Solver.h"
 #include "Functor.h"
 
 namespace Fluids {
 
-Solver::Solver() {
+void CancellationToken::Cancel() {
+  m_cancelled = true;
+}
+
+bool CancellationToken::Is_Cancelled() const {
+  return m_cancelled;
+}
+
+Solver::Solver() : m_strategy(std::make_shared<HybridStrategy>()) {
+
+}
+
+Solver::Solver(const std::shared_ptr<System> &system) : m_system(system),
+                                                        m_strategy(std::make_shared<HybridStrategy>()) {
 
 }
 
-Solver::Solver(const std::shared_ptr<System> &system) : m_system(system) {
+Solver::Solver(const std::shared_ptr<System> &system, const std::shared_ptr<SolverStrategy> &strategy)
+    : m_system(system), m_strategy(strategy) {
 
 }
 
 void Solver::Solve() {
+  Solve(SolveOptions());
+}
+
+void Solver::Solve(const SolveOptions &options) {
+  if (m_system == nullptr)
+    throw std::logic_error("No system to solve.");
+  if (m_strategy == nullptr)
+    throw std::logic_error("No strategy to solve with.");
+  FLUIDS_TRACE_SCOPE("Solver::Solve");
+  m_system->Initialize();
+  Eigen::VectorXd x_initial;
+  {
+    FLUIDS_TRACE_SCOPE("Initial vector");
+    x_initial = m_system->Get_Initial_vector();
+  }
+  if (m_cache && m_cache->Find(*m_system, x_initial) == SolutionCache::Match::Exact) {
+    System_Functor_Base func(m_system);
+    Eigen::VectorXd residual(m_system->n_residuals());
+    func(x_initial, residual);
+    if (residual.norm() <= m_strategy->Get_Tolerance()) {
+      m_statistics = SolverStatistics();
+      m_statistics.residual_evaluations = 1;
+      m_statistics.residual_norm = residual.norm();
+      m_statistics.converged = true;
+      if (m_channel)
+        m_channel->Publish(*m_system, m_statistics);
+      if (options.progress)
+        options.progress(0, m_statistics.residual_norm);
+      return;
+    }
+  }
+
+  // Chain the options in front of the monitor of the strategy, which is restored afterwards
+  SolverStrategy::Monitor previous = m_strategy->Get_Monitor();
+  const bool monitored = options.progress || options.cancellation
+      || options.deadline != std::chrono::steady_clock::time_point::max();
+  if (monitored) {
+    m_strategy->Set_Monitor([&](size_t iteration, const Eigen::VectorXd &x, double residual_norm) {
+      if (options.progress)
+        options.progress(iteration, residual_norm);
+      if (options.cancellation && options.cancellation->Is_Cancelled())
+        return false;
+      if (std::chrono::steady_clock::now() >= options.deadline)
+        return false;
+      return !previous || previous(iteration, x, residual_norm);
+    });
+  }
+  try {
+    m_statistics = m_strategy->Solve(m_system, x_initial);
+  } catch (...) {
+    m_strategy->Set_Monitor(previous);
+    throw;
+  }
+  m_strategy->Set_Monitor(previous);
+  if (m_cache && m_statistics.converged)
+    m_cache->Insert(*m_system, x_initial);
+  if (options.progress)
+    options.progress(m_statistics.iterations, m_statistics.residual_norm);
+  // Leave the system in the state of the solution, not in the last finite difference evaluation
+  System_Functor_Base func(m_system);
+  Eigen::VectorXd residual(m_system->n_residuals());
+  func(x_initial, residual);
+  if (m_channel)
+    m_channel->Publish(*m_system, m_statistics);
+}
+
+std::future<SolverStatistics> Solver::SolveAsync(const SolveOptions &options) {
   if (m_system == nullptr)
     throw std::logic_error("No system to solve.");
-  System_Functor func(m_system);
-  Eigen::HybridNonLinearSolver<System_Functor> dl(func);
-  auto x_initial = m_system->Get_Initial_vector();
-  x_initial(0) = 2.0;
-  x_initial(1) = 200000 - 10193.0 - 8587.;
-  dl.solve(x_initial);
+  if (m_strategy == nullptr)
+    throw std::logic_error("No strategy to solve with.");
+  return std::async(std::launch::async, [this, options]() {
+    Solve(options);
+    return m_statistics;
+  });
 }
 
 void Solver::Solve(const std::shared_ptr<System> &system) {
   if (system != Get_System())
     Set_System(system);
-  Solver();
+  Solve();
 }
 
 const std::shared_ptr<System> &Solver::Get_System() const {
@@ -63,4 +144,31 @@ void Solver::Set_System(const std::shared_ptr<System> &system) {
   Solver::m_system = system;
 }
 
+const std::shared_ptr<SolverStrategy> &Solver::Get_Strategy() const {
+  return m_strategy;
+}
+
+void Solver::Set_Strategy(const std::shared_ptr<SolverStrategy> &strategy) {
+  Solver::m_strategy = strategy;
+}
+
+const SolverStatistics &Solver::Get_Statistics() const {
+  return m_statistics;
+}
+
+const std::shared_ptr<SolutionCache> &Solver::Get_Cache() const {
+  return m_cache;
+}
+
+void Solver::Set_Cache(const std::shared_ptr<SolutionCache> &cache) {
+  m_cache = cache;
+}
+
+const std::shared_ptr<SnapshotChannel> &Solver::Get_Channel() const {
+  return m_channel;
+}
+
+void Solver::Set_Channel(const std::shared_ptr<SnapshotChannel> &channel) {
+  m_channel = channel;
+}
 }
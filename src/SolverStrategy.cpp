@@ -0,0 +1,458 @@
+// MIT License
+//
+// Copyright (c) 2019 Jelle Spijker
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+
+#include <cmath>
+#include <limits>
+#include <vector>
+
+#include <Eigen/Eigen>
+#include <Eigen/SparseLU>
+#include <Eigen/IterativeLinearSolvers>
+#include <unsupported/Eigen/NonLinearOptimization>
+
+#include <fluids/SolverStrategy.h>
+#include "Functor.h"
+#include "SparseJacobian.h"
+#include "Krylov.h"
+#include "BlockJacobi.h"
+
+namespace Fluids {
+
+double SolverStrategy::Get_Tolerance() const {
+  return m_tolerance;
+}
+
+void SolverStrategy::Set_Tolerance(double tolerance) {
+  SolverStrategy::m_tolerance = tolerance;
+}
+
+size_t SolverStrategy::Get_Max_iterations() const {
+  return m_max_iterations;
+}
+
+void SolverStrategy::Set_Max_iterations(size_t max_iterations) {
+  SolverStrategy::m_max_iterations = max_iterations;
+}
+
+const SolverStrategy::Monitor &SolverStrategy::Get_Monitor() const {
+  return m_monitor;
+}
+
+void SolverStrategy::Set_Monitor(const SolverStrategy::Monitor &monitor) {
+  SolverStrategy::m_monitor = monitor;
+}
+
+bool SolverStrategy::Report(SolverStatistics &statistics, const Eigen::VectorXd &x, double residual_norm) const {
+  if (!m_monitor || m_monitor(statistics.iterations, x, residual_norm))
+    return true;
+  statistics.interrupted = true;
+  return false;
+}
+
+SolverStatistics HybridStrategy::Solve(const std::shared_ptr<System> &system, Eigen::VectorXd &x) {
+  SolverStatistics statistics;
+  System_Functor func(system);
+  Eigen::HybridNonLinearSolver<System_Functor> dl(func);
+  dl.parameters.maxfev = static_cast<int>(m_max_iterations * (x.size() + 1));
+  // One step per Jacobian evaluation, the monitor is called in between
+  auto status = dl.solveInit(x);
+  while (status == Eigen::HybridNonLinearSolverSpace::Running) {
+    statistics.iterations = static_cast<size_t>(dl.iter) - 1;
+    if (!Report(statistics, x, dl.fnorm))
+      break;
+    FLUIDS_TRACE_SCOPE("Hybrid step");
+    status = dl.solveOneStep(x);
+  }
+  Eigen::VectorXd residual(func.values());
+  func(x, residual);
+  statistics.iterations = static_cast<size_t>(dl.iter) - 1; // The counter starts at one
+  statistics.jacobian_evaluations = static_cast<size_t>(dl.njev);
+  statistics.residual_evaluations = static_cast<size_t>(dl.nfev + dl.njev * x.size()) + 1;
+  statistics.factorizations = statistics.jacobian_evaluations;
+  statistics.factorizations_saved = statistics.iterations > statistics.factorizations
+                                    ? statistics.iterations - statistics.factorizations : 0;
+  statistics.residual_norm = residual.norm();
+  statistics.converged = statistics.residual_norm <= m_tolerance;
+  return statistics;
+}
+
+namespace {
+/// Backtracking along the Newton direction until the residual norm decreases
+/// \return step length, zero when no decrease was found
+double Line_search(System_Functor_Base &func, const Eigen::VectorXd &x, const Eigen::VectorXd &step, double norm,
+                   Eigen::VectorXd &x_new, Eigen::VectorXd &residual_new, SolverStatistics &statistics) {
+  FLUIDS_TRACE_SCOPE("Line search");
+  double lambda = 1.;
+  for (size_t k = 0; k < 30; ++k, lambda *= 0.5) {
+    x_new = x + lambda * step;
+    func(x_new, residual_new);
+    ++statistics.residual_evaluations;
+    if (residual_new.norm() < norm)
+      return lambda;
+  }
+  return 0.;
+}
+
+void Factorize(System_Functor &func, const Eigen::VectorXd &x, Eigen::MatrixXd &jacobian,
+               Eigen::ColPivHouseholderQR<Eigen::MatrixXd> &qr, SolverStatistics &statistics) {
+  {
+    FLUIDS_TRACE_SCOPE("Jacobian");
+    int nfev = func.df(x, jacobian);
+    statistics.residual_evaluations += static_cast<size_t>(nfev);
+    ++statistics.jacobian_evaluations;
+  }
+  FLUIDS_TRACE_SCOPE("Factorization");
+  qr.compute(jacobian);
+  ++statistics.factorizations;
+}
+}
+
+SolverStatistics NewtonStrategy::Solve(const std::shared_ptr<System> &system, Eigen::VectorXd &x) {
+  SolverStatistics statistics;
+  System_Functor func(system);
+  Eigen::VectorXd residual(func.values());
+  Eigen::VectorXd residual_new(func.values());
+  Eigen::VectorXd x_new(x.size());
+  Eigen::MatrixXd jacobian(func.values(), func.inputs());
+  Eigen::ColPivHouseholderQR<Eigen::MatrixXd> qr;
+
+  func(x, residual);
+  ++statistics.residual_evaluations;
+  while (residual.norm() > m_tolerance && statistics.iterations < m_max_iterations) {
+    if (!Report(statistics, x, residual.norm()))
+      break;
+    ++statistics.iterations;
+    Factorize(func, x, jacobian, qr, statistics);
+    Eigen::VectorXd step = -qr.solve(residual);
+    if (Line_search(func, x, step, residual.norm(), x_new, residual_new, statistics) == 0.)
+      break;
+    x.swap(x_new);
+    residual.swap(residual_new);
+  }
+  func(x, residual);
+  statistics.residual_norm = residual.norm();
+  statistics.converged = statistics.residual_norm <= m_tolerance;
+  return statistics;
+}
+
+struct SparseNewtonStrategy::Session {
+  std::weak_ptr<System> system;
+  std::unique_ptr<SparseJacobian> jacobian;
+  Eigen::SparseLU<Eigen::SparseMatrix<double>, Eigen::COLAMDOrdering<int>> lu;
+  size_t symbolic_analyses{0};
+
+  /// Rebuild the pattern and symbolic factorization when the system or its topology changed
+  /// \return true when a new analysis was made
+  bool Prepare(const std::shared_ptr<System> &sys) {
+    if (jacobian && system.lock() == sys && jacobian->Get_Topology_version() == sys->Get_Topology_version())
+      return false;
+    if (sys->n_unknowns() != sys->n_residuals())
+      throw std::runtime_error("Sparse Newton requires as many residuals as unknowns.");
+    system = sys;
+    jacobian = std::make_unique<SparseJacobian>(sys);
+    lu.analyzePattern(jacobian->Get_Matrix());
+    ++symbolic_analyses;
+    return true;
+  }
+};
+
+SparseNewtonStrategy::SparseNewtonStrategy() : m_session(std::make_shared<Session>()) {
+
+}
+
+SolverStatistics SparseNewtonStrategy::Solve(const std::shared_ptr<System> &system, Eigen::VectorXd &x) {
+  SolverStatistics statistics;
+  if (m_session->Prepare(system))
+    ++statistics.symbolic_analyses;
+  System_Functor_Base func(system);
+  Eigen::VectorXd residual(func.values());
+  Eigen::VectorXd residual_new(func.values());
+  Eigen::VectorXd x_new(x.size());
+
+  func(x, residual);
+  ++statistics.residual_evaluations;
+  while (residual.norm() > m_tolerance && statistics.iterations < m_max_iterations) {
+    if (!Report(statistics, x, residual.norm()))
+      break;
+    ++statistics.iterations;
+    {
+      FLUIDS_TRACE_SCOPE("Jacobian");
+      statistics.residual_evaluations += m_session->jacobian->Evaluate(x, residual);
+      ++statistics.jacobian_evaluations;
+    }
+    {
+      FLUIDS_TRACE_SCOPE("Factorization");
+      m_session->lu.factorize(m_session->jacobian->Get_Matrix());
+      ++statistics.factorizations;
+    }
+    if (m_session->lu.info() != Eigen::Success)
+      break;
+    Eigen::VectorXd step = -m_session->lu.solve(residual);
+    if (Line_search(func, x, step, residual.norm(), x_new, residual_new, statistics) == 0.)
+      break;
+    x.swap(x_new);
+    residual.swap(residual_new);
+  }
+  func(x, residual);
+  statistics.residual_norm = residual.norm();
+  statistics.converged = statistics.residual_norm <= m_tolerance;
+  return statistics;
+}
+
+size_t SparseNewtonStrategy::Get_Symbolic_analyses() const {
+  return m_session->symbolic_analyses;
+}
+
+struct NewtonKrylovStrategy::Workspace {
+  std::weak_ptr<System> system;
+  std::unique_ptr<SparseJacobian> jacobian;
+  Eigen::IncompleteLUT<double> ilu;
+  std::unique_ptr<Fluids::BlockJacobi> block_jacobi;
+  bool preconditioned{false}; //! False until a preconditioner is built, or when its factorization failed
+
+  void Prepare(const std::shared_ptr<System> &sys) {
+    if (jacobian && system.lock() == sys && jacobian->Get_Topology_version() == sys->Get_Topology_version())
+      return;
+    if (sys->n_unknowns() != sys->n_residuals())
+      throw std::runtime_error("Newton-Krylov requires as many residuals as unknowns.");
+    system = sys;
+    jacobian = std::make_unique<SparseJacobian>(sys);
+    block_jacobi = std::make_unique<Fluids::BlockJacobi>();
+    preconditioned = false;
+  }
+};
+
+NewtonKrylovStrategy::NewtonKrylovStrategy() : m_workspace(std::make_shared<Workspace>()) {
+
+}
+
+NewtonKrylovStrategy::NewtonKrylovStrategy(NewtonKrylovStrategy::Preconditioner preconditioner)
+    : m_preconditioner(preconditioner), m_workspace(std::make_shared<Workspace>()) {
+
+}
+
+SolverStatistics NewtonKrylovStrategy::Solve(const std::shared_ptr<System> &system, Eigen::VectorXd &x) {
+  SolverStatistics statistics;
+  m_workspace->Prepare(system);
+  System_Functor_Base func(system);
+  Eigen::VectorXd residual(func.values());
+  Eigen::VectorXd residual_new(func.values());
+  Eigen::VectorXd x_new(x.size());
+  Eigen::VectorXd perturbed(func.values());
+  const double epsilon = std::sqrt(std::numeric_limits<double>::epsilon());
+
+  auto jacobian_vector = [&](const Eigen::VectorXd &v) -> Eigen::VectorXd {
+    double v_norm = v.norm();
+    if (v_norm == 0.)
+      return Eigen::VectorXd::Zero(residual.size());
+    double h = epsilon * (1. + x.norm()) / v_norm;
+    func(x + h * v, perturbed);
+    ++statistics.residual_evaluations;
+    return (perturbed - residual) / h;
+  };
+  auto &workspace = *m_workspace;
+  // Unpreconditioned GMRES when the factorization of the preconditioner failed
+  auto preconditioner = [&](const Eigen::VectorXd &v) -> Eigen::VectorXd {
+    if (!workspace.preconditioned)
+      return v;
+    switch (m_preconditioner) {
+    case Preconditioner::BlockJacobi:return workspace.block_jacobi->Solve(v);
+    case Preconditioner::IncompleteLU:return workspace.ilu.solve(v);
+    default:return v;
+    }
+  };
+
+  func(x, residual);
+  ++statistics.residual_evaluations;
+  const size_t lag = std::max<size_t>(m_preconditioner_lag, 1);
+  while (residual.norm() > m_tolerance && statistics.iterations < m_max_iterations) {
+    if (!Report(statistics, x, residual.norm()))
+      break;
+    if (m_preconditioner != Preconditioner::None && statistics.iterations % lag == 0) {
+      FLUIDS_TRACE_SCOPE("Preconditioner");
+      statistics.residual_evaluations += workspace.jacobian->Evaluate(x, residual);
+      ++statistics.jacobian_evaluations;
+      const auto &matrix = workspace.jacobian->Get_Matrix();
+      if (m_preconditioner == Preconditioner::IncompleteLU) {
+        workspace.ilu.compute(matrix);
+        workspace.preconditioned = workspace.ilu.info() == Eigen::Success;
+      } else {
+        workspace.block_jacobi->Compute(matrix);
+        workspace.preconditioned = true;
+      }
+      ++statistics.factorizations;
+    }
+    ++statistics.iterations;
+    Eigen::VectorXd step = Eigen::VectorXd::Zero(x.size());
+    {
+      FLUIDS_TRACE_SCOPE("Gmres");
+      statistics.linear_iterations += Gmres(jacobian_vector, preconditioner, -residual, step, m_forcing, m_restart,
+                                            10 * m_restart);
+    }
+    if (Line_search(func, x, step, residual.norm(), x_new, residual_new, statistics) == 0.)
+      break;
+    x.swap(x_new);
+    residual.swap(residual_new);
+  }
+  func(x, residual);
+  statistics.residual_norm = residual.norm();
+  statistics.converged = statistics.residual_norm <= m_tolerance;
+  return statistics;
+}
+
+NewtonKrylovStrategy::Preconditioner NewtonKrylovStrategy::Get_Preconditioner() const {
+  return m_preconditioner;
+}
+
+void NewtonKrylovStrategy::Set_Preconditioner(NewtonKrylovStrategy::Preconditioner preconditioner) {
+  NewtonKrylovStrategy::m_preconditioner = preconditioner;
+}
+
+double NewtonKrylovStrategy::Get_Forcing() const {
+  return m_forcing;
+}
+
+void NewtonKrylovStrategy::Set_Forcing(double forcing) {
+  NewtonKrylovStrategy::m_forcing = forcing;
+}
+
+size_t NewtonKrylovStrategy::Get_Restart() const {
+  return m_restart;
+}
+
+void NewtonKrylovStrategy::Set_Restart(size_t restart) {
+  NewtonKrylovStrategy::m_restart = restart;
+}
+
+size_t NewtonKrylovStrategy::Get_Preconditioner_lag() const {
+  return m_preconditioner_lag;
+}
+
+void NewtonKrylovStrategy::Set_Preconditioner_lag(size_t lag) {
+  NewtonKrylovStrategy::m_preconditioner_lag = lag;
+}
+
+BroydenStrategy::BroydenStrategy() {
+
+}
+
+BroydenStrategy::BroydenStrategy(BroydenStrategy::Update update) : m_update(update) {
+
+}
+
+SolverStatistics BroydenStrategy::Solve(const std::shared_ptr<System> &system, Eigen::VectorXd &x) {
+  SolverStatistics statistics;
+  System_Functor func(system);
+  Eigen::VectorXd residual(func.values());
+  Eigen::VectorXd residual_new(func.values());
+  Eigen::VectorXd x_new(x.size());
+  Eigen::MatrixXd jacobian(func.values(), func.inputs());
+  Eigen::ColPivHouseholderQR<Eigen::MatrixXd> qr;
+  // Steps since the last factorization, the inverse of the updated Jacobian is applied with the recursion of
+  // Kelley (1995) so only the steps have to be stored
+  std::vector<Eigen::VectorXd> steps;
+  bool refactor = true;
+
+  func(x, residual);
+  ++statistics.residual_evaluations;
+  while (residual.norm() > m_tolerance && statistics.iterations < m_max_iterations) {
+    if (!Report(statistics, x, residual.norm()))
+      break;
+    ++statistics.iterations;
+    bool fresh = refactor;
+    if (refactor) {
+      Factorize(func, x, jacobian, qr, statistics);
+      steps.clear();
+      refactor = false;
+    }
+
+    Eigen::VectorXd step = -qr.solve(residual);
+    if (m_update == Update::Broyden && !steps.empty()) {
+      for (size_t j = 0; j + 1 < steps.size(); ++j) {
+        step += steps[j + 1] * (steps[j].dot(step) / steps[j].squaredNorm());
+      }
+      double denominator = 1. - steps.back().dot(step) / steps.back().squaredNorm();
+      if (std::abs(denominator) < 1.e-12) {
+        refactor = true;
+        continue;
+      }
+      step /= denominator;
+    }
+
+    double norm = residual.norm();
+    if (fresh) {
+      double lambda = Line_search(func, x, step, norm, x_new, residual_new, statistics);
+      if (lambda == 0.)
+        break;
+      if (lambda < 1.) // The recursion requires full steps, restart the updates from the current factorization
+        steps.clear();
+      else
+        steps.push_back(step);
+    } else {
+      x_new = x + step;
+      func(x_new, residual_new);
+      ++statistics.residual_evaluations;
+      if (!(residual_new.norm() < norm)) { // Stale Jacobian, reject the step
+        refactor = true;
+        continue;
+      }
+      steps.push_back(step);
+    }
+    if (residual_new.norm() > m_slowdown * norm || steps.size() >= m_max_updates)
+      refactor = true;
+    x.swap(x_new);
+    residual.swap(residual_new);
+  }
+  func(x, residual);
+  statistics.residual_norm = residual.norm();
+  statistics.converged = statistics.residual_norm <= m_tolerance;
+  statistics.factorizations_saved = statistics.iterations > statistics.factorizations
+                                    ? statistics.iterations - statistics.factorizations : 0;
+  return statistics;
+}
+
+BroydenStrategy::Update BroydenStrategy::Get_Update() const {
+  return m_update;
+}
+
+void BroydenStrategy::Set_Update(BroydenStrategy::Update update) {
+  BroydenStrategy::m_update = update;
+}
+
+double BroydenStrategy::Get_Slowdown() const {
+  return m_slowdown;
+}
+
+void BroydenStrategy::Set_Slowdown(double slowdown) {
+  BroydenStrategy::m_slowdown = slowdown;
+}
+
+size_t BroydenStrategy::Get_Max_updates() const {
+  return m_max_updates;
+}
+
+void BroydenStrategy::Set_Max_updates(size_t max_updates) {
+  BroydenStrategy::m_max_updates = max_updates;
+}
+
+}
@@ -0,0 +1,190 @@
+// MIT License
+//
+// Copyright (c) 2019 Jelle Spijker
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <stdexcept>
+#include <unordered_map>
+
+#include "SparseJacobian.h"
+#include "Functor.h"
+
+namespace Fluids {
+
+SparseJacobian::SparseJacobian(const std::shared_ptr<System> &system)
+    : m_system(system), m_topology_version(system->Get_Topology_version()) {
+  Build_pattern(*system);
+  Build_colors();
+}
+
+size_t SparseJacobian::Get_Topology_version() const {
+  return m_topology_version;
+}
+
+const Eigen::SparseMatrix<double> &SparseJacobian::Get_Matrix() const {
+  return m_matrix;
+}
+
+const std::vector<std::vector<Eigen::Index>> &SparseJacobian::Get_Colors() const {
+  return m_colors;
+}
+
+const SparseJacobian::Component_rows &SparseJacobian::Get_Component_rows() const {
+  return m_component_rows;
+}
+
+void SparseJacobian::Build_pattern(const System &system) {
+  const Graph &graph = system.Get_Graph();
+
+  // Column of every unknown quantity, in the order of the unknown vector
+  std::unordered_map<const void *, Eigen::Index> column;
+  Eigen::Index n = 0;
+  for (auto &&s : system.Get_Unknown_speeds())
+    column[s.get()] = n++;
+  for (auto &&p : system.Get_Unknown_static_pressures())
+    column[p.get()] = n++;
+  for (auto &&q : system.Get_Unknown_volumetric_flow())
+    column[q.get()] = n++;
+
+  std::vector<Eigen::Triplet<double>> triplets;
+  m_component_rows.clear();
+  Eigen::Index row = 0;
+  auto add = [&](const void *p) {
+    auto it = column.find(p);
+    if (it != column.end())
+      triplets.emplace_back(row, it->second, 0.);
+  };
+  auto add_liquid = [&](const std::shared_ptr<Liquid> &liquid) {
+    add(liquid->Get_Speed().get());
+    add(liquid->Get_Static_pressure().get());
+  };
+  auto add_edge = [&](const edge_t &e) {
+    add_liquid(graph[boost::source(e, graph)]);
+    add_liquid(graph[boost::target(e, graph)]);
+    if (graph[e]->isTransportEdge())
+      add(graph[e]->Get_Volumetricflow().get());
+    else
+      m_component_rows[graph[e].get()].push_back(row);
+  };
+
+  // Same row order as System::Get_Return_vec, first the Bernoulli balances...
+  auto es = boost::edges(graph);
+  for (auto eit = es.first; eit != es.second; ++eit) {
+    if (graph[*eit]->isTransportEdge())
+      continue;
+    add_edge(*eit);
+    ++row;
+  }
+  // ... then the mass balances and outlet continuity
+  auto vs = boost::vertices(graph);
+  for (auto vit = vs.first; vit != vs.second; ++vit) {
+    if (boost::in_degree(*vit, graph) == 0)
+      continue;
+    if (boost::out_degree(*vit, graph) == 0) {
+      typename boost::graph_traits<Graph>::in_edge_iterator ei, ei_end;
+      for (boost::tie(ei, ei_end) = boost::in_edges(*vit, graph); ei != ei_end; ++ei) {
+        if (!graph[*ei]->isTransportEdge())
+          continue;
+        add_edge(*ei);
+        // Continuity at the outlet uses the cross sections of the components entering it
+        vertex_t outlet = boost::source(*ei, graph);
+        typename boost::graph_traits<Graph>::in_edge_iterator oi, oi_end;
+        for (boost::tie(oi, oi_end) = boost::in_edges(outlet, graph); oi != oi_end; ++oi)
+          m_component_rows[graph[*oi].get()].push_back(row);
+        ++row;
+      }
+      continue;
+    }
+    typename boost::graph_traits<Graph>::in_edge_iterator ei, ei_end;
+    for (boost::tie(ei, ei_end) = boost::in_edges(*vit, graph); ei != ei_end; ++ei)
+      add_edge(*ei);
+    typename boost::graph_traits<Graph>::out_edge_iterator eo, eo_end;
+    for (boost::tie(eo, eo_end) = boost::out_edges(*vit, graph); eo != eo_end; ++eo)
+      add_edge(*eo);
+    ++row;
+  }
+
+  m_matrix.resize(row, n);
+  // Duplicates are summed, all values are zero so only the structure remains
+  m_matrix.setFromTriplets(triplets.begin(), triplets.end());
+  m_matrix.makeCompressed();
+}
+
+void SparseJacobian::Build_colors() {
+  m_colors = Colors(m_matrix);
+}
+
+std::vector<std::vector<Eigen::Index>> SparseJacobian::Colors(const Eigen::SparseMatrix<double> &pattern) {
+  // Rows of every column and columns of every row
+  Eigen::SparseMatrix<double, Eigen::RowMajor> rows(pattern);
+  std::vector<Eigen::Index> color(pattern.cols(), -1);
+  std::vector<Eigen::Index> forbidden;
+  std::vector<std::vector<Eigen::Index>> colors;
+  for (Eigen::Index j = 0; j < pattern.cols(); ++j) {
+    forbidden.assign(colors.size() + 1, -1);
+    for (Eigen::SparseMatrix<double>::InnerIterator it(pattern, j); it; ++it) {
+      for (Eigen::SparseMatrix<double, Eigen::RowMajor>::InnerIterator jt(rows, it.row()); jt; ++jt) {
+        if (color[jt.col()] >= 0)
+          forbidden[color[jt.col()]] = j;
+      }
+    }
+    Eigen::Index c = 0;
+    while (forbidden[c] == j)
+      ++c;
+    if (c == static_cast<Eigen::Index>(colors.size()))
+      colors.emplace_back();
+    colors[c].push_back(j);
+    color[j] = c;
+  }
+  return colors;
+}
+
+size_t SparseJacobian::Evaluate(const Eigen::VectorXd &x, const Eigen::VectorXd &residual) {
+  std::shared_ptr<System> system = m_system.lock();
+  if (!system)
+    throw std::logic_error("The system of the Jacobian no longer exists.");
+  if (m_topology_version != system->Get_Topology_version()) {
+    m_topology_version = system->Get_Topology_version();
+    Build_pattern(*system);
+    Build_colors();
+  }
+  System_Functor_Base func(system);
+  const double epsilon = std::sqrt(std::numeric_limits<double>::epsilon());
+  Eigen::VectorXd x_perturbed = x;
+  Eigen::VectorXd residual_perturbed(residual.size());
+  for (auto &&columns : m_colors) {
+    for (auto &&j : columns)
+      x_perturbed(j) = x(j) + epsilon * std::max(std::abs(x(j)), 1.);
+    func(x_perturbed, residual_perturbed);
+    for (auto &&j : columns) {
+      // Use the representable step to keep the quotient consistent
+      double h = x_perturbed(j) - x(j);
+      for (Eigen::SparseMatrix<double>::InnerIterator it(m_matrix, j); it; ++it)
+        it.valueRef() = (residual_perturbed(it.row()) - residual(it.row())) / h;
+      x_perturbed(j) = x(j);
+    }
+  }
+  return m_colors.size();
+}
+}
@@ -0,0 +1,81 @@
+// MIT License
+//
+// Copyright (c) 2019 Jelle Spijker
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+
+#ifndef LIBFLUIDS_SPARSEJACOBIAN_H
+#define LIBFLUIDS_SPARSEJACOBIAN_H
+
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+#include <Eigen/Core>
+#include <Eigen/SparseCore>
+
+#include "../include/fluids/System.h"
+
+namespace Fluids {
+/// Finite difference Jacobian of the system residual that only evaluates the structural non-zeros. The pattern is
+/// derived from the graph (a residual row depends on the unknowns of the liquids at the ends of its edges and on the
+/// transported flows), the columns are greedily coloured so that columns without a common row are perturbed
+/// together, which makes the cost a handful of residual evaluations instead of one per unknown. The system is not
+/// kept alive by its Jacobian, the pattern and the colouring are rebuilt when its topology version changed.
+class SparseJacobian {
+public:
+  typedef std::unordered_map<const FluidComponents *, std::vector<Eigen::Index>> Component_rows;
+
+  explicit SparseJacobian(const std::shared_ptr<System> &system);
+
+  /// Topology version of the system the pattern was built for
+  size_t Get_Topology_version() const;
+
+  /// Matrix with the values of the last evaluation, column major and compressed
+  const Eigen::SparseMatrix<double> &Get_Matrix() const;
+
+  const std::vector<std::vector<Eigen::Index>> &Get_Colors() const;
+
+  /// Greedy colouring of the columns of a pattern, the columns of a colour have no common row
+  static std::vector<std::vector<Eigen::Index>> Colors(const Eigen::SparseMatrix<double> &pattern);
+
+  /// Residual rows that depend on the parameters of each (non transport) component
+  const Component_rows &Get_Component_rows() const;
+
+  /// Evaluate the Jacobian by finite differences, after rebuilding a pattern of another topology version. Throws
+  /// std::logic_error when the system no longer exists.
+  /// \param x point of evaluation
+  /// \param residual residual vector at x
+  /// \return number of residual evaluations
+  size_t Evaluate(const Eigen::VectorXd &x, const Eigen::VectorXd &residual);
+
+private:
+  std::weak_ptr<System> m_system;
+  size_t m_topology_version;
+  Eigen::SparseMatrix<double> m_matrix;
+  std::vector<std::vector<Eigen::Index>> m_colors;
+  Component_rows m_component_rows;
+
+  void Build_pattern(const System &system);
+  void Build_colors();
+};
+}
+
+#endif //LIBFLUIDS_SPARSEJACOBIAN_H
@@ -0,0 +1,278 @@
+// MIT License
+//
+// Copyright (c) 2019 Jelle Spijker
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+
+#include <algorithm>
+#include <cmath>
+#include <functional>
+#include <stdexcept>
+
+#include <fluids/Surrogate.h>
+
+namespace Fluids {
+
+namespace {
+/// Modified hierarchical hat of a level and odd index on [0, 1], extrapolating linearly towards the faces
+double Basis(int level, int index, double x) {
+  if (level == 1)
+    return 1.;
+  const double scaled = std::ldexp(x, level);
+  if (index == 1)
+    return std::max(0., 2. - scaled);
+  if (index == (1 << level) - 1)
+    return std::max(0., scaled - index + 1.);
+  return std::max(0., 1. - std::abs(scaled - index));
+}
+
+/// Radical inverse of an index in a prime base, the coordinates of a Halton point
+double Halton(size_t index, size_t base) {
+  double result = 0.;
+  double fraction = 1.;
+  for (; index > 0; index /= base) {
+    fraction /= static_cast<double>(base);
+    result += fraction * static_cast<double>(index % base);
+  }
+  return result;
+}
+
+const size_t primes[] = {2, 3, 5, 7, 11, 13, 17, 19, 23, 29, 31, 37, 41, 43, 47, 53};
+const size_t n_primes = sizeof(primes) / sizeof(primes[0]); //! Dimensions of the Halton validation points
+
+size_t Prime(size_t n) {
+  if (n >= n_primes)
+    throw std::logic_error("Too many surrogate dimensions.");
+  return primes[n];
+}
+
+/// Sum of the surpluses weighted by their bases at a point of the unit box
+Eigen::VectorXd Sum_surpluses(const std::vector<int> &levels, const std::vector<int> &indices,
+                              const Eigen::MatrixXd &surpluses, const Eigen::VectorXd &unit) {
+  const size_t d = static_cast<size_t>(unit.size());
+  Eigen::VectorXd x = Eigen::VectorXd::Zero(surpluses.cols());
+  for (Eigen::Index s = 0; s < surpluses.rows(); ++s) {
+    double weight = 1.;
+    for (size_t k = 0; k < d && weight != 0.; ++k)
+      weight *= Basis(levels[s * d + k], indices[s * d + k], unit(k));
+    if (weight != 0.)
+      x += weight * surpluses.row(s).transpose();
+  }
+  return x;
+}
+}
+
+Surrogate::Surrogate(const std::shared_ptr<const Model> &model) : m_model(model) {
+
+}
+
+void Surrogate::Add_Speed_dimension(const size_t &vertex, const quantity<si::velocity> &lower,
+                                    const quantity<si::velocity> &upper) {
+  if (!m_model->Is_Known_speed(vertex))
+    throw std::logic_error("Speed of the vertex is not known in the model.");
+  if (!(lower < upper))
+    throw std::logic_error("Lower bound should be below the upper bound.");
+  m_dimensions.push_back({vertex, false, lower.value(), upper.value()});
+  m_surpluses.resize(0, 0);
+}
+
+void Surrogate::Add_Static_pressure_dimension(const size_t &vertex, const quantity<si::pressure> &lower,
+                                              const quantity<si::pressure> &upper) {
+  if (!m_model->Is_Known_static_pressure(vertex))
+    throw std::logic_error("Static pressure of the vertex is not known in the model.");
+  if (!(lower < upper))
+    throw std::logic_error("Lower bound should be below the upper bound.");
+  m_dimensions.push_back({vertex, true, lower.value(), upper.value()});
+  m_surpluses.resize(0, 0);
+}
+
+size_t Surrogate::n_dimensions() const {
+  return m_dimensions.size();
+}
+
+SolverStatistics Surrogate::Build(size_t level) {
+  const size_t d = m_dimensions.size();
+  if (d == 0)
+    throw std::logic_error("The surrogate has no dimension.");
+  if (d > n_primes)
+    throw std::logic_error("Too many surrogate dimensions.");
+  if (level == 0 || level > 20)
+    throw std::logic_error("Surrogate level should be between 1 and 20.");
+
+  // Sparse grid: the level vectors with |l|_1 <= level + d - 1, by increasing |l|_1 so that every sample comes
+  // after the samples of the coarser levels whose bases it needs. The fit is kept aside until every sample converged,
+  // so that a failed build never leaves a trusted interpolant behind
+  std::vector<int> sample_levels, sample_indices;
+  const int max_sum = static_cast<int>(level + d - 1);
+  std::vector<int> levels(d), indices(d);
+  for (int sum = static_cast<int>(d); sum <= max_sum; ++sum) {
+    std::function<void(size_t, int)> split = [&](size_t k, int remaining) {
+      if (k + 1 == d) {
+        levels[k] = remaining;
+        std::function<void(size_t)> enumerate = [&](size_t j) {
+          if (j == d) {
+            sample_levels.insert(sample_levels.end(), levels.begin(), levels.end());
+            sample_indices.insert(sample_indices.end(), indices.begin(), indices.end());
+            return;
+          }
+          for (indices[j] = 1; indices[j] < (1 << levels[j]); indices[j] += 2)
+            enumerate(j + 1);
+        };
+        enumerate(0);
+        return;
+      }
+      for (levels[k] = 1; levels[k] <= remaining - static_cast<int>(d - k - 1); ++levels[k])
+        split(k + 1, remaining - levels[k]);
+    };
+    split(0, sum);
+  }
+  const size_t n = sample_levels.size() / d;
+
+  SolveState state(m_model);
+  state.Set_Tolerance(m_tolerance);
+  state.Set_Max_iterations(m_max_iterations);
+  SolverStatistics total;
+  total.converged = true;
+  auto solve = [&](const Eigen::VectorXd &point) {
+    Set_Known(state, point);
+    SolverStatistics statistics = state.Solve();
+    if (!statistics.converged) { // Cold start
+      state.Set_Unknown_vector(m_model->Get_Initial_vector());
+      statistics = state.Solve();
+    }
+    total.iterations += statistics.iterations;
+    total.symbolic_analyses += statistics.symbolic_analyses;
+    total.residual_evaluations += statistics.residual_evaluations;
+    total.jacobian_evaluations += statistics.jacobian_evaluations;
+    total.factorizations += statistics.factorizations;
+    total.factorizations_saved += statistics.factorizations_saved;
+    total.linear_iterations += statistics.linear_iterations;
+    total.residual_norm = std::max(total.residual_norm, statistics.residual_norm);
+    total.converged = total.converged && statistics.converged;
+    return state.Get_Unknown_vector();
+  };
+  auto to_box = [this, d](const Eigen::VectorXd &unit) {
+    Eigen::VectorXd point(d);
+    for (size_t k = 0; k < d; ++k)
+      point(k) = m_dimensions[k].lower + unit(k) * (m_dimensions[k].upper - m_dimensions[k].lower);
+    return point;
+  };
+
+  // The surplus of a sample is its solution minus the interpolant of the samples before it
+  Eigen::MatrixXd surpluses = Eigen::MatrixXd::Zero(n, m_model->n_unknowns());
+  Eigen::VectorXd unit(d);
+  for (size_t s = 0; s < n; ++s) {
+    for (size_t k = 0; k < d; ++k)
+      unit(k) = std::ldexp(sample_indices[s * d + k], -sample_levels[s * d + k]);
+    Eigen::VectorXd x = solve(to_box(unit));
+    surpluses.row(s) = x.transpose() - Sum_surpluses(sample_levels, sample_indices, surpluses, unit).transpose();
+  }
+
+  Eigen::VectorXd fit_error = Eigen::VectorXd::Zero(m_model->n_unknowns());
+  for (size_t p = 1; p <= m_validation_points; ++p) {
+    for (size_t k = 0; k < d; ++k)
+      unit(k) = Halton(p, Prime(k));
+    const Eigen::VectorXd x = solve(to_box(unit));
+    fit_error = fit_error.cwiseMax((x - Sum_surpluses(sample_levels, sample_indices, surpluses, unit)).cwiseAbs());
+  }
+  if (!total.converged)
+    throw std::runtime_error("A sample of the surrogate did not converge.");
+  m_levels.swap(sample_levels);
+  m_indices.swap(sample_indices);
+  m_surpluses.swap(surpluses);
+  m_fit_error.swap(fit_error);
+  return total;
+}
+
+size_t Surrogate::n_samples() const {
+  return static_cast<size_t>(m_surpluses.rows());
+}
+
+const Eigen::VectorXd &Surrogate::Get_Fit_error() const {
+  return m_fit_error;
+}
+
+size_t Surrogate::Get_Validation_points() const {
+  return m_validation_points;
+}
+
+void Surrogate::Set_Validation_points(size_t points) {
+  m_validation_points = points;
+}
+
+bool Surrogate::Is_Trusted(const Eigen::VectorXd &point) const {
+  if (m_surpluses.rows() == 0 || point.size() != static_cast<Eigen::Index>(m_dimensions.size()))
+    return false;
+  for (size_t k = 0; k < m_dimensions.size(); ++k)
+    if (!(point(k) >= m_dimensions[k].lower && point(k) <= m_dimensions[k].upper))
+      return false;
+  return true;
+}
+
+Eigen::VectorXd Surrogate::Evaluate(const Eigen::VectorXd &point, bool *interpolated) const {
+  if (point.size() != static_cast<Eigen::Index>(m_dimensions.size()))
+    throw std::logic_error("The point should have one value per dimension.");
+  const bool trusted = Is_Trusted(point);
+  if (interpolated)
+    *interpolated = trusted;
+  if (trusted) {
+    Eigen::VectorXd unit(point.size());
+    for (size_t k = 0; k < m_dimensions.size(); ++k)
+      unit(k) = (point(k) - m_dimensions[k].lower) / (m_dimensions[k].upper - m_dimensions[k].lower);
+    return Interpolate(unit);
+  }
+  SolveState state(m_model);
+  state.Set_Tolerance(m_tolerance);
+  state.Set_Max_iterations(m_max_iterations);
+  Set_Known(state, point);
+  if (!state.Solve().converged)
+    throw std::runtime_error("The solve outside of the trusted region did not converge.");
+  return state.Get_Unknown_vector();
+}
+
+void Surrogate::Set_Known(SolveState &state, const Eigen::VectorXd &point) const {
+  for (size_t k = 0; k < m_dimensions.size(); ++k) {
+    if (m_dimensions[k].pressure)
+      state.Set_Known_Static_Pressure(m_dimensions[k].vertex, point(k) * si::pascals);
+    else
+      state.Set_Known_Speed(m_dimensions[k].vertex, point(k) * si::meters_per_second);
+  }
+}
+
+Eigen::VectorXd Surrogate::Interpolate(const Eigen::VectorXd &unit) const {
+  return Sum_surpluses(m_levels, m_indices, m_surpluses, unit);
+}
+
+double Surrogate::Get_Tolerance() const {
+  return m_tolerance;
+}
+
+void Surrogate::Set_Tolerance(double tolerance) {
+  m_tolerance = tolerance;
+}
+
+size_t Surrogate::Get_Max_iterations() const {
+  return m_max_iterations;
+}
+
+void Surrogate::Set_Max_iterations(size_t max_iterations) {
+  m_max_iterations = max_iterations;
+}
+}
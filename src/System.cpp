@@ -22,24 +22,45 @@
 //
 #include <algorithm>
 #include <numeric>
-#include <random>
+#include <tuple>
+#include <unordered_map>
 
 #include <Eigen/Eigen>
 #include <fluids/System.h>
+#include <fluids/MemoryReport.h>
 
 #include "../include/fluids/System.h"
 #include "TransportEdge.h"
+#include "InitialGuess.h"
+#include "Ordering.h"
 
 namespace Fluids {
 
-System::System() {
+namespace {
+/// Counter of the objects of a category on their way to the arena (to the heap without arena), it keeps the arena
+/// alive as long as the objects allocated through it
+std::shared_ptr<CountingResource> Make_counter(const Arena &arena) {
+  std::pmr::memory_resource *upstream = arena ? arena.get() : std::pmr::new_delete_resource();
+  return std::shared_ptr<CountingResource>(new CountingResource(upstream),
+                                           [arena](CountingResource *counter) { delete counter; });
+}
+}
+
+System::System() : m_liquid_bytes(Make_counter(nullptr)), m_edge_bytes(Make_counter(nullptr)) {
+
+}
+
+System::System(Liquid liquid, size_t num_vertices) : System(liquid, num_vertices, Make_arena()) {
 
 }
 
-System::System(Liquid liquid, size_t num_vertices) {
+System::System(Liquid liquid, size_t num_vertices, const Arena &arena)
+    : m_arena(arena), m_liquid_bytes(Make_counter(arena)), m_edge_bytes(Make_counter(arena)) {
+  const Arena liquids = m_liquid_bytes;
   for (size_t i = 0; i < num_vertices; ++i) {
     vertex_t u = boost::add_vertex(m_graph);
-    m_graph[u] = std::make_shared<Liquid>(liquid);
+    m_graph[u] = Make_shared<Liquid>(liquids, liquid, liquids);
+    m_vertices.push_back(u);
     m_unknown_speeds.push_back(m_graph[u]->Get_Speed());
     m_unknown_static_pressures.push_back(m_graph[u]->Get_Static_pressure());
   }
@@ -50,24 +71,25 @@ void System::add_FluidComponent(const std::shared_ptr<FluidComponents> &componen
                                 const size_t &vertex_v) {
   edge_t e;
   bool b;
-  vertex_t u = boost::vertex(vertex_u, m_graph);
-  vertex_t v = boost::vertex(vertex_v, m_graph);
+  vertex_t u = m_vertices.at(vertex_u);
+  vertex_t v = m_vertices.at(vertex_v);
   boost::tie(e, b) = boost::add_edge(u, v, m_graph);
   component->Set_Liquid(Vertex::u, m_graph[u]);
   component->Set_Liquid(Vertex::v, m_graph[v]);
   m_graph[e] = component;
+  ++m_topology_version;
 }
 
 std::shared_ptr<Liquid> &System::Get_Liquid(const size_t &vertex_u) {
-  vertex_t u = boost::vertex(vertex_u, m_graph);
+  vertex_t u = m_vertices.at(vertex_u);
   return m_graph[u];
 }
 
 std::shared_ptr<FluidComponents> &System::Get_Component(const size_t &vertex_u, const size_t &vertex_v) {
   edge_t e;
   bool b;
-  vertex_t u = boost::vertex(vertex_u, m_graph);
-  vertex_t v = boost::vertex(vertex_v, m_graph);
+  vertex_t u = m_vertices.at(vertex_u);
+  vertex_t v = m_vertices.at(vertex_v);
   boost::tie(e, b) = boost::edge(u, v, m_graph);
   return m_graph[e];
 }
@@ -86,10 +108,51 @@ void System::Set_Known_Static_Pressure(const size_t &vertex_u, const quantity<si
                                     m_unknown_static_pressures);
 }
 
-size_t System::n_unknowns() {
+void System::Set_Active(const size_t &vertex_u, const size_t &vertex_v, bool active) {
+  const std::shared_ptr<FluidComponents> &component = Get_Component(vertex_u, vertex_v);
+  if (!component)
+    throw std::logic_error("No component between the vertices.");
+  // The flow of a component is the speed of its first vertex, shared with every other edge leaving that vertex
+  if (!active && boost::out_degree(m_vertices.at(vertex_u), m_graph) > 1)
+    throw std::logic_error("A component whose first vertex branches can not be closed.");
+  component->Set_Active(active);
+}
+
+bool System::Is_Active(const size_t &vertex_u, const size_t &vertex_v) {
+  const std::shared_ptr<FluidComponents> &component = Get_Component(vertex_u, vertex_v);
+  if (!component)
+    throw std::logic_error("No component between the vertices.");
+  return component->Is_Active();
+}
+
+size_t System::n_unknowns() const {
   return m_unknown_speeds.size() + m_unknown_static_pressures.size() + m_unknown_volumetric_flows.size();
 }
 
+size_t System::n_residuals() const {
+  size_t n = 0;
+  auto es = boost::edges(m_graph);
+  for (auto eit = es.first; eit != es.second; ++eit) {
+    if (!m_graph[*eit]->isTransportEdge())
+      ++n;
+  }
+  auto vs = boost::vertices(m_graph);
+  for (auto vit = vs.first; vit != vs.second; ++vit) {
+    if (boost::in_degree(*vit, m_graph) == 0) {
+      continue;
+    } else if (boost::out_degree(*vit, m_graph) == 0) { // outlet continuity
+      typename boost::graph_traits<Graph>::in_edge_iterator ei, ei_end;
+      for (boost::tie(ei, ei_end) = boost::in_edges(*vit, m_graph); ei != ei_end; ++ei) {
+        if (m_graph[*ei]->isTransportEdge())
+          ++n;
+      }
+    } else { // mass balance
+      ++n;
+    }
+  }
+  return n;
+}
+
 const shared_velocity_vector &System::Get_Known_speeds() const {
   return m_known_speeds;
 }
@@ -124,31 +187,35 @@ const Eigen::VectorXd System::Get_Bernoulli_vec() const {
   for (auto eit = es.first; eit != es.second; ++eit) {
     if (m_graph[*eit]->isTransportEdge())
       continue;
-    values.push_back(m_graph[*eit]->Get_Bernoulli_balance()->value());
+    const std::shared_ptr<FluidComponents> &component = m_graph[*eit];
+    values.push_back(component->Is_Active() ? component->Get_Bernoulli_balance()->value()
+                                            : component->Get_Massflow()->value());
   }
   return Eigen::Map<Eigen::VectorXd>(values.data(), values.size());
 }
 
 const Eigen::VectorXd System::Get_massflow_vec() const {
   std::vector<double> values;
-  values.push_back(0.); // System massflow
   auto vs = boost::vertices(m_graph);
   edge_t e;
   bool b;
   for (auto vit = vs.first; vit != vs.second; ++vit) {
-    // Get system mass flows
-    if (boost::in_degree(*vit, m_graph) == 0) { // incoming system mass flow
-      typename boost::graph_traits<Graph>::out_edge_iterator eo, eo_end;
-      for (boost::tie(eo, eo_end) = boost::out_edges(*vit, m_graph); eo != eo_end; ++eo) {
-        boost::tie(e, b) = boost::edge(boost::source(*eo, m_graph), boost::target(*eo, m_graph), m_graph);
-        values[0] += m_graph[e]->Get_Massflow()->value();
-      }
+    if (boost::in_degree(*vit, m_graph) == 0) { // incoming system mass flow, balanced at the inlet vertex
       continue;
     } else if (boost::out_degree(*vit, m_graph) == 0) { // outgoing system mass flow
+      // The balance over the whole system is a linear combination of the vertex balances, instead close the outlet
+      // by relating the transported flow to the speed at the outlet vertex (continuity)
       typename boost::graph_traits<Graph>::in_edge_iterator ei, ei_end;
       for (boost::tie(ei, ei_end) = boost::in_edges(*vit, m_graph); ei != ei_end; ++ei) {
-        boost::tie(e, b) = boost::edge(boost::source(*ei, m_graph), boost::target(*ei, m_graph), m_graph);
-        values[0] -= m_graph[e]->Get_Massflow()->value();
+        if (!m_graph[*ei]->isTransportEdge())
+          continue;
+        vertex_t outlet = boost::source(*ei, m_graph);
+        values.push_back(m_graph[*ei]->Get_Massflow()->value());
+        typename boost::graph_traits<Graph>::in_edge_iterator oi, oi_end;
+        for (boost::tie(oi, oi_end) = boost::in_edges(outlet, m_graph); oi != oi_end; ++oi) {
+          values.back() -= (*m_graph[*oi]->Get_CrossSection() * *m_graph[outlet]->Get_Speed()
+              * *m_graph[outlet]->Get_Density()).value();
+        }
       }
       continue;
     }
@@ -170,6 +237,10 @@ const Eigen::VectorXd System::Get_massflow_vec() const {
 }
 
 void System::Initialize() {
+  if (m_initialized)
+    return;
+  m_initialized = true;
+  ++m_topology_version;
   auto vs = boost::vertices(m_graph);
   // Loop over all vertices, when it is a leaf-vertex connect a massflow vertex and transport edge, needed to solve
   std::array<std::vector<vertex_t>, 2> leafs;
@@ -183,17 +254,20 @@ void System::Initialize() {
   bool in_leaf = true;
   bool b;
   edge_t e;
+  const Arena liquids = m_liquid_bytes;
+  const Arena edges = m_edge_bytes;
   for (auto &&leaf : leafs) {
     for (auto &&v : leaf) {
       vertex_t u = boost::add_vertex(m_graph);
-      m_graph[u] = std::make_shared<Liquid>(*m_graph[v]);
+      m_graph[u] = Make_shared<Liquid>(liquids, *m_graph[v], liquids);
+      m_vertices.push_back(u);
       if (in_leaf) {
         boost::tie(e, b) = boost::add_edge(u, v, m_graph);
-        m_graph[e] = std::make_shared<TransportEdge>(m_graph[u], m_graph[v]);
+        m_graph[e] = Make_shared<TransportEdge>(edges, m_graph[u], m_graph[v], edges);
         m_unknown_volumetric_flows.push_back(m_graph[e]->Get_Volumetricflow());
       } else {
         boost::tie(e, b) = boost::add_edge(v, u, m_graph);
-        m_graph[e] = std::make_shared<TransportEdge>(m_graph[v], m_graph[u]);
+        m_graph[e] = Make_shared<TransportEdge>(edges, m_graph[v], m_graph[u], edges);
         m_unknown_volumetric_flows.push_back(m_graph[e]->Get_Volumetricflow());
       }
     }
@@ -201,27 +275,162 @@ void System::Initialize() {
   }
 }
 
+size_t System::Get_Topology_version() const {
+  return m_topology_version;
+}
+
+void System::Reorder() {
+  if (!m_initialized)
+    throw std::logic_error("Initialize the system before reordering it.");
+  std::unordered_map<vertex_t, size_t> index;
+  auto vs = boost::vertices(m_graph);
+  for (auto vit = vs.first; vit != vs.second; ++vit)
+    index.emplace(*vit, index.size());
+  std::vector<std::vector<size_t>> adjacency(index.size());
+  auto es = boost::edges(m_graph);
+  for (auto eit = es.first; eit != es.second; ++eit) {
+    const size_t u = index[boost::source(*eit, m_graph)];
+    const size_t v = index[boost::target(*eit, m_graph)];
+    adjacency[u].push_back(v);
+    adjacency[v].push_back(u);
+  }
+  Permute(Ordering::Reverse_cuthill_mckee(adjacency));
+}
+
+void System::Reorder(const Eigen::MatrixX2d &coordinates) {
+  if (!m_initialized)
+    throw std::logic_error("Initialize the system before reordering it.");
+  if (static_cast<size_t>(coordinates.rows()) > m_vertices.size())
+    throw std::logic_error("More coordinates than vertices.");
+  std::unordered_map<vertex_t, size_t> index;
+  auto vs = boost::vertices(m_graph);
+  for (auto vit = vs.first; vit != vs.second; ++vit)
+    index.emplace(*vit, index.size());
+  Eigen::MatrixX2d points(m_vertices.size(), 2);
+  std::vector<bool> placed(m_vertices.size(), false);
+  for (Eigen::Index id = 0; id < coordinates.rows(); ++id) {
+    const auto i = static_cast<Eigen::Index>(index[m_vertices[id]]);
+    points.row(i) = coordinates.row(id);
+    placed[i] = true;
+  }
+  // A vertex added by Initialize has a single transport edge to the vertex of which it is a copy
+  auto es = boost::edges(m_graph);
+  for (auto eit = es.first; eit != es.second; ++eit) {
+    const size_t u = index[boost::source(*eit, m_graph)];
+    const size_t v = index[boost::target(*eit, m_graph)];
+    if (!placed[u] && placed[v])
+      points.row(static_cast<Eigen::Index>(u)) = points.row(static_cast<Eigen::Index>(v));
+    else if (placed[u] && !placed[v])
+      points.row(static_cast<Eigen::Index>(v)) = points.row(static_cast<Eigen::Index>(u));
+    else
+      continue;
+    placed[u] = placed[v] = true;
+  }
+  if (std::find(placed.begin(), placed.end(), false) != placed.end())
+    throw std::logic_error("Coordinates are missing for a vertex.");
+  Permute(Ordering::Hilbert(points));
+}
+
+void System::Permute(const std::vector<size_t> &order) {
+  std::vector<vertex_t> stored;
+  auto vs = boost::vertices(m_graph);
+  for (auto vit = vs.first; vit != vs.second; ++vit)
+    stored.push_back(*vit);
+
+  Graph graph;
+  std::vector<vertex_t> created(order.size());
+  std::unordered_map<vertex_t, size_t> position;
+  for (size_t k = 0; k < order.size(); ++k) {
+    created[k] = boost::add_vertex(graph);
+    graph[created[k]] = m_graph[stored[order[k]]];
+    position[stored[order[k]]] = k;
+  }
+
+  // Edges by their first and then their second vertex in the new order, these are the Bernoulli rows
+  std::vector<std::tuple<size_t, size_t, size_t, std::shared_ptr<FluidComponents>>> edges;
+  auto es = boost::edges(m_graph);
+  for (auto eit = es.first; eit != es.second; ++eit) {
+    const size_t u = position[boost::source(*eit, m_graph)];
+    const size_t v = position[boost::target(*eit, m_graph)];
+    edges.emplace_back(std::min(u, v), std::max(u, v), u, m_graph[*eit]);
+  }
+  std::stable_sort(edges.begin(), edges.end(), [](const auto &a, const auto &b) {
+    return std::tie(std::get<0>(a), std::get<1>(a)) < std::tie(std::get<0>(b), std::get<1>(b));
+  });
+  std::unordered_map<const void *, size_t> flow_position;
+  for (auto &&edge : edges) {
+    const size_t u = std::get<2>(edge);
+    const size_t v = u == std::get<0>(edge) ? std::get<1>(edge) : std::get<0>(edge);
+    edge_t e;
+    bool b;
+    boost::tie(e, b) = boost::add_edge(created[u], created[v], graph);
+    graph[e] = std::get<3>(edge);
+    const size_t k = flow_position.size();
+    flow_position[graph[e]->Get_Volumetricflow().get()] = k;
+  }
+
+  // The assignment may copy the graph, the vertices are taken again in their new order
+  m_indices.resize(m_vertices.size());
+  for (size_t id = 0; id < m_vertices.size(); ++id)
+    m_indices[id] = position[m_vertices[id]];
+  m_graph = std::move(graph);
+  created.clear();
+  vs = boost::vertices(m_graph);
+  for (auto vit = vs.first; vit != vs.second; ++vit)
+    created.push_back(*vit);
+  for (size_t id = 0; id < m_vertices.size(); ++id)
+    m_vertices[id] = created[m_indices[id]];
+
+  // Unknowns and knowns in the order of their vertices and transport edges
+  std::unordered_map<const void *, size_t> vertex_position;
+  for (size_t k = 0; k < created.size(); ++k) {
+    vertex_position[m_graph[created[k]]->Get_Speed().get()] = k;
+    vertex_position[m_graph[created[k]]->Get_Static_pressure().get()] = k;
+  }
+  auto sort = [](auto &values, const std::unordered_map<const void *, size_t> &key) {
+    std::stable_sort(values.begin(), values.end(), [&key](const auto &a, const auto &b) {
+      return key.at(a.get()) < key.at(b.get());
+    });
+  };
+  sort(m_known_speeds, vertex_position);
+  sort(m_unknown_speeds, vertex_position);
+  sort(m_known_static_pressures, vertex_position);
+  sort(m_unknown_static_pressures, vertex_position);
+  sort(m_known_volumetric_flows, flow_position);
+  sort(m_unknown_volumetric_flows, flow_position);
+  ++m_topology_version;
+}
+
+size_t System::Get_Vertex_index(const size_t &vertex) const {
+  return vertex < m_indices.size() ? m_indices[vertex] : vertex;
+}
+
+const std::vector<size_t> &System::Get_Vertex_indices() const {
+  return m_indices;
+}
+
+const Arena &System::Get_Arena() const {
+  return m_arena;
+}
+
+bool System::Is_Initialized() const {
+  return m_initialized;
+}
+
 Eigen::VectorXd System::Get_Initial_vector() {
-  Eigen::VectorXd initial_vec(n_unknowns());
-  initial_values<si::velocity>(m_known_speeds,
-                               si::meters_per_second,
-                               initial_vec,
-                               0,
-                               m_unknown_speeds.size(),
-                               0.0, 10.0);
-  initial_values<si::pressure>(m_known_static_pressures,
-                               si::pascal,
-                               initial_vec,
-                               m_unknown_speeds.size(),
-                               m_unknown_speeds.size() + m_unknown_static_pressures.size(),
-                               1.0e5, 10.0e5);
-  initial_values<si::volumetric_flow>(m_known_volumetric_flows,
-                                      si::cubic_meters_per_second,
-                                      initial_vec,
-                                      m_unknown_speeds.size() + m_unknown_static_pressures.size(),
-                                      n_unknowns(),
-                                      1., 100.);
-  return initial_vec;
+  return InitialGuess(*this).Compute();
+}
+
+Eigen::VectorXd System::Get_Unknown_vector() const {
+  Eigen::VectorXd x(n_unknowns());
+  Eigen::Index k = 0;
+  for (auto &&s : m_unknown_speeds)
+    x(k++) = s->value();
+  for (auto &&p : m_unknown_static_pressures)
+    x(k++) = p->value();
+  for (auto &&q : m_unknown_volumetric_flows)
+    x(k++) = q->value();
+  return x;
 }
 
 const shared_volumetric_flow_vector &System::Get_Unknown_volumetric_flow() const {
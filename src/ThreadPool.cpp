@@ -0,0 +1,118 @@
+// MIT License
+//
+// Copyright (c) 2019 Jelle Spijker
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+
+#include <algorithm>
+
+#include <fluids/ThreadPool.h>
+
+namespace Fluids {
+
+ThreadPool::ThreadPool(size_t threads) {
+  threads = std::max<size_t>(threads, 1);
+  for (size_t i = 1; i < threads; ++i)
+    m_workers.emplace_back(&ThreadPool::Work, this);
+}
+
+ThreadPool::~ThreadPool() {
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_stop = true;
+  }
+  m_wake.notify_all();
+  for (auto &&worker : m_workers)
+    worker.join();
+}
+
+size_t ThreadPool::Get_Threads() const {
+  return m_workers.size() + 1;
+}
+
+size_t ThreadPool::Chunks(size_t n, size_t grain) const {
+  grain = std::max<size_t>(grain, 1);
+  return std::max<size_t>(std::min(Get_Threads(), (n + grain - 1) / grain), 1);
+}
+
+void ThreadPool::Parallel_for(size_t n, const Task &task, size_t grain) {
+  if (n == 0)
+    return;
+  const size_t chunks = Chunks(n, grain);
+  if (chunks == 1) {
+    task(0, n, 0);
+    return;
+  }
+  std::unique_lock<std::mutex> lock(m_mutex);
+  // One loop at a time, a second caller waits until the pool is free
+  m_done.wait(lock, [this]() { return m_task == nullptr; });
+  m_task = &task;
+  m_n = n;
+  m_chunks = chunks;
+  m_next = 0;
+  m_running = chunks;
+  m_exception = nullptr;
+  ++m_generation;
+  m_wake.notify_all();
+  while (Run_chunk(lock)) {}
+  m_done.wait(lock, [this]() { return m_running == 0; });
+  m_task = nullptr;
+  std::exception_ptr exception = m_exception;
+  m_exception = nullptr;
+  lock.unlock();
+  m_done.notify_all();
+  if (exception)
+    std::rethrow_exception(exception);
+}
+
+bool ThreadPool::Run_chunk(std::unique_lock<std::mutex> &lock) {
+  if (m_task == nullptr || m_next >= m_chunks)
+    return false;
+  const size_t chunk = m_next++;
+  const Task &task = *m_task;
+  const size_t begin = chunk * m_n / m_chunks;
+  const size_t end = (chunk + 1) * m_n / m_chunks;
+  lock.unlock();
+  std::exception_ptr exception;
+  try {
+    task(begin, end, chunk);
+  } catch (...) {
+    exception = std::current_exception();
+  }
+  lock.lock();
+  if (exception && !m_exception)
+    m_exception = exception;
+  if (--m_running == 0)
+    m_done.notify_all();
+  return true;
+}
+
+void ThreadPool::Work() {
+  std::unique_lock<std::mutex> lock(m_mutex);
+  size_t generation = 0;
+  while (true) {
+    m_wake.wait(lock, [&]() { return m_stop || (m_generation != generation && m_task != nullptr); });
+    if (m_stop)
+      return;
+    generation = m_generation;
+    while (Run_chunk(lock)) {}
+  }
+}
+}
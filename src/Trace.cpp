@@ -0,0 +1,115 @@
+// MIT License
+//
+// Copyright (c) 2019 Jelle Spijker
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <string>
+
+#include <fluids/Trace.h>
+
+namespace Fluids {
+
+namespace {
+struct Buffer {
+  std::atomic<bool> enabled{false};
+  std::atomic<std::uint64_t> next{0}; //! Events recorded since the last clear
+  std::vector<Trace::Event> events = std::vector<Trace::Event>(1 << 16);
+  const std::chrono::steady_clock::time_point epoch = std::chrono::steady_clock::now();
+  std::atomic<std::uint32_t> threads{0};
+};
+
+Buffer &Get_Buffer() {
+  static Buffer buffer;
+  return buffer;
+}
+
+std::uint32_t Thread_id() {
+  thread_local const std::uint32_t id = Get_Buffer().threads++;
+  return id;
+}
+}
+
+void Trace::Enable(bool enabled) {
+  Get_Buffer().enabled.store(enabled, std::memory_order_relaxed);
+}
+
+bool Trace::Is_Enabled() {
+  return Get_Buffer().enabled.load(std::memory_order_relaxed);
+}
+
+void Trace::Set_Capacity(size_t capacity) {
+  Buffer &buffer = Get_Buffer();
+  buffer.events.assign(std::max<size_t>(capacity, 1), Event());
+  buffer.next = 0;
+}
+
+size_t Trace::Get_Capacity() {
+  return Get_Buffer().events.size();
+}
+
+void Trace::Clear() {
+  Get_Buffer().next = 0;
+}
+
+void Trace::Record(const char *name, std::int64_t begin, std::int64_t end) {
+  Buffer &buffer = Get_Buffer();
+  if (!buffer.enabled.load(std::memory_order_relaxed))
+    return;
+  const std::uint64_t slot = buffer.next.fetch_add(1, std::memory_order_relaxed) % buffer.events.size();
+  buffer.events[slot] = Event{name, begin, end - begin, Thread_id()};
+}
+
+std::vector<Trace::Event> Trace::Get_Events() {
+  const Buffer &buffer = Get_Buffer();
+  const std::uint64_t recorded = buffer.next.load();
+  const std::uint64_t capacity = buffer.events.size();
+  std::vector<Event> events;
+  events.reserve(static_cast<size_t>(std::min(recorded, capacity)));
+  for (std::uint64_t i = recorded > capacity ? recorded - capacity : 0; i < recorded; ++i)
+    events.push_back(buffer.events[i % capacity]);
+  return events;
+}
+
+size_t Trace::n_recorded() {
+  return static_cast<size_t>(Get_Buffer().next.load());
+}
+
+void Trace::Export_chrome(std::ostream &out) {
+  out << "{\"traceEvents\":[";
+  bool first = true;
+  for (auto &&event : Get_Events()) {
+    // Timestamps and durations in microseconds
+    out << (first ? "\n" : ",\n") << "{\"name\":\"" << event.name << "\",\"cat\":\"fluids\",\"ph\":\"X\",\"ts\":"
+        << std::to_string(1.e-3 * static_cast<double>(event.begin)) << ",\"dur\":"
+        << std::to_string(1.e-3 * static_cast<double>(event.duration)) << ",\"pid\":1,\"tid\":" << event.thread << '}';
+    first = false;
+  }
+  out << "\n],\"displayTimeUnit\":\"ns\"}\n";
+}
+
+std::int64_t Trace::Now() {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now()
+                                                                  - Get_Buffer().epoch).count();
+}
+}
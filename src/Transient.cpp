@@ -0,0 +1,255 @@
+// MIT License
+//
+// Copyright (c) 2019 Jelle Spijker
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+#include <unordered_map>
+
+#include <fluids/Pipes.h>
+#include <fluids/Transient.h>
+
+namespace Fluids {
+
+namespace {
+/// Compatibility relation along the C+ characteristic, p = Cp - B Q at the next time level
+inline double Plus(double pressure, double flow, double impedance, double resistance) {
+  return pressure + impedance * flow - resistance * flow * std::abs(flow);
+}
+
+/// Compatibility relation along the C- characteristic, p = Cm + B Q at the next time level
+inline double Minus(double pressure, double flow, double impedance, double resistance) {
+  return pressure - impedance * flow + resistance * flow * std::abs(flow);
+}
+}
+
+Transient::Transient(const std::shared_ptr<System> &system, const quantity<si::velocity> &wave_speed,
+                     const quantity<si::time> &time_step) : m_time_step(time_step.value()) {
+  if (wave_speed.value() <= 0. || m_time_step <= 0.)
+    throw std::logic_error("Wave speed and time step should be positive.");
+  const Graph &graph = system->Get_Graph();
+
+  std::unordered_map<vertex_t, size_t> vertex_id;
+  std::unordered_map<const void *, bool> known_pressure;
+  for (auto &&p : system->Get_Known_static_pressures())
+    known_pressure[p.get()] = true;
+  // Nodes by vertex id, the storage order differs once the system is reordered
+  m_nodes.resize(boost::num_vertices(graph));
+  std::vector<size_t> ids(m_nodes.size());
+  for (size_t id = 0; id < ids.size(); ++id)
+    ids[system->Get_Vertex_index(id)] = id;
+  size_t index = 0;
+  auto vs = boost::vertices(graph);
+  for (auto vit = vs.first; vit != vs.second; ++vit) {
+    const Liquid &liquid = *graph[*vit];
+    vertex_id[*vit] = ids[index++];
+    Node &node = m_nodes[vertex_id[*vit]];
+    node.reservoir = known_pressure.count(liquid.Get_Static_pressure().get()) > 0;
+    node.potential = liquid.Get_Potential_pressure()->value();
+    node.pressure = liquid.Get_Static_pressure()->value() + node.potential;
+  }
+
+  Eigen::Index points = 0;
+  std::vector<double> initial_flow;
+  auto es = boost::edges(graph);
+  for (auto eit = es.first; eit != es.second; ++eit) {
+    if (graph[*eit]->isTransportEdge())
+      continue;
+    auto component = std::dynamic_pointer_cast<Pipes>(graph[*eit]);
+    if (!component)
+      throw std::logic_error("Transient analysis only supports pipes.");
+    Pipe pipe;
+    pipe.u = vertex_id[boost::source(*eit, graph)];
+    pipe.v = vertex_id[boost::target(*eit, graph)];
+    const double length = component->Get_Length()->value();
+    const double area = component->Get_CrossSection()->value();
+    const double density = component->Get_Liquid(Vertex::u)->Get_Density()->value();
+    pipe.reaches = std::max<Eigen::Index>(1, std::lround(length / (wave_speed.value() * m_time_step)));
+    const double adjusted_speed = length / (static_cast<double>(pipe.reaches) * m_time_step);
+    if (std::abs(adjusted_speed / wave_speed.value() - 1.) > Max_speed_adjustment)
+      throw std::logic_error("The time step is too large to fit the reaches of a pipe to the wave speed.");
+    pipe.impedance = density * adjusted_speed / area;
+    pipe.offset = points;
+    points += pipe.reaches + 1;
+
+    const double flow = area * component->Get_Liquid(Vertex::u)->Get_Speed()->value();
+    const double drop = m_nodes[pipe.u].pressure - m_nodes[pipe.v].pressure;
+    if (std::abs(flow) > 1.e-12) {
+      pipe.resistance = drop / (flow * std::abs(flow) * static_cast<double>(pipe.reaches));
+    } else { // No flow to calibrate with, use the fully rough friction factor
+      const double diameter = component->Get_Diameter()->value();
+      const double f = Pipes::Haaland(quantity<si::dimensionless>(1.e8), *component->Get_Relative_roughness()).value();
+      pipe.resistance = f * length / static_cast<double>(pipe.reaches) * density / (2. * diameter * area * area);
+    }
+    m_nodes[pipe.u].out.push_back(m_pipes.size());
+    m_nodes[pipe.v].in.push_back(m_pipes.size());
+    m_nodes[pipe.u].external_flow -= flow;
+    m_nodes[pipe.v].external_flow += flow;
+    initial_flow.push_back(flow);
+    m_pipes.push_back(pipe);
+  }
+
+  // Steady state: constant flow and a linear pressure along every pipe
+  m_pressure.resize(points);
+  m_flow.resize(points);
+  for (size_t k = 0; k < m_pipes.size(); ++k) {
+    const Pipe &pipe = m_pipes[k];
+    m_pressure.segment(pipe.offset, pipe.reaches + 1) =
+        Eigen::ArrayXd::LinSpaced(pipe.reaches + 1, m_nodes[pipe.u].pressure, m_nodes[pipe.v].pressure);
+    m_flow.segment(pipe.offset, pipe.reaches + 1).setConstant(initial_flow[k]);
+  }
+  m_pressure_new = m_pressure;
+  m_flow_new = m_flow;
+}
+
+void Transient::Set_Flow_schedule(const size_t &vertex, const Schedule &schedule) {
+  Node &node = m_nodes.at(vertex);
+  if (node.in.empty() && node.out.empty())
+    throw std::logic_error("Vertex is not connected to a pipe.");
+  node.reservoir = false;
+  node.schedule = schedule;
+}
+
+void Transient::Step() {
+  const double time = static_cast<double>(m_steps + 1) * m_time_step;
+
+  // Interior points, C+ from the left neighbour and C- from the right neighbour
+  auto interior = [this](size_t begin, size_t end, size_t) {
+    for (size_t k = begin; k < end; ++k) {
+      const Pipe &pipe = m_pipes[k];
+      const Eigen::Index n = pipe.reaches - 1;
+      if (n <= 0)
+        continue;
+      auto pa = m_pressure.segment(pipe.offset, n);
+      auto qa = m_flow.segment(pipe.offset, n);
+      auto pb = m_pressure.segment(pipe.offset + 2, n);
+      auto qb = m_flow.segment(pipe.offset + 2, n);
+      const double b = pipe.impedance;
+      const double r = pipe.resistance;
+      auto cp = pa + b * qa - r * qa * qa.abs();
+      auto cm = pb - b * qb + r * qb * qb.abs();
+      m_pressure_new.segment(pipe.offset + 1, n) = 0.5 * (cp + cm);
+      m_flow_new.segment(pipe.offset + 1, n) = (cp - cm) / (2. * b);
+    }
+  };
+  // Vertices, the end points of every pipe belong to one vertex
+  auto junctions = [this, time](size_t begin, size_t end, size_t) {
+    for (size_t i = begin; i < end; ++i) {
+      Node &node = m_nodes[i];
+      if (node.in.empty() && node.out.empty())
+        continue;
+      // C+ of the pipes ending here and C- of the pipes starting here
+      double sum_c = 0.;
+      double sum_inverse = 0.;
+      for (auto &&k : node.in) {
+        const Pipe &pipe = m_pipes[k];
+        const Eigen::Index a = pipe.offset + pipe.reaches - 1;
+        sum_c += Plus(m_pressure(a), m_flow(a), pipe.impedance, pipe.resistance) / pipe.impedance;
+        sum_inverse += 1. / pipe.impedance;
+      }
+      for (auto &&k : node.out) {
+        const Pipe &pipe = m_pipes[k];
+        const Eigen::Index b = pipe.offset + 1;
+        sum_c += Minus(m_pressure(b), m_flow(b), pipe.impedance, pipe.resistance) / pipe.impedance;
+        sum_inverse += 1. / pipe.impedance;
+      }
+      if (!node.reservoir) {
+        double external = node.external_flow;
+        if (node.schedule)
+          external *= node.schedule(time * si::seconds);
+        node.pressure = (sum_c - external) / sum_inverse;
+      }
+      for (auto &&k : node.in) {
+        const Pipe &pipe = m_pipes[k];
+        const Eigen::Index a = pipe.offset + pipe.reaches - 1;
+        const double cp = Plus(m_pressure(a), m_flow(a), pipe.impedance, pipe.resistance);
+        m_pressure_new(a + 1) = node.pressure;
+        m_flow_new(a + 1) = (cp - node.pressure) / pipe.impedance;
+      }
+      for (auto &&k : node.out) {
+        const Pipe &pipe = m_pipes[k];
+        const Eigen::Index b = pipe.offset + 1;
+        const double cm = Minus(m_pressure(b), m_flow(b), pipe.impedance, pipe.resistance);
+        m_pressure_new(b - 1) = node.pressure;
+        m_flow_new(b - 1) = (node.pressure - cm) / pipe.impedance;
+      }
+    }
+  };
+  if (m_pool) {
+    m_pool->Parallel_for(m_pipes.size(), interior, 64);
+    m_pool->Parallel_for(m_nodes.size(), junctions, 256);
+  } else {
+    interior(0, m_pipes.size(), 0);
+    junctions(0, m_nodes.size(), 0);
+  }
+  m_pressure.swap(m_pressure_new);
+  m_flow.swap(m_flow_new);
+  ++m_steps;
+}
+
+void Transient::Run(const quantity<si::time> &duration, const std::function<void(const Transient &)> &callback) {
+  const auto steps = static_cast<size_t>(std::ceil(duration.value() / m_time_step - 1.e-9));
+  for (size_t k = 0; k < steps; ++k) {
+    Step();
+    if (callback)
+      callback(*this);
+  }
+}
+
+quantity<si::time> Transient::Get_Time() const {
+  return static_cast<double>(m_steps) * m_time_step * si::seconds;
+}
+
+quantity<si::time> Transient::Get_Time_step() const {
+  return m_time_step * si::seconds;
+}
+
+quantity<si::pressure> Transient::Get_Static_pressure(const size_t &vertex) const {
+  const Node &node = m_nodes.at(vertex);
+  return (node.pressure - node.potential) * si::pascals;
+}
+
+quantity<si::volumetric_flow> Transient::Get_Volumetricflow(const size_t &vertex_u, const size_t &vertex_v) const {
+  return m_flow(m_pipes[Pipe_index(vertex_u, vertex_v)].offset) * si::cubic_meters_per_second;
+}
+
+size_t Transient::Get_Reaches(const size_t &vertex_u, const size_t &vertex_v) const {
+  return static_cast<size_t>(m_pipes[Pipe_index(vertex_u, vertex_v)].reaches);
+}
+
+size_t Transient::Pipe_index(const size_t &vertex_u, const size_t &vertex_v) const {
+  for (size_t k = 0; k < m_pipes.size(); ++k) {
+    if (m_pipes[k].u == vertex_u && m_pipes[k].v == vertex_v)
+      return k;
+  }
+  throw std::logic_error("No pipe between the vertices.");
+}
+
+const std::shared_ptr<ThreadPool> &Transient::Get_Thread_pool() const {
+  return m_pool;
+}
+
+void Transient::Set_Thread_pool(const std::shared_ptr<ThreadPool> &pool) {
+  m_pool = pool;
+}
+}
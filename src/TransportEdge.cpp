@@ -33,6 +33,13 @@ TransportEdge::TransportEdge(const std::shared_ptr<Liquid> &liquid_u, const std:
     : FluidComponents(liquid_u, liquid_v) {
 
 }
+
+TransportEdge::TransportEdge(const std::shared_ptr<Liquid> &liquid_u, const std::shared_ptr<Liquid> &liquid_v,
+                             const Arena &arena)
+    : FluidComponents(liquid_u, liquid_v, arena) {
+
+}
+
 TransportEdge::TransportEdge(const FluidComponents &other) : FluidComponents(other) {
 
 }
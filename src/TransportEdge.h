@@ -31,6 +31,8 @@ class TransportEdge : public FluidComponents {
 public:
   TransportEdge();
   TransportEdge(const std::shared_ptr<Liquid> &liquid_u, const std::shared_ptr<Liquid> &liquid_v);
+  TransportEdge(const std::shared_ptr<Liquid> &liquid_u, const std::shared_ptr<Liquid> &liquid_v,
+                const Arena &arena);
   explicit TransportEdge(const FluidComponents &other);
 
   ~TransportEdge() override = default;
@@ -21,8 +21,22 @@
 // SOFTWARE.
 //
 
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
 #include <memory>
+#include <new>
+#include <numeric>
+#include <random>
+#include <sstream>
+#include <fstream>
+#include <limits>
 #include <iostream>
+#include <thread>
+#include <vector>
 
 #include <gtest/gtest.h>
 
@@ -30,6 +44,46 @@
 #include <fluids/Pipes.h>
 #include <fluids/System.h>
 #include <fluids/Solver.h>
+#include <fluids/SolverStrategy.h>
+#include <fluids/Continuation.h>
+#include <fluids/Sensitivity.h>
+#include <fluids/Ensemble.h>
+#include <fluids/Model.h>
+#include <fluids/ThreadPool.h>
+#include <fluids/ExtendedPeriod.h>
+#include <fluids/Transient.h>
+#include <fluids/FixedSizeSolver.h>
+#include <fluids/SolutionCache.h>
+#include <fluids/Surrogate.h>
+#include <fluids/LoopFlow.h>
+#include <fluids/IncrementalSolver.h>
+#include <fluids/Snapshot.h>
+#include <fluids/Trace.h>
+#include <fluids/MemoryReport.h>
+#include <fluids/Arena.h>
+#include <fluids/Checkpoint.h>
+#include <fluids/Service.h>
+
+#include "SparseJacobian.h"
+#include "Functor.h"
+
+// Heap allocations of the process, to check the allocation free paths
+static std::atomic<size_t> g_allocations{0};
+
+void *operator new(std::size_t size) {
+  ++g_allocations;
+  if (void *p = std::malloc(size ? size : 1))
+    return p;
+  throw std::bad_alloc();
+}
+
+void operator delete(void *p) noexcept {
+  std::free(p);
+}
+
+void operator delete(void *p, std::size_t) noexcept {
+  std::free(p);
+}
 
 TEST(LiquidTest, StandardWater) {
   Fluids::Liquid water;
@@ -166,4 +220,1365 @@ TEST(SolverTest, SimpleSystem) {
   solver.Solve();
   std::cout << *sys->Get_Liquid(1)->Get_Static_pressure() << std::endl;
   std::cout << *sys->Get_Liquid(1)->Get_Speed() << std::endl;
-}
\ No newline at end of file
+}
+TEST(InitialGuessTest, Deterministic) {
+  Fluids::Liquid water;
+  auto sys = std::make_shared<Fluids::System>(water, 4);
+  for (size_t i = 0; i < 3; ++i) {
+    sys->add_FluidComponent(std::make_shared<Fluids::Pipes>(0.2 * si::meter, 10. * si::meter, 4.6e-5 * si::meters),
+                            i, i + 1);
+  }
+  sys->Initialize();
+  sys->Set_Known_Speed(0, 2. * si::meters_per_second);
+  sys->Set_Known_Static_Pressure(0, static_cast<quantity<si::pressure>>(2. * si::bar));
+  Eigen::VectorXd first = sys->Get_Initial_vector();
+  Eigen::VectorXd second = sys->Get_Initial_vector();
+  ASSERT_EQ(first.size(), static_cast<long>(sys->n_unknowns()));
+  ASSERT_TRUE(first.isApprox(second));
+  // Speeds follow from the known inlet flow, pressures drop along the pipes
+  for (size_t i = 0; i < sys->Get_Unknown_speeds().size(); ++i) {
+    ASSERT_NEAR(first(i), 2., 1e-6);
+  }
+  size_t offset = sys->Get_Unknown_speeds().size();
+  ASSERT_LT(first(offset), 2.e5);
+  ASSERT_LT(first(offset + 1), first(offset));
+}
+
+TEST(InitialGuessTest, InterpolatesPressures) {
+  Fluids::Liquid water;
+  auto sys = std::make_shared<Fluids::System>(water, 6);
+  for (size_t i = 0; i < 5; ++i) {
+    sys->add_FluidComponent(std::make_shared<Fluids::Pipes>(0.2 * si::meter, 10. * si::meter, 4.6e-5 * si::meters),
+                            i, i + 1);
+  }
+  sys->Initialize();
+  sys->Set_Known_Static_Pressure(0, static_cast<quantity<si::pressure>>(2. * si::bar));
+  sys->Set_Known_Static_Pressure(5, static_cast<quantity<si::pressure>>(1. * si::bar));
+  Eigen::VectorXd initial = sys->Get_Initial_vector();
+  size_t offset = sys->Get_Unknown_speeds().size();
+  double previous = 2.e5;
+  for (size_t i = 0; i < sys->Get_Unknown_static_pressures().size(); ++i) {
+    ASSERT_LT(initial(offset + i), previous);
+    ASSERT_GT(initial(offset + i), 1.e5);
+    previous = initial(offset + i);
+  }
+  // Equal pipes, so the pressure is interpolated linearly
+  ASSERT_NEAR(initial(offset), 1.8e5, 1.);
+  ASSERT_GT(initial(0), 0.);
+}
+
+TEST(SolverTest, PressureDrivenChain) {
+  Fluids::Liquid water;
+  auto sys = std::make_shared<Fluids::System>(water, 4);
+  for (size_t i = 0; i < 3; ++i) {
+    sys->add_FluidComponent(std::make_shared<Fluids::Pipes>(0.2 * si::meter, 10. * si::meter, 4.6e-5 * si::meters),
+                            i, i + 1);
+  }
+  sys->Set_Known_Static_Pressure(0, static_cast<quantity<si::pressure>>(1.1 * si::bar));
+  sys->Set_Known_Static_Pressure(3, static_cast<quantity<si::pressure>>(1. * si::bar));
+  Fluids::Solver solver(sys);
+  solver.Solve();
+  ASSERT_TRUE(sys->Is_Initialized());
+  ASSERT_LT(sys->Get_Return_vec().norm(), 1e-6);
+  ASSERT_GT(sys->Get_Liquid(0)->Get_Speed()->value(), 0.);
+  ASSERT_NEAR(sys->Get_Liquid(1)->Get_Speed()->value(), sys->Get_Liquid(0)->Get_Speed()->value(), 1e-8);
+  ASSERT_LT(sys->Get_Liquid(2)->Get_Static_pressure()->value(), sys->Get_Liquid(1)->Get_Static_pressure()->value());
+}
+
+std::shared_ptr<Fluids::System> Make_chain(size_t n_pipes) {
+  Fluids::Liquid water;
+  auto sys = std::make_shared<Fluids::System>(water, n_pipes + 1);
+  for (size_t i = 0; i < n_pipes; ++i) {
+    auto diameter = (0.15 + 0.05 * (i % 3)) * si::meter;
+    sys->add_FluidComponent(std::make_shared<Fluids::Pipes>(diameter, 10. * si::meter, 4.6e-5 * si::meters), i, i + 1);
+  }
+  sys->Initialize();
+  sys->Set_Known_Static_Pressure(0, static_cast<quantity<si::pressure>>(1.5 * si::bar));
+  sys->Set_Known_Static_Pressure(n_pipes, static_cast<quantity<si::pressure>>(1. * si::bar));
+  return sys;
+}
+
+TEST(SolverStrategyTest, NewtonConverges) {
+  auto sys = Make_chain(6);
+  auto newton = std::make_shared<Fluids::NewtonStrategy>();
+  Eigen::VectorXd x = sys->Get_Initial_vector() * 1.2;
+  auto statistics = newton->Solve(sys, x);
+  ASSERT_TRUE(statistics.converged);
+  ASSERT_EQ(statistics.factorizations, statistics.iterations);
+  ASSERT_EQ(statistics.factorizations_saved, 0u);
+}
+
+TEST(SolverStrategyTest, BroydenReusesFactorization) {
+  for (auto update : {Fluids::BroydenStrategy::Update::Broyden, Fluids::BroydenStrategy::Update::Chord}) {
+    auto sys = Make_chain(6);
+    auto broyden = std::make_shared<Fluids::BroydenStrategy>(update);
+    broyden->Set_Slowdown(0.9);
+    Eigen::VectorXd x = sys->Get_Initial_vector() * 1.2;
+    auto statistics = broyden->Solve(sys, x);
+    ASSERT_TRUE(statistics.converged);
+    ASSERT_LT(statistics.factorizations, statistics.iterations);
+    ASSERT_EQ(statistics.factorizations_saved, statistics.iterations - statistics.factorizations);
+    ASSERT_LT(sys->Get_Return_vec().norm(), 1e-6);
+  }
+}
+
+TEST(SolverStrategyTest, SolverUsesStrategy) {
+  auto sys = Make_chain(4);
+  auto reference = Make_chain(4);
+  Fluids::Solver solver(sys, std::make_shared<Fluids::BroydenStrategy>());
+  solver.Solve();
+  Fluids::Solver hybrid(reference);
+  hybrid.Solve();
+  ASSERT_TRUE(solver.Get_Statistics().converged);
+  ASSERT_TRUE(hybrid.Get_Statistics().converged);
+  for (size_t i = 0; i < 5; ++i) {
+    ASSERT_NEAR(sys->Get_Liquid(i)->Get_Static_pressure()->value(),
+                reference->Get_Liquid(i)->Get_Static_pressure()->value(), 1e-3);
+    ASSERT_NEAR(sys->Get_Liquid(i)->Get_Speed()->value(), reference->Get_Liquid(i)->Get_Speed()->value(), 1e-6);
+  }
+}
+
+TEST(SparseNewtonTest, ReusesSymbolicAnalysis) {
+  auto sys = Make_chain(8);
+  auto strategy = std::make_shared<Fluids::SparseNewtonStrategy>();
+  Fluids::Solver solver(sys, strategy);
+  solver.Solve();
+  ASSERT_TRUE(solver.Get_Statistics().converged);
+  ASSERT_EQ(solver.Get_Statistics().symbolic_analyses, 1u);
+  // Same topology, new boundary value: numeric refactorization only
+  sys->Set_Known_Static_Pressure(0, static_cast<quantity<si::pressure>>(1.7 * si::bar));
+  solver.Solve();
+  ASSERT_TRUE(solver.Get_Statistics().converged);
+  ASSERT_EQ(solver.Get_Statistics().symbolic_analyses, 0u);
+  ASSERT_EQ(strategy->Get_Symbolic_analyses(), 1u);
+
+  auto reference = Make_chain(8);
+  reference->Set_Known_Static_Pressure(0, static_cast<quantity<si::pressure>>(1.7 * si::bar));
+  Fluids::Solver dense(reference, std::make_shared<Fluids::NewtonStrategy>());
+  dense.Solve();
+  for (size_t i = 0; i < 9; ++i) {
+    ASSERT_NEAR(sys->Get_Liquid(i)->Get_Static_pressure()->value(),
+                reference->Get_Liquid(i)->Get_Static_pressure()->value(), 1e-3);
+  }
+}
+
+TEST(SparseNewtonTest, TopologyChangeInvalidatesAnalysis) {
+  auto sys = Make_chain(4);
+  auto other = Make_chain(5);
+  auto strategy = std::make_shared<Fluids::SparseNewtonStrategy>();
+  Fluids::Solver solver(sys, strategy);
+  solver.Solve();
+  solver.Solve(other);
+  ASSERT_EQ(solver.Get_Statistics().symbolic_analyses, 1u);
+  ASSERT_TRUE(solver.Get_Statistics().converged);
+  ASSERT_EQ(strategy->Get_Symbolic_analyses(), 2u);
+
+  // Boundary values keep the version, changing the known/unknown partition does not
+  auto version = sys->Get_Topology_version();
+  sys->Set_Known_Static_Pressure(0, static_cast<quantity<si::pressure>>(1.6 * si::bar));
+  ASSERT_EQ(sys->Get_Topology_version(), version);
+  sys->Set_Known_Speed(0, *sys->Get_Liquid(0)->Get_Speed());
+  ASSERT_NE(sys->Get_Topology_version(), version);
+}
+
+TEST(SparseJacobianTest, RebuildsStalePattern) {
+  auto sys = Make_chain(5);
+  Fluids::SparseJacobian jacobian(sys);
+  ASSERT_EQ(sys.use_count(), 1);
+  Fluids::System_Functor_Base func(sys);
+  Eigen::VectorXd x = sys->Get_Initial_vector();
+  Eigen::VectorXd residual(func.values());
+  func(x, residual);
+  jacobian.Evaluate(x, residual);
+
+  // A known speed removes a column, the colouring of the old pattern is stale
+  sys->Set_Known_Speed(0, 1. * si::meters_per_second);
+  ASSERT_NE(jacobian.Get_Topology_version(), sys->Get_Topology_version());
+  Fluids::System_Functor_Base changed(sys);
+  x = sys->Get_Initial_vector();
+  residual.resize(changed.values());
+  changed(x, residual);
+  jacobian.Evaluate(x, residual);
+  ASSERT_EQ(jacobian.Get_Topology_version(), sys->Get_Topology_version());
+  const Eigen::SparseMatrix<double> &matrix = jacobian.Get_Matrix();
+  ASSERT_EQ(matrix.cols(), x.size());
+
+  // Every entry matches a one column finite difference, the other derivatives are zero
+  const double epsilon = std::sqrt(std::numeric_limits<double>::epsilon());
+  Eigen::VectorXd perturbed(residual.size());
+  for (Eigen::Index j = 0; j < x.size(); ++j) {
+    Eigen::VectorXd x_perturbed = x;
+    x_perturbed(j) += epsilon * std::max(std::abs(x(j)), 1.);
+    changed(x_perturbed, perturbed);
+    Eigen::VectorXd column = (perturbed - residual) / (x_perturbed(j) - x(j));
+    for (Eigen::Index i = 0; i < column.size(); ++i)
+      ASSERT_NEAR(matrix.coeff(i, j), column(i), 1e-6 * std::max(std::abs(column(i)), 1.));
+  }
+
+  // The Jacobian does not keep the system alive
+  func.Set_System(nullptr);
+  changed.Set_System(nullptr);
+  sys.reset();
+  ASSERT_THROW(jacobian.Evaluate(x, residual), std::logic_error);
+}
+
+TEST(NewtonKrylovTest, MatrixFreeConverges) {
+  size_t unpreconditioned = 0;
+  for (auto preconditioner : {Fluids::NewtonKrylovStrategy::Preconditioner::None,
+                              Fluids::NewtonKrylovStrategy::Preconditioner::BlockJacobi,
+                              Fluids::NewtonKrylovStrategy::Preconditioner::IncompleteLU}) {
+    auto sys = Make_chain(12);
+    auto reference = Make_chain(12);
+    Fluids::Solver solver(sys, std::make_shared<Fluids::NewtonKrylovStrategy>(preconditioner));
+    solver.Solve();
+    Fluids::Solver sparse(reference, std::make_shared<Fluids::SparseNewtonStrategy>());
+    sparse.Solve();
+    ASSERT_TRUE(solver.Get_Statistics().converged);
+    ASSERT_GT(solver.Get_Statistics().linear_iterations, 0u);
+    // Both preconditioners cut the Krylov iterations of the unpreconditioned solve
+    if (preconditioner == Fluids::NewtonKrylovStrategy::Preconditioner::None)
+      unpreconditioned = solver.Get_Statistics().linear_iterations;
+    else
+      ASSERT_LT(solver.Get_Statistics().linear_iterations, unpreconditioned);
+    for (size_t i = 0; i < 13; ++i) {
+      ASSERT_NEAR(sys->Get_Liquid(i)->Get_Static_pressure()->value(),
+                  reference->Get_Liquid(i)->Get_Static_pressure()->value(), 1e-2);
+    }
+  }
+}
+
+TEST(ContinuationTest, SupplyPressureSweep) {
+  auto sys = Make_chain(6);
+  Fluids::Continuation continuation(sys, [](Fluids::System &system, double pressure) {
+    system.Set_Known_Static_Pressure(0, pressure * si::pascals);
+  });
+  std::vector<double> path;
+  for (size_t i = 0; i <= 10; ++i)
+    path.push_back(1.2e5 + i * 0.1e5);
+  auto curve = continuation.Trace(path);
+  ASSERT_TRUE(continuation.Get_Statistics().converged);
+  ASSERT_EQ(continuation.Get_Statistics().symbolic_analyses, 1u);
+
+  size_t independent_factorizations = 0;
+  size_t k = 0;
+  for (auto &&point : curve) {
+    if (!point.requested)
+      continue;
+    ASSERT_DOUBLE_EQ(point.parameter, path[k++]);
+    auto reference = Make_chain(6);
+    reference->Set_Known_Static_Pressure(0, point.parameter * si::pascals);
+    Fluids::Solver solver(reference, std::make_shared<Fluids::SparseNewtonStrategy>());
+    solver.Solve();
+    independent_factorizations += solver.Get_Statistics().factorizations;
+    ASSERT_TRUE(point.state.isApprox(reference->Get_Unknown_vector(), 1e-6));
+  }
+  ASSERT_EQ(k, path.size());
+  ASSERT_LE(continuation.Get_Statistics().factorizations, independent_factorizations);
+  // The system is left at the end of the path
+  ASSERT_DOUBLE_EQ(sys->Get_Liquid(0)->Get_Static_pressure()->value(), 2.2e5);
+  ASSERT_LT(sys->Get_Return_vec().norm(), 1e-6);
+}
+
+TEST(SensitivityTest, AdjointMatchesFiniteDifferences) {
+  auto sys = Make_chain(4);
+  auto strategy = std::make_shared<Fluids::SparseNewtonStrategy>();
+  strategy->Set_Tolerance(1e-10);
+  Fluids::Solver solver(sys, strategy);
+  solver.Solve();
+  Fluids::Sensitivity sensitivity(sys);
+  auto gradients = sensitivity.Compute({2, 3, 4});
+  ASSERT_EQ(gradients.pipes.size(), 4u);
+  ASSERT_EQ(gradients.diameter.rows(), 3);
+  ASSERT_EQ(gradients.diameter.cols(), 4);
+  // The pressure at the outlet is known
+  ASSERT_EQ(gradients.diameter.row(2).norm(), 0.);
+
+  auto pressure_at = [&](size_t pipe, double diameter, double length) {
+    auto perturbed = Make_chain(4);
+    auto component = std::dynamic_pointer_cast<Fluids::Pipes>(
+        perturbed->Get_Component(gradients.pipes[pipe].first, gradients.pipes[pipe].second));
+    *component->Get_Diameter() = diameter * si::meter;
+    *component->Get_Length() = length * si::meter;
+    Fluids::Solver reference(perturbed, strategy);
+    reference.Solve();
+    return perturbed->Get_Liquid(2)->Get_Static_pressure()->value();
+  };
+  for (size_t p = 0; p < 4; ++p) {
+    auto pipe = std::dynamic_pointer_cast<Fluids::Pipes>(
+        sys->Get_Component(gradients.pipes[p].first, gradients.pipes[p].second));
+    double d = pipe->Get_Diameter()->value();
+    double l = pipe->Get_Length()->value();
+    double hd = 1e-5 * d;
+    double hl = 1e-5 * l;
+    double dp_dd = (pressure_at(p, d + hd, l) - pressure_at(p, d - hd, l)) / (2 * hd);
+    double dp_dl = (pressure_at(p, d, l + hl) - pressure_at(p, d, l - hl)) / (2 * hl);
+    ASSERT_NEAR(gradients.diameter(0, p), dp_dd, 1e-3 * std::abs(dp_dd) + 1e-2);
+    ASSERT_NEAR(gradients.length(0, p), dp_dl, 1e-3 * std::abs(dp_dl) + 1e-2);
+  }
+}
+
+TEST(EnsembleTest, LanesMatchSeparateSolves) {
+  const size_t lanes = 6;
+  Eigen::ArrayXd supply = Eigen::ArrayXd::LinSpaced(lanes, 1.2e5, 2.5e5);
+  auto sys = Make_chain(5);
+  Fluids::Ensemble ensemble(sys, lanes);
+  ensemble.Set_Tolerance(1e-9);
+  ensemble.Set_Known_Static_Pressure(0, supply);
+  ASSERT_THROW(ensemble.Set_Known_Static_Pressure(2, supply), std::logic_error);
+  ASSERT_EQ(ensemble.Solve(), lanes);
+
+  auto strategy = std::make_shared<Fluids::SparseNewtonStrategy>();
+  strategy->Set_Tolerance(1e-9);
+  for (size_t l = 0; l < lanes; ++l) {
+    auto reference = Make_chain(5);
+    reference->Set_Known_Static_Pressure(0, supply(l) * si::pascals);
+    Fluids::Solver solver(reference, strategy);
+    solver.Solve();
+    ASSERT_TRUE(ensemble.Get_Statistics()[l].converged);
+    Eigen::VectorXd expected = reference->Get_Unknown_vector();
+    Eigen::VectorXd state = ensemble.Get_State(l);
+    ASSERT_LT((state - expected).norm(), 1e-6 * expected.norm());
+    ASSERT_NEAR(ensemble.Get_Static_pressure(0)(l), supply(l), 1e-9);
+    ASSERT_NEAR(ensemble.Get_Speed(1)(l), reference->Get_Liquid(1)->Get_Speed()->value(), 1e-6);
+  }
+  // Lanes with a larger pressure difference need more iterations, the converged lanes are masked out
+  ASSERT_LE(ensemble.Get_Statistics().front().iterations, ensemble.Get_Statistics().back().iterations);
+}
+
+TEST(SolveAsyncTest, ProgressAndFuture) {
+  auto sys = Make_chain(6);
+  Fluids::Solver solver(sys, std::make_shared<Fluids::SparseNewtonStrategy>());
+  std::vector<double> norms;
+  Fluids::SolveOptions options;
+  options.progress = [&](size_t, double residual_norm) { norms.push_back(residual_norm); };
+  auto statistics = solver.SolveAsync(options).get();
+  ASSERT_TRUE(statistics.converged);
+  ASSERT_FALSE(statistics.interrupted);
+  ASSERT_GE(norms.size(), 2u);
+  ASSERT_TRUE(std::is_sorted(norms.rbegin(), norms.rend()));
+  ASSERT_DOUBLE_EQ(norms.back(), statistics.residual_norm);
+}
+
+TEST(SolveAsyncTest, CancellationKeepsBestIterate) {
+  auto sys = Make_chain(6);
+  auto strategy = std::make_shared<Fluids::NewtonStrategy>();
+  Fluids::Solver solver(sys, strategy);
+  Fluids::SolveOptions options;
+  options.cancellation = std::make_shared<Fluids::CancellationToken>();
+  double initial_norm = 0.;
+  options.progress = [&](size_t iteration, double residual_norm) {
+    if (iteration == 0)
+      initial_norm = residual_norm;
+    if (iteration == 1)
+      options.cancellation->Cancel();
+  };
+  auto statistics = solver.SolveAsync(options).get();
+  ASSERT_TRUE(statistics.interrupted);
+  ASSERT_FALSE(statistics.converged);
+  ASSERT_EQ(statistics.iterations, 1u);
+  ASSERT_LT(statistics.residual_norm, initial_norm);
+  ASSERT_NEAR(sys->Get_Return_vec().norm(), statistics.residual_norm, 1e-9 * initial_norm);
+  ASSERT_FALSE(strategy->Get_Monitor());
+}
+
+TEST(SolveAsyncTest, DeadlineReturnsInitialIterate) {
+  for (std::shared_ptr<Fluids::SolverStrategy> strategy : std::vector<std::shared_ptr<Fluids::SolverStrategy>>{
+      std::make_shared<Fluids::HybridStrategy>(), std::make_shared<Fluids::BroydenStrategy>(),
+      std::make_shared<Fluids::NewtonKrylovStrategy>()}) {
+    auto sys = Make_chain(4);
+    Eigen::VectorXd initial = sys->Get_Initial_vector();
+    Fluids::Solver solver(sys, strategy);
+    Fluids::SolveOptions options;
+    options.deadline = std::chrono::steady_clock::now();
+    solver.Solve(options);
+    ASSERT_TRUE(solver.Get_Statistics().interrupted);
+    ASSERT_EQ(solver.Get_Statistics().iterations, 0u);
+    ASSERT_LT((sys->Get_Unknown_vector() - initial).norm(), 1e-9 * initial.norm());
+  }
+}
+
+TEST(ModelTest, ConcurrentSolveStates) {
+  auto sys = Make_chain(5);
+  auto model = std::make_shared<const Fluids::Model>(sys);
+  // The snapshot does not follow the system
+  sys->Set_Known_Static_Pressure(0, 3.e5 * si::pascals);
+  ASSERT_EQ(model->n_unknowns(), model->n_residuals());
+
+  const size_t n_threads = 4;
+  std::vector<Eigen::VectorXd> results(n_threads);
+  std::vector<char> converged(n_threads, 0);
+  std::vector<std::thread> threads;
+  for (size_t t = 0; t < n_threads; ++t) {
+    threads.emplace_back([&, t]() {
+      Fluids::SolveState state(model);
+      state.Set_Tolerance(1e-9);
+      state.Set_Known_Static_Pressure(0, (1.2e5 + 0.3e5 * t) * si::pascals);
+      converged[t] = state.Solve().converged;
+      results[t] = state.Get_Unknown_vector();
+    });
+  }
+  for (auto &&thread : threads)
+    thread.join();
+
+  auto strategy = std::make_shared<Fluids::SparseNewtonStrategy>();
+  strategy->Set_Tolerance(1e-9);
+  for (size_t t = 0; t < n_threads; ++t) {
+    ASSERT_TRUE(converged[t]);
+    auto reference = Make_chain(5);
+    reference->Set_Known_Static_Pressure(0, (1.2e5 + 0.3e5 * t) * si::pascals);
+    Fluids::Solver(reference, strategy).Solve();
+    Eigen::VectorXd expected = reference->Get_Unknown_vector();
+    ASSERT_LT((results[t] - expected).norm(), 1e-6 * expected.norm());
+  }
+}
+
+TEST(ModelTest, StoreIntoSystem) {
+  auto sys = Make_chain(3);
+  auto model = std::make_shared<const Fluids::Model>(sys);
+  Fluids::SolveState state(model);
+  ASSERT_THROW(state.Set_Known_Static_Pressure(1, 1.e5 * si::pascals), std::logic_error);
+  state.Set_Known_Static_Pressure(0, 2.e5 * si::pascals);
+  ASSERT_TRUE(state.Solve().converged);
+  ASSERT_EQ(state.Solve().iterations, 0u);
+  state.Store(*sys);
+  ASSERT_DOUBLE_EQ(sys->Get_Liquid(0)->Get_Static_pressure()->value(), 2.e5);
+  ASSERT_LT(sys->Get_Return_vec().norm(), 1e-6);
+  ASSERT_DOUBLE_EQ(state.Get_Speed(1).value(), sys->Get_Liquid(1)->Get_Speed()->value());
+}
+
+TEST(FixedSizeSolverTest, MatchesSolveStateWithoutAllocations) {
+  auto model = std::make_shared<const Fluids::Model>(Make_chain(3));
+  ASSERT_EQ(model->n_unknowns(), 8u);
+  ASSERT_THROW(Fluids::FixedSizeSolver<7> wrong(*model), std::logic_error);
+  Fluids::FixedSizeSolver<8> fixed(*model);
+  Fluids::SolveState state(model);
+  for (double p0 : {1.5e5, 1.8e5, 2.1e5}) {
+    state.Set_Known_Static_Pressure(0, p0 * si::pascals);
+    ASSERT_TRUE(state.Solve().converged);
+    size_t allocations = g_allocations;
+    fixed.Set_Known_Static_Pressure(0, p0 * si::pascals);
+    Fluids::SolverStatistics statistics = fixed.Solve();
+    ASSERT_EQ(g_allocations, allocations);
+    ASSERT_TRUE(statistics.converged);
+    ASSERT_NEAR(fixed.Get_Speed(1).value(), state.Get_Speed(1).value(), 1e-6);
+    ASSERT_NEAR(fixed.Get_Static_pressure(2).value(), state.Get_Static_pressure(2).value(), 1e-3);
+  }
+}
+
+TEST(SolutionCacheTest, HitsAndWarmStarts) {
+  auto sys = Make_chain(3);
+  auto strategy = std::make_shared<Fluids::SparseNewtonStrategy>();
+  strategy->Set_Tolerance(1e-8);
+  Fluids::Solver solver(sys, strategy);
+  auto cache = std::make_shared<Fluids::SolutionCache>(2);
+  solver.Set_Cache(cache);
+  solver.Solve();
+  ASSERT_EQ(cache->Get_Misses(), 1u);
+  ASSERT_EQ(cache->Size(), 1u);
+  const double speed = sys->Get_Liquid(1)->Get_Speed()->value();
+
+  // Identical boundaries, from a perturbed state
+  *sys->Get_Liquid(1)->Get_Speed() = 0. * si::meters_per_second;
+  solver.Solve();
+  ASSERT_EQ(cache->Get_Hits(), 1u);
+  ASSERT_EQ(solver.Get_Statistics().iterations, 0u);
+  ASSERT_TRUE(solver.Get_Statistics().converged);
+  ASSERT_DOUBLE_EQ(sys->Get_Liquid(1)->Get_Speed()->value(), speed);
+
+  // Other boundaries start from the nearest solution
+  sys->Set_Known_Static_Pressure(0, 1.52e5 * si::pascals);
+  solver.Solve();
+  ASSERT_EQ(cache->Get_Nearest(), 1u);
+  ASSERT_TRUE(solver.Get_Statistics().converged);
+  const size_t warm = solver.Get_Statistics().iterations;
+  auto cold = Make_chain(3);
+  cold->Set_Known_Static_Pressure(0, 1.52e5 * si::pascals);
+  Fluids::Solver(cold, strategy).Solve();
+  ASSERT_NEAR(sys->Get_Liquid(1)->Get_Speed()->value(), cold->Get_Liquid(1)->Get_Speed()->value(), 1e-9);
+  ASSERT_GT(warm, 0u);
+
+  // Least recently used eviction
+  ASSERT_EQ(cache->Size(), 2u);
+  sys->Set_Known_Static_Pressure(0, 1.7e5 * si::pascals);
+  solver.Solve();
+  ASSERT_EQ(cache->Size(), 2u);
+  sys->Set_Known_Static_Pressure(0, static_cast<quantity<si::pressure>>(1.5 * si::bar));
+  Eigen::VectorXd x;
+  ASSERT_EQ(cache->Find(*sys, x), Fluids::SolutionCache::Match::Nearest);
+
+  // Another model with the same topology version and boundaries does not share the entries
+  auto longer = Make_chain(4);
+  auto shorter = Make_chain(3);
+  shorter->Reorder();
+  ASSERT_EQ(longer->Get_Topology_version(), shorter->Get_Topology_version());
+  Fluids::SolutionCache shared;
+  shared.Insert(*longer, longer->Get_Initial_vector());
+  ASSERT_EQ(shared.Find(*shorter, x), Fluids::SolutionCache::Match::None);
+  ASSERT_EQ(shared.Find(*longer, x), Fluids::SolutionCache::Match::Exact);
+  ASSERT_EQ(x.size(), static_cast<Eigen::Index>(longer->n_unknowns()));
+}
+
+TEST(SurrogateTest, InterpolatesInsideTheBox) {
+  auto model = std::make_shared<const Fluids::Model>(Make_chain(3));
+  Fluids::Surrogate surrogate(model);
+  ASSERT_THROW(surrogate.Add_Speed_dimension(1, 0. * si::meters_per_second, 1. * si::meters_per_second),
+               std::logic_error);
+  surrogate.Add_Static_pressure_dimension(0, 1.4e5 * si::pascals, 1.6e5 * si::pascals);
+  surrogate.Add_Static_pressure_dimension(3, 0.9e5 * si::pascals, 1.1e5 * si::pascals);
+  auto statistics = surrogate.Build(5);
+  ASSERT_TRUE(statistics.converged);
+  ASSERT_EQ(statistics.symbolic_analyses, 1u);
+  ASSERT_EQ(surrogate.n_samples(), 129u);
+
+  Fluids::SolveState state(model);
+  state.Set_Tolerance(1e-10);
+  auto solve = [&](double p0, double p3) {
+    state.Set_Known_Static_Pressure(0, p0 * si::pascals);
+    state.Set_Known_Static_Pressure(3, p3 * si::pascals);
+    state.Solve();
+    return state.Get_Unknown_vector();
+  };
+  const Eigen::Index speed = 0; // First unknown speed
+  ASSERT_LT(surrogate.Get_Fit_error()(speed), 1e-2 * std::abs(solve(1.5e5, 1.e5)(speed)));
+
+  bool interpolated = false;
+  Eigen::Vector2d inside(1.53e5, 0.97e5);
+  Eigen::VectorXd x = surrogate.Evaluate(inside, &interpolated);
+  ASSERT_TRUE(interpolated);
+  ASSERT_NEAR(x(speed), solve(1.53e5, 0.97e5)(speed), surrogate.Get_Fit_error()(speed) + 1e-3);
+
+  Eigen::Vector2d outside(1.7e5, 1.e5);
+  x = surrogate.Evaluate(outside, &interpolated);
+  ASSERT_FALSE(interpolated);
+  ASSERT_NEAR(x(speed), solve(1.7e5, 1.e5)(speed), 1e-8);
+}
+
+TEST(SurrogateTest, FailedBuildIsNotTrusted) {
+  auto model = std::make_shared<const Fluids::Model>(Make_chain(3));
+  Fluids::Surrogate surrogate(model);
+  surrogate.Add_Static_pressure_dimension(0, 1.4e5 * si::pascals, 1.6e5 * si::pascals);
+  surrogate.Add_Static_pressure_dimension(3, 0.9e5 * si::pascals, 1.1e5 * si::pascals);
+  surrogate.Set_Max_iterations(2); // Too few for the cold samples
+  ASSERT_THROW(surrogate.Build(3), std::runtime_error);
+  Eigen::Vector2d inside(1.5e5, 1.e5);
+  ASSERT_FALSE(surrogate.Is_Trusted(inside));
+  ASSERT_EQ(surrogate.n_samples(), 0u);
+
+  // A failed rebuild keeps the previous fit
+  surrogate.Set_Max_iterations(100);
+  surrogate.Build(3);
+  const size_t samples = surrogate.n_samples();
+  surrogate.Set_Max_iterations(2);
+  ASSERT_THROW(surrogate.Build(4), std::runtime_error);
+  ASSERT_TRUE(surrogate.Is_Trusted(inside));
+  ASSERT_EQ(surrogate.n_samples(), samples);
+}
+
+TEST(LoopFlowTest, TreeMatchesSystem) {
+  auto sys = Make_chain(4);
+  Fluids::LoopFlow loops(sys);
+  ASSERT_EQ(loops.n_loops(), 1u); // The path between the two known pressures
+  auto statistics = loops.Solve();
+  ASSERT_TRUE(statistics.converged);
+  ASSERT_LT(sys->Get_Return_vec().norm(), 1e-5);
+
+  auto reference = Make_chain(4);
+  auto strategy = std::make_shared<Fluids::SparseNewtonStrategy>();
+  strategy->Set_Tolerance(1e-10);
+  Fluids::Solver(reference, strategy).Solve();
+  for (size_t i = 0; i < 5; ++i)
+    ASSERT_NEAR(sys->Get_Liquid(i)->Get_Speed()->value(), reference->Get_Liquid(i)->Get_Speed()->value(), 1e-8);
+}
+
+TEST(LoopFlowTest, MeshedNetwork) {
+  // Two parallel branches 1-2-4 and 1-3-4 of different diameters between an inlet and an outlet
+  Fluids::Liquid water;
+  auto sys = std::make_shared<Fluids::System>(water, 6);
+  auto pipe = [](double diameter) {
+    return std::make_shared<Fluids::Pipes>(diameter * si::meter, 10. * si::meter, 4.6e-5 * si::meters);
+  };
+  sys->add_FluidComponent(pipe(0.2), 0, 1);
+  sys->add_FluidComponent(pipe(0.15), 1, 2);
+  sys->add_FluidComponent(pipe(0.15), 2, 4);
+  sys->add_FluidComponent(pipe(0.1), 1, 3);
+  sys->add_FluidComponent(pipe(0.1), 3, 4);
+  sys->add_FluidComponent(pipe(0.2), 4, 5);
+  sys->Initialize();
+  sys->Set_Known_Static_Pressure(0, 1.5e5 * si::pascals);
+  sys->Set_Known_Static_Pressure(5, 1.e5 * si::pascals);
+  Fluids::LoopFlow loops(sys);
+  ASSERT_EQ(loops.n_loops(), 2u);
+  const Fluids::SolverStatistics statistics = loops.Solve();
+  ASSERT_TRUE(statistics.converged);
+  // The loop basis fixes the pattern, it is analysed once and refactored every iteration
+  ASSERT_EQ(statistics.symbolic_analyses, 1u);
+  ASSERT_EQ(statistics.factorizations, statistics.iterations);
+
+  auto q = [&](size_t u, size_t v) { return loops.Get_Volumetricflow(u, v).value(); };
+  ASSERT_NEAR(q(0, 1), q(1, 2) + q(1, 3), 1e-12);
+  ASSERT_NEAR(q(2, 4) + q(3, 4), q(4, 5), 1e-12);
+  ASSERT_GT(q(1, 2), q(1, 3));
+  ASSERT_GT(q(1, 3), 0.);
+  // Equal friction losses along both branches
+  auto loss = [&](size_t u, size_t v) {
+    auto p = std::dynamic_pointer_cast<Fluids::Pipes>(sys->Get_Component(u, v));
+    double area = p->Get_CrossSection()->value();
+    double speed = q(u, v) / area;
+    double f = Fluids::Pipes::Haaland(Fluids::Pipes::Reynolds(speed * si::meters_per_second, *p->Get_Diameter(),
+                                                              *water.Get_Density(), *water.Get_Dynamic_viscosity()),
+                                      *p->Get_Relative_roughness()).value();
+    return f * p->Get_Length()->value() / p->Get_Diameter()->value() * 0.5 * water.Get_Density()->value() * speed
+        * speed;
+  };
+  ASSERT_NEAR(loss(1, 2) + loss(2, 4), loss(1, 3) + loss(3, 4), 1e-3);
+  ASSERT_NEAR(sys->Get_Liquid(5)->Get_Speed()->value() * pipe(0.2)->Get_CrossSection()->value(), q(4, 5), 1e-12);
+}
+
+TEST(IncrementalSolverTest, ResolvesAffectedBlockOnly) {
+  // A known speed and static pressure at vertex 2 decouple the pipes upstream and downstream of it
+  auto make = []() {
+    Fluids::Liquid water;
+    auto sys = std::make_shared<Fluids::System>(water, 5);
+    for (size_t i = 0; i < 4; ++i)
+      sys->add_FluidComponent(std::make_shared<Fluids::Pipes>(0.2 * si::meter, 10. * si::meter, 4.6e-5 * si::meters),
+                              i, i + 1);
+    sys->Initialize();
+    sys->Set_Known_Static_Pressure(2, 1.5e5 * si::pascals);
+    sys->Set_Known_Speed(2, 1. * si::meters_per_second);
+    return sys;
+  };
+  auto sys = make();
+  Fluids::IncrementalSolver incremental(sys);
+  ASSERT_TRUE(incremental.Solve().converged);
+  ASSERT_EQ(incremental.n_blocks(), 2u);
+  ASSERT_EQ(incremental.Get_Region_size(), sys->n_unknowns());
+  ASSERT_LT(sys->Get_Return_vec().norm(), 1e-5);
+
+  // Nothing changed
+  auto statistics = incremental.Solve();
+  ASSERT_EQ(statistics.iterations, 0u);
+  ASSERT_EQ(incremental.Get_Region_size(), 0u);
+
+  // A downstream pipe only moves the downstream block
+  const double upstream = sys->Get_Liquid(0)->Get_Static_pressure()->value();
+  const double downstream = sys->Get_Liquid(4)->Get_Static_pressure()->value();
+  *std::dynamic_pointer_cast<Fluids::Pipes>(sys->Get_Component(3, 4))->Get_Length() = 20. * si::meter;
+  ASSERT_TRUE(incremental.Solve().converged);
+  ASSERT_EQ(incremental.Get_Region_size(), sys->n_unknowns() / 2);
+  ASSERT_EQ(sys->Get_Liquid(0)->Get_Static_pressure()->value(), upstream);
+  ASSERT_LT(sys->Get_Liquid(4)->Get_Static_pressure()->value(), downstream);
+  ASSERT_LT(sys->Get_Return_vec().norm(), 1e-5);
+
+  // The shared boundary moves both blocks
+  sys->Set_Known_Static_Pressure(2, 1.6e5 * si::pascals);
+  ASSERT_TRUE(incremental.Solve().converged);
+  ASSERT_EQ(incremental.Get_Region_size(), sys->n_unknowns());
+  ASSERT_LT(sys->Get_Return_vec().norm(), 1e-5);
+}
+
+TEST(ActiveEdgeTest, ValveClosesWithoutRebuild) {
+  auto sys = Make_chain(3);
+  const size_t version = sys->Get_Topology_version();
+  auto model = std::make_shared<const Fluids::Model>(sys);
+  Fluids::SolveState state(model);
+  ASSERT_TRUE(state.Solve().converged);
+  const Eigen::VectorXd open = state.Get_Unknown_vector();
+  const double speed = state.Get_Speed(0).value();
+  ASSERT_GT(speed, 0.1);
+
+  // A closed pipe stops the flow, the pressures on either side are the ones of the boundaries
+  state.Set_Active(1, 2, false);
+  ASSERT_FALSE(state.Is_Active(1, 2));
+  ASSERT_TRUE(state.Solve().converged);
+  ASSERT_NEAR(state.Get_Speed(0).value(), 0., 1e-6);
+  ASSERT_NEAR(state.Get_Static_pressure(1).value(), 1.5e5, 1e-3);
+  ASSERT_NEAR(state.Get_Static_pressure(2).value(), 1.e5, 1e-3);
+  state.Set_Active(1, 2, true);
+  ASSERT_TRUE(state.Solve().converged);
+  ASSERT_LT((state.Get_Unknown_vector() - open).norm(), 1e-3);
+  ASSERT_THROW(state.Set_Active(0, 2, false), std::out_of_range);
+
+  // Valve positions per lane
+  Fluids::Ensemble ensemble(model, 2);
+  ensemble.Set_Active(1, 2, (Eigen::ArrayXd(2) << 1., 0.).finished());
+  ASSERT_EQ(ensemble.Solve(), 2u);
+  ASSERT_NEAR(ensemble.Get_Speed(0)(0), speed, 1e-6);
+  ASSERT_NEAR(ensemble.Get_Speed(0)(1), 0., 1e-6);
+
+  // Closing a component of the system keeps its topology and the structures of the incremental solver
+  Fluids::IncrementalSolver incremental(sys);
+  ASSERT_TRUE(incremental.Solve().converged);
+  sys->Set_Active(1, 2, false);
+  ASSERT_EQ(sys->Get_Topology_version(), version);
+  auto statistics = incremental.Solve();
+  ASSERT_TRUE(statistics.converged);
+  ASSERT_EQ(statistics.symbolic_analyses, 0u);
+  ASSERT_EQ(statistics.factorizations, statistics.iterations);
+  ASSERT_NEAR(sys->Get_Liquid(0)->Get_Speed()->value(), 0., 1e-6);
+  ASSERT_LT(sys->Get_Return_vec().norm(), 1e-5);
+  sys->Set_Active(1, 2, true);
+  ASSERT_TRUE(incremental.Solve().converged);
+  ASSERT_NEAR(sys->Get_Liquid(0)->Get_Speed()->value(), speed, 1e-6);
+}
+
+TEST(ActiveEdgeTest, BranchingVertexKeepsItsBranches) {
+  // A tee 0-1-{2,3}: both branches leave vertex 1 with its speed, so one of them can not be closed on its own. The
+  // branch flows follow from that speed, the pressure at the end of the second branch is an unknown.
+  Fluids::Liquid water;
+  auto sys = std::make_shared<Fluids::System>(water, 4);
+  auto pipe = [](double diameter) {
+    return std::make_shared<Fluids::Pipes>(diameter * si::meter, 10. * si::meter, 4.6e-5 * si::meters);
+  };
+  sys->add_FluidComponent(pipe(0.2), 0, 1);
+  sys->add_FluidComponent(pipe(0.15), 1, 2);
+  sys->add_FluidComponent(pipe(0.15), 1, 3);
+  sys->Initialize();
+  sys->Set_Known_Static_Pressure(0, 1.5e5 * si::pascals);
+  sys->Set_Known_Static_Pressure(2, 1.e5 * si::pascals);
+  auto model = std::make_shared<const Fluids::Model>(sys);
+  Fluids::SolveState state(model);
+  ASSERT_TRUE(state.Solve().converged);
+  ASSERT_GT(state.Get_Speed(0).value(), 0.1);
+
+  ASSERT_THROW(sys->Set_Active(1, 3, false), std::logic_error);
+  ASSERT_TRUE(sys->Is_Active(1, 3));
+  ASSERT_THROW(state.Set_Active(1, 2, false), std::logic_error);
+  ASSERT_TRUE(state.Is_Active(1, 2));
+  Fluids::Ensemble ensemble(model, 2);
+  ASSERT_THROW(ensemble.Set_Active(1, 3, (Eigen::ArrayXd(2) << 1., 0.).finished()), std::logic_error);
+  state.Set_Active(1, 2, true);
+
+  // The single pipe into the tee can be closed, which stops both branches
+  state.Set_Active(0, 1, false);
+  ASSERT_TRUE(state.Solve().converged);
+  ASSERT_NEAR(state.Get_Speed(0).value(), 0., 1e-6);
+  ASSERT_NEAR(state.Get_Speed(1).value(), 0., 1e-6);
+  sys->Set_Active(0, 1, false);
+  Fluids::Solver solver(sys, std::make_shared<Fluids::SparseNewtonStrategy>());
+  solver.Solve();
+  ASSERT_TRUE(solver.Get_Statistics().converged);
+  ASSERT_NEAR(sys->Get_Liquid(1)->Get_Speed()->value(), 0., 1e-6);
+  ASSERT_LT(sys->Get_Return_vec().norm(), 1e-5);
+}
+
+TEST(SnapshotTest, ReadersSeeCompleteSolutions) {
+  auto sys = Make_chain(3);
+  auto channel = std::make_shared<Fluids::SnapshotChannel>();
+  Fluids::Solver solver(sys);
+  solver.Set_Channel(channel);
+  ASSERT_FALSE(channel->Get());
+
+  // A reader keeps the snapshots it sees while the system is solved again and again
+  std::atomic<bool> done{false};
+  std::vector<std::shared_ptr<const Fluids::Snapshot>> seen;
+  std::thread reader([&]() {
+    while (!done) {
+      auto snapshot = channel->Get();
+      if (snapshot && (seen.empty() || seen.back() != snapshot))
+        seen.push_back(snapshot);
+      std::this_thread::yield();
+    }
+  });
+  std::vector<Eigen::VectorXd> solutions;
+  for (size_t k = 0; k < 6; ++k) {
+    sys->Set_Known_Static_Pressure(0, (1.5e5 + 1.e4 * static_cast<double>(k % 3)) * si::pascals);
+    solver.Solve();
+    solutions.push_back(sys->Get_Unknown_vector());
+  }
+  done = true;
+  reader.join();
+
+  ASSERT_EQ(channel->Get_Version(), 6u);
+  ASSERT_EQ(channel->Get()->Get_Version(), 6u);
+  ASSERT_EQ(channel->Get()->Get_Static_pressure(0).value(), 1.7e5);
+  for (size_t k = 1; k < seen.size(); ++k)
+    ASSERT_LT(seen[k - 1]->Get_Version(), seen[k]->Get_Version());
+  for (auto &&snapshot : seen) {
+    ASSERT_TRUE(snapshot->Get_Statistics().converged);
+    ASSERT_EQ(snapshot->Get_Unknown_vector(), solutions[snapshot->Get_Version() - 1]);
+  }
+}
+
+TEST(SnapshotTest, PublishDoesNotWaitForReaders) {
+  auto sys = Make_chain(3);
+  Fluids::SnapshotChannel channel;
+  channel.Publish(*sys, Fluids::SolverStatistics());
+
+  // A reader is held inside the channel while the solver publishes
+  std::atomic<bool> entered{false}, release{false};
+  size_t version = 0;
+  std::thread reader([&]() {
+    channel.Read([&](const Fluids::Snapshot *snapshot) {
+      entered = true;
+      while (!release)
+        std::this_thread::yield();
+      version = snapshot->Get_Version();
+    });
+  });
+  while (!entered)
+    std::this_thread::yield();
+  for (size_t k = 0; k < 3; ++k)
+    channel.Publish(*sys, Fluids::SolverStatistics());
+  ASSERT_EQ(channel.Get()->Get_Version(), 4u);
+  ASSERT_EQ(channel.n_retired(), 3u);
+  release = true;
+  reader.join();
+  ASSERT_EQ(version, 1u);
+
+  // The next publication releases the slots the reader held up
+  channel.Publish(*sys, Fluids::SolverStatistics());
+  ASSERT_EQ(channel.n_retired(), 0u);
+}
+
+TEST(TraceTest, RingBufferAndChromeExport) {
+  Fluids::Trace::Set_Capacity(4);
+  {
+    Fluids::TraceScope ignored("disabled");
+  }
+  ASSERT_EQ(Fluids::Trace::n_recorded(), 0u);
+  Fluids::Trace::Enable(true);
+  {
+    Fluids::TraceScope outer("outer");
+    Fluids::TraceScope inner("inner");
+  }
+  auto events = Fluids::Trace::Get_Events();
+  ASSERT_EQ(events.size(), 2u);
+  ASSERT_STREQ(events[0].name, "inner");
+  ASSERT_STREQ(events[1].name, "outer");
+  ASSERT_LE(events[1].begin, events[0].begin);
+  ASSERT_GE(events[1].duration, events[0].duration);
+
+  // The oldest events are overwritten
+  for (size_t k = 0; k < 5; ++k)
+    Fluids::TraceScope scope("repeated");
+  ASSERT_EQ(Fluids::Trace::n_recorded(), 7u);
+  events = Fluids::Trace::Get_Events();
+  ASSERT_EQ(events.size(), 4u);
+  ASSERT_STREQ(events.front().name, "repeated");
+
+#ifdef LIBFLUIDS_TRACING
+  Fluids::Trace::Set_Capacity(1 << 12);
+  Fluids::Solver solver(Make_chain(3));
+  solver.Solve();
+  events = Fluids::Trace::Get_Events();
+  ASSERT_TRUE(std::any_of(events.begin(), events.end(), [](const Fluids::Trace::Event &event) {
+    return std::string(event.name) == "Solver::Solve";
+  }));
+#endif
+  std::ostringstream json;
+  Fluids::Trace::Export_chrome(json);
+  ASSERT_EQ(json.str().find("{\"traceEvents\":["), 0u);
+  ASSERT_NE(json.str().find("\"ph\":\"X\""), std::string::npos);
+  Fluids::Trace::Enable(false);
+  Fluids::Trace::Set_Capacity(1 << 16);
+}
+
+TEST(MemoryReportTest, FootprintPerThousandPipes) {
+  const Fluids::MemoryReport one = Fluids::MemoryReport::Of(*Make_chain(1000));
+  const Fluids::MemoryReport two = Fluids::MemoryReport::Of(*Make_chain(2000));
+  const Fluids::MemoryReport three = Fluids::MemoryReport::Of(*Make_chain(3000));
+  ASSERT_EQ(two.vertex_state - one.vertex_state, three.vertex_state - two.vertex_state);
+  ASSERT_EQ(two.edge_parameters - one.edge_parameters, three.edge_parameters - two.edge_parameters);
+  ASSERT_EQ(two.edge_estimate - one.edge_estimate, three.edge_estimate - two.edge_estimate);
+  // Regression bounds of 1000 pipes with their vertices
+  ASSERT_LT(two.edge_parameters + two.edge_estimate - one.edge_parameters - one.edge_estimate, 1000u * 1024u);
+  ASSERT_LT(two.vertex_state - one.vertex_state, 1000u * 1024u);
+  ASSERT_LT(two.topology - one.topology, 1000u * 512u);
+  ASSERT_EQ(one.solver_workspace + one.caches, 0u);
+
+  auto sys = Make_chain(3);
+  auto cache = std::make_shared<Fluids::SolutionCache>();
+  Fluids::Solver solver(sys);
+  solver.Set_Cache(cache);
+  solver.Solve();
+  Fluids::MemoryReport report = Fluids::MemoryReport::Of(*sys);
+  const size_t system_bytes = report.Total();
+  report += Fluids::MemoryReport::Of(Fluids::Model(sys));
+  report += Fluids::MemoryReport::Of(*cache);
+  ASSERT_GT(report.solver_workspace, 0u);
+  ASSERT_GT(report.caches, 0u);
+  ASSERT_EQ(report.Total(), system_bytes + report.solver_workspace + report.caches);
+
+  Fluids::CountingResource counter;
+  {
+    std::pmr::vector<double> values(&counter);
+    values.resize(1000);
+    ASSERT_GE(counter.Get_Bytes(), 1000u * sizeof(double));
+    ASSERT_EQ(counter.Get_Allocations(), 1u);
+  }
+  ASSERT_EQ(counter.Get_Bytes(), 0u);
+  ASSERT_GE(counter.Get_Peak(), 1000u * sizeof(double));
+}
+
+TEST(MemoryReportTest, MatchesCountedBytes) {
+  // The counter is the arena itself, so that it sees every allocation of the system
+  Fluids::CountingResource counter;
+  const Fluids::Arena arena(&counter, [](std::pmr::memory_resource *) {});
+  const size_t n_pipes = 50;
+  auto sys = std::make_shared<Fluids::System>(Fluids::Liquid(), n_pipes + 1, arena);
+  for (size_t i = 0; i < n_pipes; ++i)
+    sys->add_FluidComponent(std::make_shared<Fluids::Pipes>(0.2 * si::meter, 10. * si::meter, 4.6e-5 * si::meters),
+                            i, i + 1);
+  const Fluids::MemoryReport pipes = Fluids::MemoryReport::Of(*sys);
+  ASSERT_EQ(pipes.vertex_state, counter.Get_Bytes());
+  ASSERT_EQ(pipes.edge_parameters, 0u);
+  ASSERT_EQ(pipes.edge_estimate, n_pipes * sys->Get_Component(0, 1)->Get_Heap_bytes());
+  ASSERT_GT(sys->Get_Component(0, 1)->Get_Heap_bytes(), Fluids::FluidComponents().Get_Heap_bytes());
+  sys->Initialize();
+  const Fluids::MemoryReport report = Fluids::MemoryReport::Of(*sys);
+  ASSERT_EQ(report.vertex_state + report.edge_parameters, counter.Get_Bytes());
+  ASSERT_EQ(report.edge_estimate, pipes.edge_estimate);
+
+  // The same objects on the heap
+  auto heap = std::make_shared<Fluids::System>(Fluids::Liquid(), n_pipes + 1, nullptr);
+  for (size_t i = 0; i < n_pipes; ++i)
+    heap->add_FluidComponent(std::make_shared<Fluids::Pipes>(0.2 * si::meter, 10. * si::meter, 4.6e-5 * si::meters),
+                             i, i + 1);
+  heap->Initialize();
+  ASSERT_EQ(Fluids::MemoryReport::Of(*heap).vertex_state, report.vertex_state);
+  ASSERT_EQ(Fluids::MemoryReport::Of(*heap).edge_parameters, report.edge_parameters);
+  ASSERT_EQ(Fluids::MemoryReport::Of(*heap).edge_estimate, report.edge_estimate);
+  sys.reset();
+  ASSERT_EQ(counter.Get_Bytes(), 0u);
+}
+
+TEST(ArenaTest, SystemObjectsInOneArena) {
+  Fluids::CountingResource counter;
+  std::shared_ptr<Fluids::Liquid> liquid;
+  {
+    const size_t n_pipes = 1000;
+    auto sys = std::make_shared<Fluids::System>(Fluids::Liquid(), n_pipes + 1, Fluids::Make_arena(&counter));
+    for (size_t i = 0; i < n_pipes; ++i)
+      sys->add_FluidComponent(std::make_shared<Fluids::Pipes>(0.2 * si::meter, 10. * si::meter, 4.6e-5 * si::meters),
+                              i, i + 1);
+    sys->Initialize();
+    // A thousand liquids with eight quantities each in a few buffers of the upstream resource
+    ASSERT_LT(counter.Get_Allocations(), 32u);
+    ASSERT_GT(counter.Get_Bytes(), n_pipes * 9 * sizeof(double));
+    liquid = sys->Get_Liquid(0);
+    *liquid->Get_Static_pressure() = static_cast<quantity<si::pressure>>(1.5 * si::bar);
+  }
+  // The liquid keeps the arena alive after the system is gone
+  ASSERT_GT(counter.Get_Bytes(), 0u);
+  ASSERT_DOUBLE_EQ(liquid->Get_Static_pressure()->value(), 1.5e5);
+  liquid.reset();
+  ASSERT_EQ(counter.Get_Bytes(), 0u);
+
+  auto sys = Make_chain(4);
+  ASSERT_TRUE(sys->Get_Arena());
+  Fluids::Solver solver(sys);
+  solver.Solve();
+  ASSERT_TRUE(solver.Get_Statistics().converged);
+  ASSERT_GT(Fluids::MemoryReport::Of(*sys).vertex_state, 0u);
+}
+
+/// Sum over the edges of the distance between their vertices in the storage order
+size_t Edge_span(const std::shared_ptr<Fluids::System> &sys) {
+  const Fluids::Model model(sys);
+  size_t span = 0;
+  for (auto &&edge : model.Get_Description().edges)
+    span += static_cast<size_t>(std::abs(edge.u - edge.v));
+  return span;
+}
+
+TEST(ReorderTest, ShuffledChainKeepsVertexIds) {
+  // Chain of pipes through the vertices in a shuffled order of their ids, laid out as a serpentine
+  const size_t n_pipes = 63;
+  const size_t side = 8;
+  std::vector<size_t> ids(n_pipes + 1);
+  std::iota(ids.begin(), ids.end(), 0);
+  std::shuffle(ids.begin(), ids.end(), std::mt19937(7));
+  auto make_chain = [&]() {
+    auto sys = std::make_shared<Fluids::System>(Fluids::Liquid(), n_pipes + 1);
+    for (size_t k = 0; k < n_pipes; ++k)
+      sys->add_FluidComponent(std::make_shared<Fluids::Pipes>(0.2 * si::meter, 10. * si::meter, 4.6e-5 * si::meters),
+                              ids[k], ids[k + 1]);
+    sys->Initialize();
+    sys->Set_Known_Static_Pressure(ids.front(), static_cast<quantity<si::pressure>>(1.5 * si::bar));
+    sys->Set_Known_Static_Pressure(ids.back(), static_cast<quantity<si::pressure>>(1. * si::bar));
+    return sys;
+  };
+  auto plain = make_chain();
+  auto reordered = make_chain();
+  const size_t version = reordered->Get_Topology_version();
+  reordered->Reorder();
+  ASSERT_NE(reordered->Get_Topology_version(), version);
+  ASSERT_LE(Edge_span(reordered), 2 * (n_pipes + 2));
+  ASSERT_GT(Edge_span(plain), 8 * (n_pipes + 2));
+
+  Fluids::Solver(plain).Solve();
+  Fluids::Solver(reordered).Solve();
+  auto model = std::make_shared<const Fluids::Model>(reordered);
+  Fluids::SolveState state(model);
+  ASSERT_TRUE(state.Solve().converged);
+  for (size_t id = 0; id <= n_pipes; ++id) {
+    const double pressure = plain->Get_Liquid(id)->Get_Static_pressure()->value();
+    ASSERT_NEAR(reordered->Get_Liquid(id)->Get_Static_pressure()->value(), pressure, 1.e-3);
+    ASSERT_NEAR(state.Get_Static_pressure(id).value(), pressure, 1.e-3);
+  }
+  ASSERT_TRUE(model->Is_Known_static_pressure(ids.back()));
+  ASSERT_FALSE(model->Is_Known_static_pressure(ids[1]));
+
+  Eigen::MatrixX2d coordinates(n_pipes + 1, 2);
+  for (size_t k = 0; k <= n_pipes; ++k) {
+    const size_t row = k / side;
+    const size_t column = row % 2 == 0 ? k % side : side - 1 - k % side;
+    coordinates.row(static_cast<Eigen::Index>(ids[k])) << static_cast<double>(column), static_cast<double>(row);
+  }
+  auto curve = make_chain();
+  curve->Reorder(coordinates);
+  ASSERT_LT(2 * Edge_span(curve), Edge_span(plain));
+  ASSERT_THROW(make_chain()->Reorder(coordinates.topRows(side)), std::logic_error);
+}
+
+TEST(CheckpointTest, RestoresWarmSystem) {
+  auto sys = Make_chain(5);
+  sys->Reorder();
+  auto strategy = std::make_shared<Fluids::SparseNewtonStrategy>();
+  strategy->Set_Tolerance(1e-8);
+  Fluids::Solver solver(sys, strategy);
+  auto cache = std::make_shared<Fluids::SolutionCache>();
+  solver.Set_Cache(cache);
+  solver.Solve();
+  ASSERT_TRUE(solver.Get_Statistics().converged);
+  std::stringstream stream;
+  Fluids::Checkpoint::Save(stream, *sys, cache.get());
+  const std::string checkpoint = stream.str();
+
+  auto restored_cache = std::make_shared<Fluids::SolutionCache>();
+  auto restored = Fluids::Checkpoint::Restore(stream, restored_cache.get());
+  ASSERT_EQ(restored->Get_Topology_version(), sys->Get_Topology_version());
+  ASSERT_EQ(restored->Get_Vertex_indices(), sys->Get_Vertex_indices());
+  ASSERT_EQ(restored->n_unknowns(), sys->n_unknowns());
+  ASSERT_TRUE(restored->Get_Unknown_vector().isApprox(sys->Get_Unknown_vector()));
+  ASSERT_TRUE(restored->Get_Return_vec().isApprox(sys->Get_Return_vec(), 1e-12));
+  for (size_t id = 0; id < 8; ++id)
+    ASSERT_EQ(restored->Get_Liquid(id)->Get_Static_pressure()->value(),
+              sys->Get_Liquid(id)->Get_Static_pressure()->value());
+  ASSERT_EQ(restored_cache->Size(), 1u);
+  Fluids::Solver warm(restored, strategy);
+  warm.Set_Cache(restored_cache);
+  warm.Solve();
+  ASSERT_EQ(restored_cache->Get_Hits(), 1u);
+  ASSERT_EQ(warm.Get_Statistics().iterations, 0u);
+
+  auto restore = [](const std::string &bytes) {
+    std::stringstream input(bytes);
+    return Fluids::Checkpoint::Restore(input);
+  };
+  ASSERT_NO_THROW(restore(checkpoint));
+  std::string corrupt = checkpoint;
+  corrupt[corrupt.size() / 2] ^= 0x10;
+  ASSERT_THROW(restore(corrupt), std::runtime_error);
+  ASSERT_THROW(restore(checkpoint.substr(0, checkpoint.size() - 4)), std::runtime_error);
+  std::string version = checkpoint;
+  ++version[8];
+  ASSERT_THROW(restore(version), std::runtime_error);
+  ASSERT_THROW(restore("FLUIDS"), std::runtime_error);
+
+  // A vertex listed twice in the unknown speeds, with a valid checksum: the payload follows the 24 byte header and
+  // ends with its 64 bit FNV-1a checksum
+  auto plain = Make_chain(3);
+  std::stringstream output;
+  Fluids::Checkpoint::Save(output, *plain);
+  std::string duplicate = output.str();
+  const auto n = static_cast<uint64_t>(plain->Get_Unknown_speeds().size());
+  std::vector<uint64_t> speeds{0, n};
+  for (uint64_t id = 0; id < n; ++id)
+    speeds.push_back(id);
+  const std::string sequence(reinterpret_cast<const char *>(speeds.data()), speeds.size() * sizeof(uint64_t));
+  const size_t position = duplicate.find(sequence);
+  ASSERT_NE(position, std::string::npos);
+  const uint64_t twice = n - 2;
+  std::memcpy(&duplicate[position + (speeds.size() - 1) * sizeof(uint64_t)], &twice, sizeof(twice));
+  uint64_t hash = 14695981039346656037ull;
+  for (size_t i = 24; i + 8 < duplicate.size(); ++i) {
+    hash ^= static_cast<unsigned char>(duplicate[i]);
+    hash *= 1099511628211ull;
+  }
+  std::memcpy(&duplicate[duplicate.size() - 8], &hash, sizeof(hash));
+  ASSERT_THROW(restore(duplicate), std::runtime_error);
+}
+
+TEST(ServiceTest, SolvesBatchesOfMessages) {
+  auto sys = Make_chain(4);
+  Fluids::Service service(std::make_shared<Fluids::ThreadPool>(2));
+  service.Load("chain", sys);
+  Fluids::SolveRequest request;
+  request.model = "chain";
+  request.boundaries.push_back({Fluids::SolveRequest::Kind::Static_pressure, 0});
+  request.values.resize(3, 1);
+  request.values << 1.5e5, 1.6e5, 1.4e5;
+  const Fluids::SolveResult result =
+      Fluids::Service::Decode_solve(service.Handle(Fluids::Service::Encode_solve(request)));
+  ASSERT_EQ(result.converged.size(), 3u);
+  ASSERT_EQ(result.static_pressures.cols(), 7);
+  auto model = service.Get_Model("chain");
+  for (Eigen::Index i = 0; i < 3; ++i) {
+    ASSERT_TRUE(result.converged[static_cast<size_t>(i)]);
+    Fluids::SolveState state(model);
+    state.Set_Known_Static_Pressure(0, request.values(i, 0) * si::pascals);
+    ASSERT_TRUE(state.Solve().converged);
+    ASSERT_NEAR(result.static_pressures(i, 2), state.Get_Static_pressure(2).value(), 1.e-3);
+    ASSERT_NEAR(result.speeds(i, 2), state.Get_Speed(2).value(), 1.e-6);
+  }
+
+  // Models are loaded from checkpoints by name, inside the checkpoint directory only
+  const std::string path = "service_test.checkpoint";
+  service.Set_Checkpoint_directory(".");
+  {
+    std::ofstream file(path, std::ios::binary);
+    Fluids::Checkpoint::Save(file, *sys);
+  }
+  ASSERT_EQ(Fluids::Service::Decode_load(service.Handle(Fluids::Service::Encode_load("restored", path))), 7u);
+  std::remove(path.c_str());
+  request.model = "restored";
+  const Fluids::SolveResult restored =
+      Fluids::Service::Decode_solve(service.Handle(Fluids::Service::Encode_solve(request)));
+  ASSERT_TRUE(restored.static_pressures.isApprox(result.static_pressures));
+
+  // Errors are answered, not thrown
+  request.model = "missing";
+  ASSERT_THROW(Fluids::Service::Decode_solve(service.Handle(Fluids::Service::Encode_solve(request))),
+               std::runtime_error);
+  request.model = "chain";
+  request.boundaries.front().vertex = 2;
+  ASSERT_THROW(Fluids::Service::Decode_solve(service.Handle(Fluids::Service::Encode_solve(request))),
+               std::runtime_error);
+  ASSERT_THROW(Fluids::Service::Decode_load(service.Handle(std::string(1, '\x09'))), std::runtime_error);
+  ASSERT_THROW(Fluids::Service::Decode_load(service.Handle(Fluids::Service::Encode_load("x", "missing"))),
+               std::runtime_error);
+  ASSERT_THROW(Fluids::Service::Decode_load(service.Handle(Fluids::Service::Encode_load("x", "../" + path))),
+               std::runtime_error);
+  ASSERT_NO_THROW(Fluids::Service::Decode_unload(service.Handle(Fluids::Service::Encode_unload("restored"))));
+  ASSERT_FALSE(service.Get_Model("restored"));
+
+  // A small message without boundaries can not ask for more scenarios than the maximum
+  service.Set_Max_scenarios(16);
+  Fluids::SolveRequest empty;
+  empty.model = "chain";
+  empty.values.resize(17, 0);
+  ASSERT_THROW(Fluids::Service::Decode_solve(service.Handle(Fluids::Service::Encode_solve(empty))),
+               std::runtime_error);
+  ASSERT_THROW(service.Solve(empty), std::logic_error);
+
+  const Fluids::ServiceStatistics statistics =
+      Fluids::Service::Decode_statistics(service.Handle(Fluids::Service::Encode_statistics()));
+  ASSERT_EQ(statistics.requests, 10u);
+  ASSERT_EQ(statistics.failures, 6u);
+  ASSERT_EQ(statistics.scenarios, 6u);
+  ASSERT_EQ(statistics.converged, 6u);
+  ASSERT_GT(statistics.Throughput(), 0.);
+  size_t histogram = 0;
+  for (auto &&count : statistics.latency_histogram)
+    histogram += count;
+  ASSERT_EQ(histogram, 10u);
+}
+
+TEST(ServiceTest, ConcurrentSolveMessages) {
+  auto sys = Make_chain(4);
+  Fluids::Service service(std::make_shared<Fluids::ThreadPool>(2));
+  service.Load("chain", sys);
+  auto request_of = [](double p0) {
+    Fluids::SolveRequest request;
+    request.model = "chain";
+    request.boundaries.push_back({Fluids::SolveRequest::Kind::Static_pressure, 0});
+    request.values.resize(8, 1);
+    for (Eigen::Index i = 0; i < request.values.rows(); ++i)
+      request.values(i, 0) = p0 + 1.e3 * static_cast<double>(i);
+    return request;
+  };
+  const Fluids::SolveResult expected[2] = {
+      Fluids::Service::Decode_solve(service.Handle(Fluids::Service::Encode_solve(request_of(1.4e5)))),
+      Fluids::Service::Decode_solve(service.Handle(Fluids::Service::Encode_solve(request_of(1.6e5))))};
+
+  // Two callers share the models and the pool, each gets the answers of its own requests
+  std::vector<Fluids::SolveResult> results[2];
+  std::vector<std::thread> callers;
+  for (size_t c = 0; c < 2; ++c) {
+    callers.emplace_back([&, c]() {
+      const std::string message = Fluids::Service::Encode_solve(request_of(c == 0 ? 1.4e5 : 1.6e5));
+      for (size_t k = 0; k < 10; ++k)
+        results[c].push_back(Fluids::Service::Decode_solve(service.Handle(message)));
+    });
+  }
+  for (auto &&caller : callers)
+    caller.join();
+  for (size_t c = 0; c < 2; ++c) {
+    for (auto &&result : results[c]) {
+      ASSERT_EQ(result.converged, expected[c].converged);
+      ASSERT_EQ(result.static_pressures, expected[c].static_pressures);
+      ASSERT_EQ(result.speeds, expected[c].speeds);
+    }
+  }
+  const Fluids::ServiceStatistics statistics = service.Get_Statistics();
+  ASSERT_EQ(statistics.requests, 22u);
+  ASSERT_EQ(statistics.failures, 0u);
+  ASSERT_EQ(statistics.scenarios, 176u);
+
+  // A result larger than a frame of the protocol is refused before it is solved
+  service.Set_Max_scenarios(size_t(1) << 32);
+  Fluids::SolveRequest large;
+  large.model = "chain";
+  large.values.resize(Eigen::Index(1) << 28, 0);
+  ASSERT_THROW(service.Solve(large), std::logic_error);
+}
+
+TEST(ThreadPoolTest, ChunksCoverRange) {
+  Fluids::ThreadPool pool(3);
+  ASSERT_EQ(pool.Get_Threads(), 3u);
+  ASSERT_EQ(pool.Chunks(10, 4), 3u);
+  ASSERT_EQ(pool.Chunks(10, 8), 2u);
+  std::vector<int> visits(1000, 0);
+  pool.Parallel_for(visits.size(), [&](size_t begin, size_t end, size_t) {
+    for (size_t i = begin; i < end; ++i)
+      ++visits[i];
+  });
+  ASSERT_EQ(std::count(visits.begin(), visits.end(), 1), 1000);
+  ASSERT_THROW(pool.Parallel_for(10, [](size_t begin, size_t, size_t) {
+    if (begin > 0)
+      throw std::runtime_error("chunk");
+  }), std::runtime_error);
+}
+
+TEST(ThreadPoolTest, SolveIndependentOfThreads) {
+  auto model = std::make_shared<const Fluids::Model>(Make_chain(1200));
+  Eigen::VectorXd reference;
+  size_t iterations = 0;
+  for (size_t threads : {1, 2, 8}) {
+    Fluids::SolveState state(model);
+    state.Set_Thread_pool(std::make_shared<Fluids::ThreadPool>(threads));
+    auto statistics = state.Solve();
+    ASSERT_TRUE(statistics.converged);
+    if (threads == 1) {
+      reference = state.Get_Unknown_vector();
+      iterations = statistics.iterations;
+    } else {
+      ASSERT_EQ(statistics.iterations, iterations);
+      ASSERT_TRUE(state.Get_Unknown_vector() == reference);
+    }
+  }
+}
+
+TEST(ExtendedPeriodTest, PatternsWarmStart) {
+  Fluids::Pattern pattern;
+  pattern.interval = 3600. * si::seconds;
+  pattern.multipliers = {1.0, 1.05, 1.1, 1.2, 1.15, 1.1};
+  ASSERT_DOUBLE_EQ(pattern.At(3600. * si::seconds), 1.05);
+  ASSERT_DOUBLE_EQ(pattern.At(7. * 3600. * si::seconds), 1.05);
+
+  auto model = std::make_shared<const Fluids::Model>(Make_chain(5));
+  Fluids::ExtendedPeriod simulation(model);
+  simulation.Set_Tolerance(1e-9);
+  ASSERT_THROW(simulation.Add_Static_pressure_pattern(2, 1.e5 * si::pascals, pattern), std::logic_error);
+  simulation.Add_Static_pressure_pattern(0, 1.5e5 * si::pascals, pattern);
+
+  size_t steps = 0;
+  size_t cold_iterations = 0;
+  Fluids::SolverStatistics sum;
+  auto total = simulation.Run(24. * 3600. * si::seconds, 3600. * si::seconds, [&](const Fluids::PeriodStep &step) {
+    ASSERT_EQ(step.index, steps++);
+    ASSERT_TRUE(step.statistics.converged); // No cold restarts, the steps account for the whole run
+    sum.iterations += step.statistics.iterations;
+    sum.residual_evaluations += step.statistics.residual_evaluations;
+    sum.jacobian_evaluations += step.statistics.jacobian_evaluations;
+    sum.factorizations += step.statistics.factorizations;
+    sum.factorizations_saved += step.statistics.factorizations_saved;
+    sum.linear_iterations += step.statistics.linear_iterations;
+    double supply = 1.5e5 * pattern.At(step.time);
+    ASSERT_DOUBLE_EQ(step.state->Get_Static_pressure(0).value(), supply);
+    Fluids::SolveState cold(model);
+    cold.Set_Tolerance(1e-9);
+    cold.Set_Known_Static_Pressure(0, supply * si::pascals);
+    cold_iterations += cold.Solve().iterations;
+    Eigen::VectorXd expected = cold.Get_Unknown_vector();
+    ASSERT_LT((step.state->Get_Unknown_vector() - expected).norm(), 1e-6 * expected.norm());
+  });
+  ASSERT_EQ(steps, 25u);
+  ASSERT_TRUE(total.converged);
+  ASSERT_EQ(total.symbolic_analyses, 1u);
+  ASSERT_LT(total.iterations, cold_iterations);
+  ASSERT_EQ(total.iterations, sum.iterations);
+  ASSERT_EQ(total.residual_evaluations, sum.residual_evaluations);
+  ASSERT_EQ(total.jacobian_evaluations, sum.jacobian_evaluations);
+  ASSERT_EQ(total.factorizations, sum.factorizations);
+  ASSERT_EQ(total.factorizations_saved, sum.factorizations_saved);
+  ASSERT_EQ(total.linear_iterations, sum.linear_iterations);
+}
+
+TEST(TransientTest, SteadyStateIsStationary) {
+  auto sys = Make_chain(3);
+  auto strategy = std::make_shared<Fluids::SparseNewtonStrategy>();
+  strategy->Set_Tolerance(1e-10);
+  Fluids::Solver(sys, strategy).Solve();
+  Fluids::Transient transient(sys, 1000. * si::meters_per_second, 1e-3 * si::seconds);
+  ASSERT_EQ(transient.Get_Reaches(0, 1), 10u);
+  double p1 = sys->Get_Liquid(1)->Get_Static_pressure()->value();
+  double q = transient.Get_Volumetricflow(1, 2).value();
+  transient.Run(0.2 * si::seconds);
+  ASSERT_NEAR(transient.Get_Time().value(), 0.2, 1e-12);
+  ASSERT_NEAR(transient.Get_Static_pressure(1).value(), p1, 1e-6 * p1);
+  ASSERT_NEAR(transient.Get_Volumetricflow(1, 2).value(), q, 1e-9 * std::abs(q));
+}
+
+TEST(TransientTest, ShortPipeNeedsSmallerTimeStep) {
+  auto sys = Make_chain(3);
+  Fluids::Solver(sys, std::make_shared<Fluids::SparseNewtonStrategy>()).Solve();
+  // The pipes of 10 m would be one reach at 667 m/s instead of 1000 m/s
+  ASSERT_THROW(Fluids::Transient(sys, 1000. * si::meters_per_second, 15e-3 * si::seconds), std::logic_error);
+  // 9 reaches at 1010 m/s
+  Fluids::Transient transient(sys, 1000. * si::meters_per_second, 1.1e-3 * si::seconds);
+  ASSERT_EQ(transient.Get_Reaches(0, 1), 9u);
+}
+
+TEST(TransientTest, ValveClosureJoukowsky) {
+  auto sys = Make_chain(3);
+  auto strategy = std::make_shared<Fluids::SparseNewtonStrategy>();
+  strategy->Set_Tolerance(1e-10);
+  Fluids::Solver(sys, strategy).Solve();
+  const double a = 1000.;
+  double p0 = sys->Get_Liquid(3)->Get_Static_pressure()->value();
+  double v0 = sys->Get_Liquid(2)->Get_Speed()->value();
+  std::vector<double> surge;
+  for (size_t threads : {1, 3}) {
+    Fluids::Transient transient(sys, a * si::meters_per_second, 1e-3 * si::seconds);
+    if (threads > 1)
+      transient.Set_Thread_pool(std::make_shared<Fluids::ThreadPool>(threads));
+    transient.Set_Flow_schedule(3, [](const quantity<si::time> &) { return 0.; });
+    double peak = 0.;
+    transient.Run(0.02 * si::seconds, [&](const Fluids::Transient &t) {
+      peak = std::max(peak, t.Get_Static_pressure(3).value() - p0);
+    });
+    // The first step gives the surge of an instantaneous closure, rho a v0
+    ASSERT_NEAR(peak, 1000. * a * v0, 0.02 * 1000. * a * v0);
+    surge.push_back(transient.Get_Static_pressure(1).value());
+  }
+  ASSERT_EQ(surge[0], surge[1]);
+}
+
+TEST(TransientTest, ThreadsMatchSerial) {
+  // Enough pipes and junctions that the interior (grain 64) and junction (grain 256) loops run in several chunks
+  const size_t n_pipes = 400;
+  auto sys = Make_chain(n_pipes);
+  auto strategy = std::make_shared<Fluids::SparseNewtonStrategy>();
+  strategy->Set_Tolerance(1e-8);
+  Fluids::Solver solver(sys, strategy);
+  solver.Solve();
+  ASSERT_TRUE(solver.Get_Statistics().converged);
+  auto pool = std::make_shared<Fluids::ThreadPool>(3);
+  ASSERT_GT(pool->Chunks(n_pipes, 64), 2u);
+  ASSERT_GT(pool->Chunks(n_pipes + 1, 256), 1u);
+
+  std::vector<Eigen::VectorXd> pressures;
+  for (auto &&threads : {std::shared_ptr<Fluids::ThreadPool>(), pool}) {
+    Fluids::Transient transient(sys, 1000. * si::meters_per_second, 1e-3 * si::seconds);
+    transient.Set_Thread_pool(threads);
+    transient.Set_Flow_schedule(n_pipes, [](const quantity<si::time> &) { return 0.; });
+    transient.Run(0.05 * si::seconds);
+    Eigen::VectorXd pressure(n_pipes + 1);
+    for (size_t i = 0; i <= n_pipes; ++i)
+      pressure(static_cast<Eigen::Index>(i)) = transient.Get_Static_pressure(i).value();
+    pressures.push_back(pressure);
+  }
+  ASSERT_EQ(pressures[0], pressures[1]);
+}